@@ -0,0 +1,340 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdarg.h>
+#include <atomic>
+
+#include "dsp_host.h"
+
+// FMOD hands out 16 byte aligned blocks. The header in front of every block
+// keeps that alignment and remembers the size for the accounting on free.
+#define DSP_HOST_ALLOC_HEADER 16
+
+static std::atomic<unsigned long long> s_alloc_count(0);
+static std::atomic<unsigned long long> s_free_count(0);
+static std::atomic<long long> s_live_bytes(0);
+static std::atomic<long long> s_peak_bytes(0);
+
+#pragma region Fake FMOD_DSP_STATE_FUNCTIONS
+
+static void* F_CALL DSPHost_Alloc(unsigned int size, FMOD_MEMORY_TYPE /*type*/, const char* /*sourcestr*/)
+{
+	unsigned char* block = (unsigned char*)malloc(size + DSP_HOST_ALLOC_HEADER);
+	if (!block) {
+		return 0;
+	}
+	*(unsigned int*)block = size;
+
+	s_alloc_count++;
+	long long live = (s_live_bytes += size);
+	long long peak = s_peak_bytes.load();
+	while (peak < live && !s_peak_bytes.compare_exchange_weak(peak, live)) {}
+
+	return block + DSP_HOST_ALLOC_HEADER;
+}
+static void F_CALL DSPHost_Free(void* ptr, FMOD_MEMORY_TYPE /*type*/, const char* /*sourcestr*/)
+{
+	if (!ptr) {
+		return;
+	}
+	unsigned char* block = (unsigned char*)ptr - DSP_HOST_ALLOC_HEADER;
+
+	s_free_count++;
+	s_live_bytes -= *(unsigned int*)block;
+
+	free(block);
+}
+static void* F_CALL DSPHost_Realloc(void* ptr, unsigned int size, FMOD_MEMORY_TYPE type, const char* sourcestr)
+{
+	void* block = DSPHost_Alloc(size, type, sourcestr);
+	if (block && ptr) {
+		unsigned int oldsize = *(unsigned int*)((unsigned char*)ptr - DSP_HOST_ALLOC_HEADER);
+		memcpy(block, ptr, oldsize < size ? oldsize : size);
+		DSPHost_Free(ptr, type, sourcestr);
+	}
+	return block;
+}
+
+static DSPHost* GetHost(FMOD_DSP_STATE* dsp_state)
+{
+	return (DSPHost*)dsp_state->instance;
+}
+
+static FMOD_RESULT F_CALL DSPHost_GetSamplerate(FMOD_DSP_STATE* dsp_state, int* rate)
+{
+	*rate = GetHost(dsp_state)->getSamplerate();
+	return FMOD_OK;
+}
+static FMOD_RESULT F_CALL DSPHost_GetBlocksize(FMOD_DSP_STATE* dsp_state, unsigned int* blocksize)
+{
+	*blocksize = GetHost(dsp_state)->getBlocksize();
+	return FMOD_OK;
+}
+static FMOD_RESULT F_CALL DSPHost_GetSpeakermode(FMOD_DSP_STATE* dsp_state, FMOD_SPEAKERMODE* speakermode_mixer, FMOD_SPEAKERMODE* speakermode_output)
+{
+	if (speakermode_mixer) *speakermode_mixer = GetHost(dsp_state)->getSpeakerMode();
+	if (speakermode_output) *speakermode_output = GetHost(dsp_state)->getSpeakerMode();
+	return FMOD_OK;
+}
+static FMOD_RESULT F_CALL DSPHost_GetClock(FMOD_DSP_STATE* dsp_state, unsigned long long* clock, unsigned int* offset, unsigned int* length)
+{
+	DSPHost* host = GetHost(dsp_state);
+	if (clock) *clock = host->getClock();
+	if (offset) *offset = 0;
+	if (length) *length = host->getBlocksize();
+	return FMOD_OK;
+}
+static FMOD_RESULT F_CALL DSPHost_GetListenerAttributes(FMOD_DSP_STATE* /*dsp_state*/, int* numlisteners, FMOD_3D_ATTRIBUTES* attributes)
+{
+	if (numlisteners) *numlisteners = 1;
+	if (attributes) memset(attributes, 0, sizeof(FMOD_3D_ATTRIBUTES));
+	return FMOD_OK;
+}
+static FMOD_RESULT F_CALL DSPHost_GetUserData(FMOD_DSP_STATE* /*dsp_state*/, void** userdata)
+{
+	*userdata = 0;
+	return FMOD_OK;
+}
+static void F_CALL DSPHost_Log(FMOD_DEBUG_FLAGS /*level*/, const char* file, int line, const char* function, const char* str, ...)
+{
+	va_list args;
+	va_start(args, str);
+	fprintf(stderr, "%s(%d) %s: ", file, line, function);
+	vfprintf(stderr, str, args);
+	fprintf(stderr, "\n");
+	va_end(args);
+}
+
+#pragma endregion
+
+FMOD_SPEAKERMODE DSPHost_GetSpeakerMode(int channels)
+{
+	switch (channels)
+	{
+	case 1:
+		return FMOD_SPEAKERMODE_MONO;
+	case 2:
+		return FMOD_SPEAKERMODE_STEREO;
+	case 4:
+		return FMOD_SPEAKERMODE_QUAD;
+	case 5:
+		return FMOD_SPEAKERMODE_SURROUND;
+	case 6:
+		return FMOD_SPEAKERMODE_5POINT1;
+	case 8:
+		return FMOD_SPEAKERMODE_7POINT1;
+	default:
+		return FMOD_SPEAKERMODE_RAW;
+	}
+}
+
+void DSPHost_GetAllocStats(DSPHostAllocStats* stats)
+{
+	stats->allocCount = s_alloc_count.load();
+	stats->freeCount = s_free_count.load();
+	stats->liveBytes = s_live_bytes.load();
+	stats->peakBytes = s_peak_bytes.load();
+}
+void DSPHost_ResetAllocStats()
+{
+	s_alloc_count = 0;
+	s_free_count = 0;
+	s_peak_bytes = s_live_bytes.load();
+}
+
+#pragma region DSPHost
+
+DSPHost::DSPHost(int samplerate, unsigned int blocksize, int channels)
+{
+	m_samplerate = samplerate;
+	m_blocksize = blocksize;
+	m_channels = channels;
+	m_speakermode = DSPHost_GetSpeakerMode(channels);
+	m_clock = 0;
+
+	memset(&m_functions, 0, sizeof(m_functions));
+	m_functions.alloc = DSPHost_Alloc;
+	m_functions.realloc = DSPHost_Realloc;
+	m_functions.free = DSPHost_Free;
+	m_functions.getsamplerate = DSPHost_GetSamplerate;
+	m_functions.getblocksize = DSPHost_GetBlocksize;
+	m_functions.getspeakermode = DSPHost_GetSpeakermode;
+	m_functions.getclock = DSPHost_GetClock;
+	m_functions.getlistenerattributes = DSPHost_GetListenerAttributes;
+	m_functions.log = DSPHost_Log;
+	m_functions.getuserdata = DSPHost_GetUserData;
+
+	memset(&m_system_state, 0, sizeof(m_system_state));
+	m_system_state.instance = this;
+	m_system_state.source_speakermode = m_speakermode;
+	m_system_state.functions = &m_functions;
+}
+
+FMOD_RESULT DSPHost::registerType(FMOD_DSP_DESCRIPTION* description)
+{
+	if (!description->sys_register) {
+		return FMOD_OK;
+	}
+	return description->sys_register(&m_system_state);
+}
+FMOD_RESULT DSPHost::deregisterType(FMOD_DSP_DESCRIPTION* description)
+{
+	if (!description->sys_deregister) {
+		return FMOD_OK;
+	}
+	return description->sys_deregister(&m_system_state);
+}
+FMOD_RESULT DSPHost::mix(FMOD_DSP_DESCRIPTION* description, int stage)
+{
+	if (!description->sys_mix) {
+		return FMOD_OK;
+	}
+	return description->sys_mix(&m_system_state, stage);
+}
+
+#pragma endregion
+
+#pragma region DSPHostInstance
+
+DSPHostInstance::DSPHostInstance()
+{
+	memset(&m_state, 0, sizeof(m_state));
+	m_description = 0;
+	m_host = 0;
+}
+
+FMOD_RESULT DSPHostInstance::create(DSPHost* host, FMOD_DSP_DESCRIPTION* description)
+{
+	m_host = host;
+	m_description = description;
+
+	memset(&m_state, 0, sizeof(m_state));
+	m_state.instance = host;
+	m_state.channelmask = 0;
+	m_state.source_speakermode = host->getSpeakerMode();
+	m_state.functions = host->getFunctions();
+
+	if (!description->create) {
+		return FMOD_OK;
+	}
+	return description->create(&m_state);
+}
+FMOD_RESULT DSPHostInstance::release()
+{
+	FMOD_RESULT result = FMOD_OK;
+	if (m_description && m_description->release) {
+		result = m_description->release(&m_state);
+	}
+	m_state.plugindata = 0;
+	m_description = 0;
+	return result;
+}
+FMOD_RESULT DSPHostInstance::reset()
+{
+	if (!m_description->reset) {
+		return FMOD_OK;
+	}
+	return m_description->reset(&m_state);
+}
+
+void DSPHostInstance::setDefaults()
+{
+	for (int i = 0; i < m_description->numparameters; i++)
+	{
+		FMOD_DSP_PARAMETER_DESC* param = m_description->paramdesc[i];
+
+		switch (param->type)
+		{
+		case FMOD_DSP_PARAMETER_TYPE_FLOAT:
+			if (m_description->setparameterfloat) {
+				m_description->setparameterfloat(&m_state, i, param->floatdesc.defaultval);
+			}
+			break;
+		case FMOD_DSP_PARAMETER_TYPE_INT:
+			if (m_description->setparameterint) {
+				m_description->setparameterint(&m_state, i, param->intdesc.defaultval);
+			}
+			break;
+		case FMOD_DSP_PARAMETER_TYPE_BOOL:
+			if (m_description->setparameterbool) {
+				m_description->setparameterbool(&m_state, i, param->booldesc.defaultval);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+FMOD_RESULT DSPHostInstance::setFloat(int index, float value)
+{
+	if (!m_description->setparameterfloat) {
+		return FMOD_ERR_INVALID_PARAM;
+	}
+	return m_description->setparameterfloat(&m_state, index, value);
+}
+FMOD_RESULT DSPHostInstance::setInt(int index, int value)
+{
+	if (!m_description->setparameterint) {
+		return FMOD_ERR_INVALID_PARAM;
+	}
+	return m_description->setparameterint(&m_state, index, value);
+}
+FMOD_RESULT DSPHostInstance::getData(int index, void** data, unsigned int* length)
+{
+	if (!m_description->getparameterdata) {
+		return FMOD_ERR_INVALID_PARAM;
+	}
+	return m_description->getparameterdata(&m_state, index, data, length, 0);
+}
+
+FMOD_RESULT DSPHostInstance::process(float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int* outchannels, FMOD_BOOL inputsidle)
+{
+	int in_numchannels = inchannels;
+	FMOD_CHANNELMASK in_mask = 0;
+	float* in_buffers[1] = { inbuffer };
+
+	int out_numchannels = inchannels;
+	FMOD_CHANNELMASK out_mask = 0;
+	float* out_buffers[1] = { outbuffer };
+
+	FMOD_DSP_BUFFER_ARRAY in_array;
+	in_array.numbuffers = 1;
+	in_array.buffernumchannels = &in_numchannels;
+	in_array.bufferchannelmask = &in_mask;
+	in_array.buffers = in_buffers;
+	in_array.speakermode = DSPHost_GetSpeakerMode(inchannels);
+
+	FMOD_DSP_BUFFER_ARRAY out_array = in_array;
+	out_array.buffernumchannels = &out_numchannels;
+	out_array.bufferchannelmask = &out_mask;
+	out_array.buffers = out_buffers;
+
+	FMOD_RESULT result = m_description->process(&m_state, length, &in_array, &out_array, inputsidle, FMOD_DSP_PROCESS_QUERY);
+	if (outchannels) {
+		*outchannels = out_numchannels;
+	}
+	if (result != FMOD_OK) {
+		return result;
+	}
+
+	return m_description->process(&m_state, length, &in_array, &out_array, inputsidle, FMOD_DSP_PROCESS_PERFORM);
+}
+
+#pragma endregion
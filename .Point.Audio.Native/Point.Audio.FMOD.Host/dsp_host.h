@@ -0,0 +1,107 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// dsp_host.h: headless stand-in for the FMOD mixer.
+// Fakes FMOD_DSP_STATE (alloc/free, samplerate, speaker mode) so that the
+// plugins of Point.Audio.FMOD.Native can be driven without a live FMOD system.
+
+#pragma once
+
+#ifndef __DSP_HOST_H__
+#define __DSP_HOST_H__
+
+#include "fmod.hpp"
+#include "fmod_dsp.h"
+
+#define DSP_HOST_MAX_CHANNELS 8
+
+struct DSPHostAllocStats
+{
+	unsigned long long allocCount;
+	unsigned long long freeCount;
+	long long liveBytes;
+	long long peakBytes;
+};
+
+FMOD_SPEAKERMODE DSPHost_GetSpeakerMode(int channels);
+
+void DSPHost_GetAllocStats(DSPHostAllocStats* stats);
+void DSPHost_ResetAllocStats();
+
+class DSPHost
+{
+public:
+	DSPHost(int samplerate, unsigned int blocksize, int channels);
+
+	int getSamplerate() const { return m_samplerate; }
+	unsigned int getBlocksize() const { return m_blocksize; }
+	int getChannels() const { return m_channels; }
+	FMOD_SPEAKERMODE getSpeakerMode() const { return m_speakermode; }
+
+	unsigned long long getClock() const { return m_clock; }
+	void advanceClock() { m_clock += m_blocksize; }
+
+	FMOD_DSP_STATE_FUNCTIONS* getFunctions() { return &m_functions; }
+
+	// Type-level callbacks, as the mixer calls them once per plugin type.
+	// mix() runs sys_mix with stage 0 before and stage 1 after the tick's instances.
+	FMOD_RESULT registerType(FMOD_DSP_DESCRIPTION* description);
+	FMOD_RESULT deregisterType(FMOD_DSP_DESCRIPTION* description);
+	FMOD_RESULT mix(FMOD_DSP_DESCRIPTION* description, int stage);
+
+private:
+	int m_samplerate;
+	unsigned int m_blocksize;
+	int m_channels;
+	FMOD_SPEAKERMODE m_speakermode;
+	unsigned long long m_clock;
+
+	FMOD_DSP_STATE_FUNCTIONS m_functions;
+	// state handed to the type-level callbacks
+	FMOD_DSP_STATE m_system_state;
+};
+
+class DSPHostInstance
+{
+public:
+	DSPHostInstance();
+
+	FMOD_RESULT create(DSPHost* host, FMOD_DSP_DESCRIPTION* description);
+	FMOD_RESULT release();
+	FMOD_RESULT reset();
+
+	// Applies every parameter's default value, as FMOD Studio does when it
+	// instantiates an effect from a bank.
+	void setDefaults();
+
+	FMOD_RESULT setFloat(int index, float value);
+	FMOD_RESULT setInt(int index, int value);
+	FMOD_RESULT getData(int index, void** data, unsigned int* length);
+
+	// Runs the query pass followed by the perform pass, as the mixer does.
+	// Returns the query result when the plugin asks not to be processed.
+	FMOD_RESULT process(float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int* outchannels, FMOD_BOOL inputsidle);
+
+	FMOD_DSP_DESCRIPTION* getDescription() const { return m_description; }
+	FMOD_DSP_STATE* getState() { return &m_state; }
+
+private:
+	FMOD_DSP_STATE m_state;
+	FMOD_DSP_DESCRIPTION* m_description;
+	DSPHost* m_host;
+};
+
+#endif // !__DSP_HOST_H__
@@ -0,0 +1,521 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// main.cpp: per-plugin throughput benchmark.
+// Drives every Point DSP through create/query/process/release on the headless
+// host and reports ns/sample, instances-per-core and allocation counts.
+//
+// usage: Point.Audio.FMOD.Host [--plugin <name>] [--blocks 256,512,1024]
+//                              [--channels 1,2] [--instances 1,16,64]
+//                              [--samplerate 48000] [--seconds 2] [--idle 0|1]
+//                              [--decay 0|1]
+//                              [--stats 0|1] [--trace <file.json>]
+//                              [--churn <cycles>] [--memory 0|1]
+//                              [--bake <seconds>]
+//
+// --idle 1 warms up on the test signal, then times blocks whose input is idle,
+// fed with silence as the FMOD mixer does.
+// --decay 1 times a train of notes instead, one every BENCH_DECAY_NOTE_BLOCKS
+// blocks, that fall from the test signal into the subnormal range within the
+// first quarter of a block and hold there. Each note's first block is processed
+// with mostly subnormal input and the following ones until the plugin's tail
+// runs out, so a plugin that stops flushing denormals (or a
+// POINT_DSP_KEEP_DENORMALS build) shows up here as a slower ns/sample.
+// --stats 1 also prints what the instances' own Stats parameters recorded over
+// the timed blocks: the fastest, mean, worst p99 and slowest block in us, and
+// the blocks over budget.
+// --trace writes the most recent callbacks, as many as the trace rings hold, as
+// Chrome trace JSON once every run is done; needs a POINT_DSP_TRACE build.
+// --churn then releases and recreates the instances round robin for that many
+// cycles, as voices come and go, and prints the mean cycle time and how many
+// of them reached the host allocator.
+// --memory 1 prints the plugin type's DSPMemory account while the instances
+// are live and again once they are released, when anything still live on it
+// other than the warm instances is a leak.
+// --bake renders that many seconds of the test signal through the plugin's
+// defaults offline (dsp_bake.h), once per instance count as that many distinct
+// requests at once, and prints how much faster than real time that ran, how
+// long the same requests took once cached, and whether rendering one of them
+// again from scratch gave the same samples. Plugin_List plugins only.
+//
+// The first line names the kernel variant the plugins run on (dsp_dispatch.h);
+// set POINT_DSP_ISA=scalar|sse2|avx2|avx512|neon to time another one.
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "dsp_host.h"
+#include "dsp_stats.h"
+#include "dsp_memory.h"
+#include "dsp_bake.h"
+
+extern "C" FMOD_PLUGINLIST* F_CALL FMODGetPluginDescriptionList();
+extern "C" FMOD_DSP_DESCRIPTION* F_CALL FMOD_Point_Noise_GetDSPDescription();
+extern "C" void PointDSP_ResetStats();
+extern "C" int PointDSP_GetMemory(DSPMemorySnapshot* table, int capacity);
+extern "C" void PointDSP_ResetMemoryPeaks();
+extern "C" int PointDSP_DumpTrace(const char* path);
+extern "C" int PointDSP_Bake(const DSPBakeRequest* requests, int count, unsigned long long* keys, int* results);
+extern "C" const float* PointDSP_AcquireBake(unsigned long long key, unsigned int* frames, int* channels);
+extern "C" void PointDSP_ReleaseBake(unsigned long long key);
+extern "C" void PointDSP_ClearBakes();
+extern "C" void PointDSP_SetBakeCapacity(unsigned long long bytes);
+extern "C" const char* PointDSP_GetKernelISA();
+FMOD_DSP_DESCRIPTION* FMOD_TEST_GAIN_GetDSPDescription();
+
+#define BENCH_MAX_VALUES 16
+#define BENCH_WARMUP_BLOCKS 8
+#define BENCH_DECAY_NOTE_BLOCKS 4
+// level a decayed note holds, below FLT_MIN (1.2e-38)
+#define BENCH_DECAY_FLOOR 1e-40
+
+struct BenchList
+{
+	int count;
+	int values[BENCH_MAX_VALUES];
+};
+
+struct BenchOptions
+{
+	const char* plugin;
+	BenchList blocks;
+	BenchList channels;
+	BenchList instances;
+	int samplerate;
+	float seconds;
+	bool idle;
+	bool decay;
+	bool stats;
+	const char* trace;
+	int churn;
+	bool memory;
+	float bake;
+};
+
+static void ParseList(const char* str, BenchList* list)
+{
+	list->count = 0;
+	while (*str && list->count < BENCH_MAX_VALUES)
+	{
+		list->values[list->count++] = atoi(str);
+
+		const char* next = strchr(str, ',');
+		if (!next) {
+			break;
+		}
+		str = next + 1;
+	}
+}
+
+static bool ParseOptions(int argc, char** argv, BenchOptions* options)
+{
+	options->plugin = 0;
+	ParseList("256,512,1024", &options->blocks);
+	ParseList("1,2", &options->channels);
+	ParseList("1,16,64", &options->instances);
+	options->samplerate = 48000;
+	options->seconds = 2;
+	options->idle = false;
+	options->decay = false;
+	options->stats = false;
+	options->trace = 0;
+	options->churn = 0;
+	options->memory = false;
+	options->bake = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : 0;
+		if (!value) {
+			fprintf(stderr, "missing value for %s\n", arg);
+			return false;
+		}
+
+		if (strcmp(arg, "--plugin") == 0) options->plugin = value;
+		else if (strcmp(arg, "--blocks") == 0) ParseList(value, &options->blocks);
+		else if (strcmp(arg, "--channels") == 0) ParseList(value, &options->channels);
+		else if (strcmp(arg, "--instances") == 0) ParseList(value, &options->instances);
+		else if (strcmp(arg, "--samplerate") == 0) options->samplerate = atoi(value);
+		else if (strcmp(arg, "--seconds") == 0) options->seconds = (float)atof(value);
+		else if (strcmp(arg, "--idle") == 0) options->idle = atoi(value) != 0;
+		else if (strcmp(arg, "--decay") == 0) options->decay = atoi(value) != 0;
+		else if (strcmp(arg, "--stats") == 0) options->stats = atoi(value) != 0;
+		else if (strcmp(arg, "--trace") == 0) options->trace = value;
+		else if (strcmp(arg, "--churn") == 0) options->churn = atoi(value);
+		else if (strcmp(arg, "--memory") == 0) options->memory = atoi(value) != 0;
+		else if (strcmp(arg, "--bake") == 0) options->bake = (float)atof(value);
+		else {
+			fprintf(stderr, "unknown option %s\n", arg);
+			return false;
+		}
+		i++;
+	}
+
+	return true;
+}
+
+static void CollectPlugins(std::vector<FMOD_DSP_DESCRIPTION*>* plugins)
+{
+	FMOD_PLUGINLIST* list = FMODGetPluginDescriptionList();
+	for (int i = 0; list[i].type != FMOD_PLUGINTYPE_MAX; i++)
+	{
+		if (list[i].type == FMOD_PLUGINTYPE_DSP) {
+			plugins->push_back((FMOD_DSP_DESCRIPTION*)list[i].description);
+		}
+	}
+
+	// Not part of Plugin_List, but built into the same library.
+	plugins->push_back(FMOD_TEST_GAIN_GetDSPDescription());
+	plugins->push_back(FMOD_Point_Noise_GetDSPDescription());
+}
+
+static int FindParameter(FMOD_DSP_DESCRIPTION* description, const char* name)
+{
+	for (int i = 0; i < description->numparameters; i++)
+	{
+		if (strcmp(description->paramdesc[i]->name, name) == 0) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// The DSPMemory row of the plugin type; false for a type without one.
+static bool FindMemory(FMOD_DSP_DESCRIPTION* description, DSPMemorySnapshot* row)
+{
+	std::vector<DSPMemorySnapshot> table(PointDSP_GetMemory(0, 0) + 1);
+	int count = PointDSP_GetMemory(&table[0], (int)table.size());
+	for (int i = 0; i < count && i < (int)table.size(); i++)
+	{
+		if (table[i].id == 0 && strcmp(table[i].name, description->name) == 0) {
+			*row = table[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+// Deterministic test signal so that runs are comparable.
+static void FillSignal(float* buffer, unsigned int samples)
+{
+	unsigned int seed = 0x1234567u;
+	for (unsigned int i = 0; i < samples; i++)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		buffer[i] = ((float)(seed >> 8) / 8388608.0f - 1.0f) * .5f;
+	}
+}
+
+// BENCH_DECAY_NOTE_BLOCKS blocks of one decaying note, see --decay.
+static void FillDecay(float* buffer, unsigned int blocksize, int channels)
+{
+	unsigned int frames = blocksize * BENCH_DECAY_NOTE_BLOCKS;
+	unsigned int fall = blocksize / 4 ? blocksize / 4 : 1;
+	FillSignal(buffer, frames * channels);
+	for (unsigned int frame = 0; frame < frames; frame++)
+	{
+		double level = frame < fall ? pow(BENCH_DECAY_FLOOR, (double)frame / fall) : BENCH_DECAY_FLOOR;
+		for (int c = 0; c < channels; c++)
+		{
+			buffer[frame * channels + c] = (float)(buffer[frame * channels + c] * level);
+		}
+	}
+}
+
+static void RunBench(FMOD_DSP_DESCRIPTION* description, const BenchOptions& options, unsigned int blocksize, int channels, int instancecount)
+{
+	DSPHost host(options.samplerate, blocksize, channels);
+
+	std::vector<float> inbuffer(blocksize * channels);
+	std::vector<float> outbuffer(blocksize * DSP_HOST_MAX_CHANNELS);
+	FillSignal(&inbuffer[0], (unsigned int)inbuffer.size());
+	std::vector<float> silence(blocksize * channels, 0.0f);
+	float* timedinput = options.idle ? &silence[0] : &inbuffer[0];
+	std::vector<float> decay(options.decay ? blocksize * channels * BENCH_DECAY_NOTE_BLOCKS : 0);
+	if (options.decay) {
+		FillDecay(&decay[0], blocksize, channels);
+	}
+
+	std::vector<DSPHostInstance> instances(instancecount);
+
+	DSPHostAllocStats stats;
+	DSPHost_ResetAllocStats();
+	PointDSP_ResetMemoryPeaks();
+
+	host.registerType(description);
+	for (int i = 0; i < instancecount; i++)
+	{
+		if (instances[i].create(&host, description) != FMOD_OK) {
+			fprintf(stderr, "%s: create failed\n", description->name);
+			return;
+		}
+		instances[i].setDefaults();
+		instances[i].reset();
+	}
+
+	DSPHost_GetAllocStats(&stats);
+	unsigned long long create_allocs = stats.allocCount;
+	long long create_bytes = stats.liveBytes;
+
+	int outchannels = channels;
+	for (int block = 0; block < BENCH_WARMUP_BLOCKS; block++)
+	{
+		host.mix(description, 0);
+		for (int i = 0; i < instancecount; i++)
+		{
+			instances[i].process(&inbuffer[0], &outbuffer[0], blocksize, channels, &outchannels, false);
+		}
+		host.mix(description, 1);
+		host.advanceClock();
+	}
+
+	unsigned int blockcount = (unsigned int)(options.seconds * options.samplerate / blocksize);
+	if (blockcount < 1) {
+		blockcount = 1;
+	}
+
+	DSPHost_ResetAllocStats();
+	PointDSP_ResetStats();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (unsigned int block = 0; block < blockcount; block++)
+	{
+		host.mix(description, 0);
+		if (options.decay) {
+			timedinput = &decay[(block % BENCH_DECAY_NOTE_BLOCKS) * blocksize * channels];
+		}
+		for (int i = 0; i < instancecount; i++)
+		{
+			instances[i].process(timedinput, &outbuffer[0], blocksize, channels, &outchannels, options.idle);
+		}
+		host.mix(description, 1);
+		host.advanceClock();
+	}
+	std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+	DSPHost_GetAllocStats(&stats);
+	unsigned long long process_allocs = stats.allocCount;
+
+	DSPStatsSnapshot summary;
+	memset(&summary, 0, sizeof(summary));
+	int reporting = 0;
+	int statsparameter = FindParameter(description, "Stats");
+	for (int i = 0; options.stats && 0 <= statsparameter && i < instancecount; i++)
+	{
+		void* data;
+		unsigned int length;
+		if (instances[i].getData(statsparameter, &data, &length) != FMOD_OK || length != sizeof(DSPStatsSnapshot)) {
+			continue;
+		}
+		const DSPStatsSnapshot* row = (const DSPStatsSnapshot*)data;
+		summary.minimum = reporting && summary.minimum < row->minimum ? summary.minimum : row->minimum;
+		summary.average += row->average;
+		summary.p99 = summary.p99 < row->p99 ? row->p99 : summary.p99;
+		summary.maximum = summary.maximum < row->maximum ? row->maximum : summary.maximum;
+		summary.overbudget += row->overbudget;
+		summary.blocks += row->blocks;
+		reporting++;
+	}
+
+	DSPMemorySnapshot memory_live;
+	bool memory = options.memory && FindMemory(description, &memory_live);
+
+	// one cycle up front so that the timed ones find a released instance to reuse
+	unsigned long long churn_allocs = 0;
+	double churn_ns = 0;
+	if (options.churn > 0) {
+		instances[0].release();
+		instances[0].create(&host, description);
+		DSPHost_ResetAllocStats();
+
+		std::chrono::steady_clock::time_point churnstart = std::chrono::steady_clock::now();
+		for (int cycle = 0; cycle < options.churn; cycle++)
+		{
+			DSPHostInstance& instance = instances[cycle % instancecount];
+			instance.release();
+			if (instance.create(&host, description) != FMOD_OK) {
+				fprintf(stderr, "%s: create failed\n", description->name);
+				return;
+			}
+			instance.setDefaults();
+			instance.reset();
+		}
+		std::chrono::steady_clock::time_point churnend = std::chrono::steady_clock::now();
+
+		DSPHost_GetAllocStats(&stats);
+		churn_allocs = stats.allocCount;
+		churn_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(churnend - churnstart).count();
+	}
+
+	for (int i = 0; i < instancecount; i++)
+	{
+		instances[i].release();
+	}
+	DSPMemorySnapshot memory_warm;
+	memory = memory && FindMemory(description, &memory_warm);
+	host.deregisterType(description);
+	DSPMemorySnapshot memory_released;
+	memory = memory && FindMemory(description, &memory_released);
+
+	double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	double samples = (double)blockcount * instancecount * blocksize * outchannels;
+	double ns_per_block = ns / ((double)blockcount * instancecount);
+	double block_budget_ns = 1e9 * blocksize / 48000.0;
+
+	printf("%-20s %6u %3d %5d %10.3f %12.1f %14.1f %8llu %12lld %8llu\n",
+		description->name, blocksize, outchannels, instancecount,
+		ns / samples, ns_per_block, block_budget_ns / ns_per_block,
+		create_allocs, create_bytes, process_allocs);
+	if (reporting) {
+		printf("%-20s stats: min %.2f avg %.2f p99 %.2f max %.2f us, %u of %u blocks over budget\n",
+			"", summary.minimum, summary.average / reporting, summary.p99, summary.maximum,
+			summary.overbudget, summary.blocks);
+	}
+	if (memory) {
+		printf("%-20s memory: %u instances, %.1f KB live, %.1f KB peak; %.1f KB kept warm after release, %llu bytes after deregister%s\n",
+			"", memory_live.instances, memory_live.live / 1024.0, memory_released.peak / 1024.0,
+			memory_warm.live / 1024.0, memory_released.live, memory_released.live ? " (leak)" : "");
+	}
+	if (options.churn > 0) {
+		printf("%-20s churn: %.1f ns per release+create, %llu allocs over %d cycles\n",
+			"", churn_ns / options.churn, churn_allocs, options.churn);
+	}
+}
+
+static double ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1e6;
+}
+
+static void RunBake(FMOD_DSP_DESCRIPTION* description, const BenchOptions& options, int channels, int requestcount)
+{
+	unsigned int frames = (unsigned int)(options.bake * options.samplerate);
+	if (frames < 1) {
+		frames = 1;
+	}
+
+	// one source per request, each a little different so that none is a cache hit
+	std::vector<std::vector<float> > sources(requestcount, std::vector<float>(frames * channels));
+	std::vector<DSPBakeRequest> requests(requestcount);
+	for (int i = 0; i < requestcount; i++)
+	{
+		FillSignal(&sources[i][0], frames * channels);
+		sources[i][0] += i * 1e-6f;
+
+		DSPBakeRequest& request = requests[i];
+		request.plugin = description->name;
+		request.parameters = 0;
+		request.parameterCount = 0;
+		request.source = &sources[i][0];
+		request.frames = frames;
+		request.channels = channels;
+		request.samplerate = options.samplerate;
+	}
+	std::vector<unsigned long long> keys(requestcount);
+	std::vector<int> results(requestcount);
+
+	PointDSP_ClearBakes();
+	PointDSP_SetBakeCapacity(~0ull);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int failed = PointDSP_Bake(&requests[0], requestcount, &keys[0], &results[0]);
+	double cold_ms = ElapsedMs(start);
+	if (failed) {
+		if (results[0] != FMOD_ERR_PLUGIN_MISSING) {
+			fprintf(stderr, "%s: %d of %d bakes failed (%d)\n", description->name, failed, requestcount, results[0]);
+		}
+		return;
+	}
+
+	start = std::chrono::steady_clock::now();
+	PointDSP_Bake(&requests[0], requestcount, &keys[0], &results[0]);
+	double cached_ms = ElapsedMs(start);
+
+	// the first request again, from scratch
+	unsigned int bakedframes = 0;
+	int bakedchannels = 0;
+	const float* baked = PointDSP_AcquireBake(keys[0], &bakedframes, &bakedchannels);
+	std::vector<float> first(baked, baked + (size_t)bakedframes * bakedchannels);
+	PointDSP_ReleaseBake(keys[0]);
+	PointDSP_ClearBakes();
+	unsigned long long key;
+	PointDSP_Bake(&requests[0], 1, &key, 0);
+	baked = PointDSP_AcquireBake(key, &bakedframes, &bakedchannels);
+	bool same = baked && key == keys[0] && first.size() == (size_t)bakedframes * bakedchannels
+		&& (first.empty() || memcmp(&first[0], baked, sizeof(float) * first.size()) == 0);
+	PointDSP_ReleaseBake(key);
+
+	PointDSP_ClearBakes();
+	PointDSP_SetBakeCapacity(DSP_BAKE_DEFAULT_CAPACITY);
+
+	printf("%-20s bake: %d x %.1f s of %d ch in %.1f ms, %.0fx real time; %.2f ms cached; %u frames out, %s\n",
+		"", requestcount, options.bake, channels, cold_ms, requestcount * options.bake * 1000.0 / cold_ms,
+		cached_ms, bakedframes, same ? "deterministic" : "NOT deterministic");
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+	if (!ParseOptions(argc, argv, &options)) {
+		return 1;
+	}
+
+	std::vector<FMOD_DSP_DESCRIPTION*> plugins;
+	CollectPlugins(&plugins);
+
+	const char* forced = getenv("POINT_DSP_ISA");
+	if (forced && *forced) {
+		printf("kernels: %s (POINT_DSP_ISA=%s)\n", PointDSP_GetKernelISA(), forced);
+	}
+	else {
+		printf("kernels: %s\n", PointDSP_GetKernelISA());
+	}
+	printf("%-20s %6s %3s %5s %10s %12s %14s %8s %12s %8s\n",
+		"plugin", "block", "ch", "inst", "ns/sample", "ns/block", "inst/core@48k", "c-allocs", "c-bytes", "p-allocs");
+
+	for (size_t p = 0; p < plugins.size(); p++)
+	{
+		if (options.plugin && !strstr(plugins[p]->name, options.plugin)) {
+			continue;
+		}
+
+		for (int b = 0; b < options.blocks.count; b++)
+		for (int c = 0; c < options.channels.count; c++)
+		for (int n = 0; n < options.instances.count; n++)
+		{
+			RunBench(plugins[p], options,
+				(unsigned int)options.blocks.values[b], options.channels.values[c], options.instances.values[n]);
+		}
+
+		for (int c = 0; 0 < options.bake && c < options.channels.count; c++)
+		for (int n = 0; n < options.instances.count; n++)
+		{
+			RunBake(plugins[p], options, options.channels.values[c], options.instances.values[n]);
+		}
+	}
+
+	if (options.trace && !PointDSP_DumpTrace(options.trace)) {
+		fprintf(stderr, "could not write %s (POINT_DSP_TRACE build?)\n", options.trace);
+		return 1;
+	}
+
+	return 0;
+}
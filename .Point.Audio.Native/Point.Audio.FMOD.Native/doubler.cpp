@@ -18,426 +18,552 @@
 
 #include "pch.h"
 #include "doubler.h"
+#include "dsp_dispatch.h"
 #include "fmod.hpp"
 #include "fmod_dsp.h"
 #include "fmod_studio.hpp"
 
-static FMOD_DSP_PARAMETER_DESC p_doubler_lTime;
-static FMOD_DSP_PARAMETER_DESC p_doubler_rTime;
-static FMOD_DSP_PARAMETER_DESC p_doubler_mix;
-static FMOD_DSP_PARAMETER_DESC p_doubler_gain;
+const char* Doubler_Interpolation_Names[2] = { "Linear", "Cubic" };
 
-enum
-{
-	DSP_PARAM_LTIME = 0,
-	DSP_PARAM_RTIME,
-	DSP_PARAM_MIX,
-	DSP_PARAM_GAIN,
-
-	DSP_PARAM_NUM_PARAMETERS
-};
-
-FMOD_DSP_PARAMETER_DESC* Doubler_ParameterList[DSP_PARAM_NUM_PARAMETERS] = {
-	&p_doubler_lTime,
-	&p_doubler_rTime,
-	&p_doubler_mix,
-	&p_doubler_gain,
-};
-
-FMOD_DSP_DESCRIPTION Point_Doubler_Desc = {
-	FMOD_PLUGIN_SDK_VERSION,
-	"Point Doubler",		//	name
-	0x00010000,					//	plug-in version
-	1,							//	number of input buffers to process
-	1,							//	number of output buffers to process
-	DOUBLER_DSP_CREATE_CALLBACK,		//	create callback
-	DOUBLER_DSP_RELEASE_CALLBACK,		//	release callback
-	DOUBLER_DSP_RESET_CALLBACK,			//
-	0/*DSP_READ_CALLBACK*/,			//
-	DOUBLER_DSP_PROCESS_CALLBACK,		//
-	0/*DSP_SETPOSITION_CALLBACK*/,	//
-
-	DSP_PARAM_NUM_PARAMETERS,
-	Doubler_ParameterList,
-	DOUBLER_DSP_SETPARAM_FLOAT_CALLBACK,
-	DOUBLER_DSP_SETPARAM_INT_CALLBACK,
-	0,
-	0,
-	DOUBLER_DSP_GETPARAM_FLOAT_CALLBACK,
-	DOUBLER_DSP_GETPARAM_INT_CALLBACK,
-	0,
-	0
-};
+constexpr DSPPluginInfo Doubler::Info;
+constexpr DSPParameter<Doubler> Doubler::Parameters[];
 
 FMOD_DSP_DESCRIPTION* get_doubler() {
-	FMOD_DSP_INIT_PARAMDESC_FLOAT(
-		p_doubler_lTime, "Left Time", "ms", "",
-		0, 500, 0
-	);
-	FMOD_DSP_INIT_PARAMDESC_FLOAT(
-		p_doubler_rTime, "Right Time", "ms", "",
-		0, 500, 50
-	);
-	FMOD_DSP_INIT_PARAMDESC_FLOAT(
-		p_doubler_mix, "Mix", "", "",
-		0, 1, .5f
-	);
-	FMOD_DSP_INIT_PARAMDESC_FLOAT(
-		p_doubler_gain, "Gain", "dB", "Gain in dB. -80 to 10. Default = 0",
-		GAIN_MIN, GAIN_MAX, 0
-	);
-
-	return &Point_Doubler_Desc;
+	return Doubler::description();
 }
 
 /*																									*/
 
 #pragma region Doubler Class
 
-void GetOutChannelCount(FMOD_DSP_STATE* dsp_state, unsigned int* channelcount) {
-	FMOD_SPEAKERMODE in_speakermode, out_speakermode;
-	FMOD_DSP_GETSPEAKERMODE(dsp_state, &in_speakermode, &out_speakermode);
-	
-	switch (out_speakermode)
+// whole[k] + frac[k] = k - delay - slope * k, with 0 <= frac[k] < 1; delay >= 0.
+// The whole samples of `delay` are taken out first, so the positions stay within
+// a run or so of zero and keep a fine fraction however long the ring is.
+static void Doubler_Positions(float delay, float slope, int* whole, float* frac, unsigned int count)
+{
+	int base = (int)delay;
+	float offset = delay - (float)base;
+	// biased so truncation is floor for any slope across the run
+	int bias = 2 + (int)(fabsf(slope) * count);
+
+	for (unsigned int k = 0; k < count; k++)
 	{
-	case FMOD_SPEAKERMODE_MONO:
-		*channelcount = 1;
-		break;
-	case FMOD_SPEAKERMODE_STEREO:
-		*channelcount = 2;
-		break;
-	case FMOD_SPEAKERMODE_QUAD:
-		*channelcount = 4;
-		break;
-	default:
-		*channelcount = 2;
-		break;
+		float position = (float)bias + (float)k - (offset + slope * (float)k);
+		int index = (int)position;
+		whole[k] = index - bias - base;
+		frac[k] = position - (float)index;
 	}
 }
 
-void Doubler::Initialize(FMOD_DSP_STATE* dsp_state) {
-	FMOD_DSP_GETSAMPLERATE(dsp_state, &m_samplerate);
-	FMOD_SPEAKERMODE in_speakermode, out_speakermode;
-	FMOD_DSP_GETSPEAKERMODE(dsp_state, &in_speakermode, &out_speakermode);
-	GetOutChannelCount(dsp_state, &m_channel_count);
-
-	m_time_parameter = (float*)FMOD_DSP_ALLOC(dsp_state, sizeof(float) * m_channel_count);
-
-	size_t ptr_size = sizeof(float*) * m_channel_count;
-
-	m_buffer_size = m_samplerate;
-
-	m_buffer = (float**)FMOD_DSP_ALLOC(dsp_state, ptr_size);
-	m_rd_ptr = (float**)FMOD_DSP_ALLOC(dsp_state, ptr_size);
-	m_wr_ptr = (float**)FMOD_DSP_ALLOC(dsp_state, ptr_size);
+// dst[k] = buffer at (wr + k - delay - slope * k), linearly interpolated.
+// The positions of a whole run are computed first so that loop vectorizes;
+// only the taps are gathered one by one.
+static void Doubler_ReadLinear(const float* buffer, unsigned int mask, unsigned int wr,
+	float delay, float slope, float* dst, unsigned int count)
+{
+	int whole[DOUBLER_RUN_LENGTH];
+	float frac[DOUBLER_RUN_LENGTH];
+	Doubler_Positions(delay, slope, whole, frac, count);
 
-	for (unsigned int channel = 0; channel < m_channel_count; channel++)
+	for (unsigned int k = 0; k < count; k++)
 	{
-		m_buffer[channel] = (float*)FMOD_DSP_ALLOC(dsp_state, sizeof(float) * m_buffer_size);
-
-		m_rd_ptr[channel] = m_buffer[channel];
-		
-		int pos = m_time_parameter[channel] * m_samplerate;
-		m_wr_ptr[channel] = m_rd_ptr[channel] + pos;
-		if (m_buffer[channel] + m_buffer_size <= m_wr_ptr[channel]) {
-			m_wr_ptr[channel] -= m_buffer_size;
-		}
+		unsigned int index = wr + (unsigned int)whole[k];
+		float a = buffer[index & mask];
+		float b = buffer[(index + 1) & mask];
+		dst[k] = a + (b - a) * frac[k];
 	}
 }
-void Doubler::Reserve(FMOD_DSP_STATE* dsp_state) {
-	FMOD_DSP_FREE(dsp_state, m_time_parameter);
+// As Doubler_ReadLinear with 4-point Hermite interpolation.
+static void Doubler_ReadCubic(const float* buffer, unsigned int mask, unsigned int wr,
+	float delay, float slope, float* dst, unsigned int count)
+{
+	int whole[DOUBLER_RUN_LENGTH];
+	float frac[DOUBLER_RUN_LENGTH];
+	Doubler_Positions(delay, slope, whole, frac, count);
 
-	for (unsigned int i = 0; i < m_channel_count; i++)
+	for (unsigned int k = 0; k < count; k++)
 	{
-		FMOD_DSP_FREE(dsp_state, m_buffer[i]);
+		unsigned int index = wr + (unsigned int)whole[k];
+		float p0 = buffer[(index - 1) & mask];
+		float p1 = buffer[index & mask];
+		float p2 = buffer[(index + 1) & mask];
+		float p3 = buffer[(index + 2) & mask];
+		float t = frac[k];
+
+		float c1 = .5f * (p2 - p0);
+		float c2 = p0 - 2.5f * p1 + 2 * p2 - .5f * p3;
+		float c3 = .5f * (p3 - p0) + 1.5f * (p1 - p2);
+		dst[k] = ((c3 * t + c2) * t + c1) * t + p1;
 	}
-
-	FMOD_DSP_FREE(dsp_state, m_buffer);
-	FMOD_DSP_FREE(dsp_state, m_rd_ptr);
-	FMOD_DSP_FREE(dsp_state, m_wr_ptr);
 }
 
-void Doubler::rdPtrCheck() {
-	for (unsigned int i = 0; i < m_channel_count; i++)
+// Which time parameter drives each channel, in FMOD's channel order.
+// Centre and LFE follow Left Time; unknown layouts alternate left and right.
+static void Doubler_ChannelSides(FMOD_SPEAKERMODE speakermode, unsigned char* sides)
+{
+	static const unsigned char surround[DOUBLER_MAX_CHANNELS] = { 0, 1, 0, 0, 1, 0, 1, 0 };
+	static const unsigned char surround71[DOUBLER_MAX_CHANNELS] = { 0, 1, 0, 0, 0, 1, 0, 1 };
+	static const unsigned char alternate[DOUBLER_MAX_CHANNELS] = { 0, 1, 0, 1, 0, 1, 0, 1 };
+
+	const unsigned char* table = alternate;
+	switch (speakermode)
 	{
-		if (m_buffer[i] + m_buffer_size <= m_rd_ptr[i]) {
-			m_rd_ptr[i] = m_buffer[i];
-		}
+	case FMOD_SPEAKERMODE_SURROUND:
+		table = surround;
+		break;
+	case FMOD_SPEAKERMODE_5POINT1:
+	case FMOD_SPEAKERMODE_7POINT1:
+	case FMOD_SPEAKERMODE_7POINT1POINT4:
+		table = surround71;
+		break;
+	default:
+		break;
 	}
+	memcpy(sides, table, DOUBLER_MAX_CHANNELS);
 }
-void Doubler::setBuffer(int channel, float value) {
-	*m_wr_ptr[channel] = value;
-	m_wr_ptr[channel]++;
 
-	if (m_buffer[channel] + m_buffer_size <= m_wr_ptr[channel]) {
-		m_wr_ptr[channel] = m_buffer[channel];
+Doubler* Doubler::create(FMOD_DSP_STATE* dsp_state) {
+	int samplerate;
+	FMOD_DSP_GETSAMPLERATE(dsp_state, &samplerate);
+
+	FMOD_SPEAKERMODE mixer_speakermode, out_speakermode;
+	FMOD_DSP_GETSPEAKERMODE(dsp_state, &mixer_speakermode, &out_speakermode);
+	unsigned int channels = DSPPlugin_MixerChannels(dsp_state);
+
+	// the fractional read head writes a run before reading it and needs two taps past the delay
+	unsigned int size = Ring_Size((unsigned int)samplerate * (DOUBLER_MAX_TIME_MS + DOUBLER_MAX_DEPTH_MS) / 1000
+		+ DOUBLER_RUN_LENGTH + 3);
+	unsigned int stride = size + DOUBLER_CHANNEL_STAGGER;
+
+	Doubler* doubler = allocate(dsp_state, sizeof(float) * stride * channels);
+	if (!doubler) {
+		return 0;
+	}
+
+	size_t arena = (size_t)doubler;
+	doubler->m_samplerate = samplerate;
+	doubler->m_channel_count = channels;
+	doubler->m_buffer_size = size;
+	doubler->m_buffer_mask = size - 1;
+	doubler->m_buffer_stride = stride;
+	doubler->m_buffer = (float*)(arena + sizeof(Doubler));
+	doubler->m_write_stagger = (unsigned int)(arena / DOUBLER_ALIGNMENT) * 16;
+	doubler->m_write_pos = doubler->m_write_stagger;
+
+	doubler->m_gain.init(1, POINT_GAIN_RAMP_MS, samplerate);
+	doubler->m_mix.init(.5f, POINT_MIX_RAMP_MS, samplerate);
+	doubler->m_time_parameter[0] = 0;
+	doubler->m_time_parameter[1] = 0;
+	doubler->m_rate_parameter = .5f;
+	doubler->m_lfo_increment = .5f / samplerate;
+	doubler->m_lfo_depth.init(0, POINT_MIX_RAMP_MS, samplerate);
+	doubler->m_lfo_depth_start = 0;
+	doubler->m_lfo_depth_ramp = 0;
+	doubler->m_speakermode = mixer_speakermode;
+	Doubler_ChannelSides(mixer_speakermode, doubler->m_channel_side);
+	doubler->clear();
+	doubler->updateDelay();
+
+	// Nothing is zeroed here: clear() leaves the lines to processPlanar's lazy
+	// zeroing. A warm instance's planes are mapped already.
+	if (!doubler->warm()) {
+		prefault(doubler->m_buffer, sizeof(float) * stride * channels);
 	}
+
+	return doubler;
 }
 
 float Doubler::getGain()
 {
-	return LINEAR_TO_DECIBELS(m_target_gain);
+	return LINEAR_TO_DECIBELS(m_gain.target());
 }
 void Doubler::setGain(float value)
 {
-	m_target_gain = DECIBELS_TO_LINEAR(value);
-	m_ramp_samples_left = FMOD_NOISE_RAMPCOUNT;
+	m_gain.setTarget(DECIBELS_TO_LINEAR(value));
 }
 
-float Doubler::getTime(int channel) {
-	return m_time_parameter[channel] * 1000;
+float Doubler::getTime(int side) {
+	if ((unsigned int)side >= 2) {
+		return 0;
+	}
+	return m_time_parameter[side] * 1000;
+}
+void Doubler::setTime(int side, float value) {
+	if ((unsigned int)side >= 2) {
+		return;
+	}
+	m_time_parameter[side] = value * .001f;
+	updateDelay();
 }
-void Doubler::setTime(int channel, float value) {
-	m_time_parameter[channel] = value * .001f;
 
-	clear();
+void Doubler::setSpeakerMode(FMOD_SPEAKERMODE speakermode) {
+	if (speakermode == m_speakermode) {
+		return;
+	}
+	m_speakermode = speakermode;
+	Doubler_ChannelSides(speakermode, m_channel_side);
+	updateDelay();
+}
+
+void Doubler::updateDelay() {
+	const unsigned int limit = m_buffer_size - DOUBLER_RUN_LENGTH - 3;
+
+	unsigned int delay[2];
+	for (int side = 0; side < 2; side++)
+	{
+		unsigned int samples = (unsigned int)(m_time_parameter[side] * m_samplerate);
+		delay[side] = samples < limit ? samples : limit;
+
+		// the read head glides from wherever it is now, unless nothing was written since clear()
+		m_delay_current[side] = delayAt(side, 0);
+		m_delay_target[side] = (float)delay[side];
+		m_glide_left[side] = DOUBLER_TIME_RAMPCOUNT;
+		m_delay_step[side] = (m_delay_target[side] - m_delay_current[side]) / DOUBLER_TIME_RAMPCOUNT;
+		if (m_cleared || m_delay_current[side] == m_delay_target[side]) {
+			m_delay_current[side] = m_delay_target[side];
+			m_glide_left[side] = 0;
+		}
+	}
+	for (int channel = 0; channel < DOUBLER_MAX_CHANNELS; channel++)
+	{
+		m_delay[channel] = delay[m_channel_side[channel]];
+	}
+}
+
+float Doubler::delayAt(int side, unsigned int frame) {
+	float delay = m_delay_target[side];
+	if (frame < m_glide_left[side]) {
+		delay = m_delay_current[side] + m_delay_step[side] * frame;
+	}
+	return delay;
+}
+float Doubler::depthAt(unsigned int frame) {
+	// the ramp is linear, so the block's end value and its length place every frame on it
+	float depth = m_lfo_depth.value();
+	if (frame < m_lfo_depth_ramp) {
+		depth = m_lfo_depth_start + (depth - m_lfo_depth_start) * frame / m_lfo_depth_ramp;
+	}
+	return depth;
+}
+float Doubler::modulationAt(int side, unsigned int frame) {
+	// Right runs a quarter cycle behind Left for width
+	float phase = m_lfo_phase + m_lfo_increment * frame + side * .25f;
+	return depthAt(frame) * .5f * (1 - cosf(DOUBLER_TWO_PI * phase));
 }
 
 float Doubler::getMix() {
-	return m_mix;
+	return m_mix.target();
 }
 void Doubler::setMix(float value) {
-	m_mix = value;
+	m_mix.setTarget(value);
+}
 
-	clear();
+float Doubler::getRate() {
+	return m_rate_parameter;
+}
+void Doubler::setRate(float hz) {
+	m_rate_parameter = hz;
+	m_lfo_increment = hz / m_samplerate;
 }
 
-void Doubler::clear() {
-	for (unsigned int channel = 0; channel < m_channel_count; channel++)
-	{
-		memset(m_buffer[channel], 0, sizeof(float) * m_buffer_size);
+float Doubler::getDepth() {
+	return m_depth_parameter;
+}
+void Doubler::setDepth(float ms) {
+	m_depth_parameter = ms;
+	m_lfo_depth.setTarget(ms * .001f * m_samplerate);
+}
 
-		m_rd_ptr[channel] = m_buffer[channel];
+int Doubler::getInterpolation() {
+	return m_interpolation;
+}
+void Doubler::setInterpolation(int value) {
+	m_interpolation = value;
+}
 
-		int pos = m_time_parameter[channel] * m_samplerate;
-		m_wr_ptr[channel] = m_rd_ptr[channel] + pos;
-		if (m_buffer[channel] + m_buffer_size <= m_wr_ptr[channel]) {
-			m_wr_ptr[channel] -= m_buffer_size;
-		}
+unsigned int Doubler::readReach() {
+	float longest = 0;
+	for (int side = 0; side < 2; side++)
+	{
+		if (longest < m_delay_current[side]) longest = m_delay_current[side];
+		if (longest < m_delay_target[side]) longest = m_delay_target[side];
 	}
+	// the depth this block starts at, ends at or ramps towards, whichever reaches furthest
+	float depth = m_lfo_depth_start;
+	if (depth < m_lfo_depth.value()) depth = m_lfo_depth.value();
+	if (depth < m_lfo_depth.target()) depth = m_lfo_depth.target();
+	longest += depth;
+	if (longest < shortestDelay()) longest = shortestDelay();
+
+	const float limit = (float)(m_buffer_size - DOUBLER_RUN_LENGTH - 3);
+	if (limit < longest) longest = limit;
+	return (unsigned int)ceilf(longest) + 2;
+}
+
+float Doubler::shortestDelay() {
+	// The run is written before it is read, so the newest tap the interpolation
+	// takes must fall inside it: one sample behind the head, two for the Hermite's p3.
+	return m_interpolation == DOUBLER_INTERPOLATION_CUBIC ? 2.f : 1.f;
+}
+
+void Doubler::clear() {
+	m_write_pos = m_write_stagger;
+	m_written = 0;
+	m_active_channels = 0;
+	m_cleared = true;
 }
 void Doubler::reset()
 {
-	m_current_gain = m_target_gain;
-	m_ramp_samples_left = 0;
+	m_gain.snap();
+	m_mix.snap();
+	m_lfo_depth.snap();
+	m_lfo_depth_start = m_lfo_depth.value();
+	m_lfo_depth_ramp = 0;
+	for (int side = 0; side < 2; side++)
+	{
+		m_delay_current[side] = m_delay_target[side];
+		m_glide_left[side] = 0;
+	}
 
 	clear();
 }
 
-void Doubler::process(float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int outchannels)
+void Doubler::processChannel(int channel, float* plane, unsigned int length,
+	const float* gainCurve, const float* mixCurve, unsigned int ramp, float steadyGain, float steadyMix)
 {
-	float gain = m_current_gain;
-	unsigned int samples = length * inchannels;
+	float* buffer = m_buffer + channel * m_buffer_stride;
+	unsigned int delay = m_delay[channel];
+	unsigned int wr = m_write_pos;
 
-	if (m_ramp_samples_left) {
-		float target = m_target_gain;
-		float delta = (target - gain) / m_ramp_samples_left;
+	int side = m_channel_side[channel];
+	// the chorus stays on the fractional path until its depth has ramped all the way down
+	bool modulated = 0 < m_lfo_depth_start || 0 < m_lfo_depth.value();
+	bool moving = m_glide_left[side] || modulated;
+	const float limit = (float)(m_buffer_size - DOUBLER_RUN_LENGTH - 3);
+	const float shortest = shortestDelay();
 
-		for (unsigned int i = 0; i < samples; i += inchannels)
-		{
-			if (m_ramp_samples_left--) {
-				gain += delta;
+	float wet[DOUBLER_RUN_LENGTH];
 
-				for (unsigned int channel = 0; channel < inchannels; channel++)
-				{
-					setBuffer(channel, inbuffer[i + channel]);
-					outbuffer[i + channel] = MIX(*m_rd_ptr[channel], inbuffer[i + channel], m_mix) * gain;
+	unsigned int frame = 0;
+	while (frame < length)
+	{
+		unsigned int count = length - frame;
+		if (count > DOUBLER_RUN_LENGTH) count = DOUBLER_RUN_LENGTH;
+		if (frame < ramp && count > ramp - frame) count = ramp - frame;
+		if (frame < m_lfo_depth_ramp && count > m_lfo_depth_ramp - frame) count = m_lfo_depth_ramp - frame;
+
+		// the run is mixed in place, so the dry signal is consumed before the output lands on it
+		const float* dry = plane + frame;
+		float* out = plane + frame;
+
+		if (moving) {
+			// The read head moves linearly across the run. The run is written
+			// first so a head less than a run behind reads this very input.
+			float start = delayAt(side, frame);
+			float end = delayAt(side, frame + count);
+			if (modulated) {
+				start += modulationAt(side, frame);
+				end += modulationAt(side, frame + count);
+			}
+			start = start < shortest ? shortest : (limit < start ? limit : start);
+			end = end < shortest ? shortest : (limit < end ? limit : end);
 
-					m_rd_ptr[channel]++;
-					if (m_buffer[channel] + m_buffer_size <= m_rd_ptr[channel]) {
-						m_rd_ptr[channel] = m_buffer[channel];
-					}
-				}
+			Ring_Write(buffer, m_buffer_mask, wr, dry, count);
+			if (m_interpolation == DOUBLER_INTERPOLATION_CUBIC) {
+				Doubler_ReadCubic(buffer, m_buffer_mask, wr, start, (end - start) / count, wet, count);
+			}
+			else {
+				Doubler_ReadLinear(buffer, m_buffer_mask, wr, start, (end - start) / count, wet, count);
+			}
 
-				//rdPtrCheck();
+			if (frame < ramp) {
+				DSPKernels().mixCurve(wet, dry, out, count, mixCurve + frame, gainCurve + frame);
 			}
 			else {
-				gain = target;
-				break;
+				DSPKernels().mixSteady(wet, dry, out, count, steadyMix, steadyGain);
 			}
+
+			wr += count;
+			frame += count;
+			continue;
 		}
-	}
 
-	for (unsigned int i = 0; i < samples; i += inchannels)
-	{
-		for (unsigned int channel = 0; channel < inchannels; channel++)
-		{
-			setBuffer(channel, inbuffer[i + channel]);
-			outbuffer[i + channel] = MIX(*m_rd_ptr[channel], inbuffer[i + channel], m_mix) * gain;
+		// The delayed signal is read straight from the ring when it is one
+		// contiguous segment. Otherwise it is assembled in `wet`: the first
+		// `delay` frames from the ring, the rest written by this very run and
+		// so taken from the input. A segment read straight from the ring is at
+		// least a run behind the write head, so the run can be written first.
+		unsigned int rd = (wr - delay) & m_buffer_mask;
+		const float* delayed = buffer + rd;
+		if (!delay) {
+			delayed = dry;
+		}
+		else if (delay < count || m_buffer_size < rd + count) {
+			unsigned int history = delay < count ? delay : count;
+			Ring_Read(buffer, m_buffer_mask, rd, wet, history);
+			memcpy(wet + history, dry, sizeof(float) * (count - history));
+			delayed = wet;
+		}
 
-			m_rd_ptr[channel]++;
-			if (m_buffer[channel] + m_buffer_size <= m_rd_ptr[channel]) {
-				m_rd_ptr[channel] = m_buffer[channel];
-			}
+		Ring_Write(buffer, m_buffer_mask, wr, dry, count);
+
+		if (frame < ramp) {
+			DSPKernels().mixCurve(delayed, dry, out, count, mixCurve + frame, gainCurve + frame);
+		}
+		else {
+			DSPKernels().mixSteady(delayed, dry, out, count, steadyMix, steadyGain);
 		}
 
-		//rdPtrCheck();
+		wr += count;
+		frame += count;
 	}
-	
-	m_current_gain = gain;
 }
 
-#pragma endregion
-
-/*																									*/
-
-#pragma region Callbacks
-
-#pragma region Inits
-
-FMOD_RESULT F_CALL DOUBLER_DSP_CREATE_CALLBACK(FMOD_DSP_STATE* dsp_state)
+void Doubler::processPlanar(float* const* planes, unsigned int length, int inchannels)
 {
-	Doubler* data = (Doubler*)FMOD_DSP_ALLOC(dsp_state, sizeof(Doubler));
-	data->Initialize(dsp_state);
-
-	dsp_state->plugindata = data;
-	if (!dsp_state->plugindata) {
-		return FMOD_ERR_MEMORY;
+	// frames at the start of the block where gain or mix still move
+	unsigned int ramp = m_gain.pending(length);
+	unsigned int mixRamp = m_mix.pending(length);
+	if (ramp < mixRamp) ramp = mixRamp;
+
+	float gainCurve[SMOOTHER_MAX_RAMP];
+	float mixCurve[SMOOTHER_MAX_RAMP];
+	if (ramp) {
+		m_gain.fill(gainCurve, ramp);
+		m_mix.fill(mixCurve, ramp);
 	}
+	m_gain.skip(length - ramp);
+	m_mix.skip(length - ramp);
+	float steadyGain = m_gain.value();
+	float steadyMix = m_mix.value();
 
-	return FMOD_OK;
+	processLines(planes, length, inchannels, gainCurve, mixCurve, ramp, steadyGain, steadyMix);
 }
-FMOD_RESULT F_CALL DOUBLER_DSP_RELEASE_CALLBACK(FMOD_DSP_STATE* dsp_state)
+
+void Doubler::processLines(float* const* planes, unsigned int length, int inchannels,
+	const float* gainCurve, const float* mixCurve, unsigned int ramp, float steadyGain, float steadyMix)
 {
-	Doubler* state = (Doubler*)dsp_state->plugindata;
-	state->Reserve(dsp_state);
+	m_lfo_depth_start = m_lfo_depth.value();
+	m_lfo_depth_ramp = m_lfo_depth.pending(length);
+	m_lfo_depth.skip(length);
 
-	FMOD_DSP_FREE(dsp_state, state);
-	return FMOD_OK;
-}
+	int channels = (unsigned int)inchannels < m_channel_count ? inchannels : (int)m_channel_count;
 
-FMOD_RESULT F_CALL DOUBLER_DSP_RESET_CALLBACK(FMOD_DSP_STATE* dsp_state)
-{
-	Doubler* state = (Doubler*)dsp_state->plugindata;
+	// a plane that was not written last block has no usable history
+	if (m_written && m_active_channels < (unsigned int)channels) {
+		memset(m_buffer + m_active_channels * m_buffer_stride, 0,
+			sizeof(float) * m_buffer_stride * (channels - m_active_channels));
+	}
+	m_active_channels = channels;
 
-	state->reset();
+	// zero only the history this block can reach that was never written since clear()
+	unsigned int reach = readReach();
+	if (m_written < reach) {
+		DSP_TRACE_SCOPE(Info.name, "zero history", this);
+		for (int channel = 0; channel < channels; channel++)
+		{
+			Ring_Zero(m_buffer + channel * m_buffer_stride, m_buffer_mask, m_write_pos - reach, reach - m_written);
+		}
+		m_written = reach;
+	}
+	// channels beyond the layout the instance was created for keep their planes, so pass through dry
+	for (int channel = 0; channel < channels; channel++)
+	{
+		processChannel(channel, planes[channel], length, gainCurve, mixCurve, ramp, steadyGain, steadyMix);
+	}
 
-	return FMOD_OK;
+	advance(length);
+
+	m_write_pos += length;
+	m_written = m_buffer_size - m_written < length ? m_buffer_size : m_written + length;
+	m_cleared = false;
 }
 
-FMOD_RESULT F_CALL DOUBLER_DSP_READ_CALLBACK(FMOD_DSP_STATE* dsp_state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int* outchannels)
+void Doubler::advance(unsigned int length)
 {
-	return FMOD_OK;
+	for (int side = 0; side < 2; side++)
+	{
+		unsigned int glide = m_glide_left[side] < length ? m_glide_left[side] : length;
+		m_delay_current[side] += m_delay_step[side] * glide;
+		m_glide_left[side] -= glide;
+		if (!m_glide_left[side]) {
+			m_delay_current[side] = m_delay_target[side];
+		}
+	}
+	m_lfo_phase += m_lfo_increment * length;
+	m_lfo_phase -= floorf(m_lfo_phase);
 }
 
-FMOD_RESULT F_CALL DOUBLER_DSP_SETPOSITION_CALLBACK(FMOD_DSP_STATE* dsp_state, unsigned int pos)
+void Doubler::skip(unsigned int length)
 {
-	return FMOD_OK;
+	m_gain.skip(length);
+	m_mix.skip(length);
+	m_lfo_depth.skip(length);
+	m_lfo_depth_start = m_lfo_depth.value();
+	m_lfo_depth_ramp = 0;
+	advance(length);
+
+	// everything a read could reach is silence, which is what a cleared line holds
+	clear();
 }
 
 #pragma endregion
 
 /*																									*/
 
-FMOD_RESULT F_CALL DOUBLER_DSP_PROCESS_CALLBACK(
-	FMOD_DSP_STATE* dsp_state, unsigned int length,
-	const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray,
-	FMOD_BOOL inputsidle, FMOD_DSP_PROCESS_OPERATION op)
-{
-	Doubler* state = (Doubler*)dsp_state->plugindata;
-
-	if (op == FMOD_DSP_PROCESS_QUERY) {
-
-		if (outbufferarray && inbufferarray)
-		{
-			outbufferarray[0].buffernumchannels[0] = inbufferarray[0].buffernumchannels[0];
-			outbufferarray[0].speakermode = inbufferarray[0].speakermode;
-		}
-
-		if (inputsidle) {
-			state->clear();
-
-			return FMOD_ERR_DSP_DONTPROCESS;
-		}
-
-		return FMOD_OK;
-	}
-
-	//if (inputsidle) {
-	//	return FMOD_ERR_DSP_SILENCE;
-	//}
-
-	state->process(
-		inbufferarray->buffers[0], outbufferarray->buffers[0],
-		length,
-		inbufferarray->buffernumchannels[0],
-		outbufferarray->buffernumchannels[0]);
+#pragma region Callbacks
 
-	return FMOD_OK;
+void Doubler::perform(unsigned int length, const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray)
+{
+	setSpeakerMode(inbufferarray->speakermode);
+	DSPPlugin<Doubler>::perform(length, inbufferarray, outbufferarray);
 }
 
-/*																									*/
-
-FMOD_RESULT F_CALL DOUBLER_DSP_SETPARAM_FLOAT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, float value)
+bool Doubler::batchBegin(BatchLanes& lanes, int base, unsigned int length, int channels, FMOD_SPEAKERMODE speakermode)
 {
-	Doubler* state = (Doubler*)dsp_state->plugindata;
+	setSpeakerMode(speakermode);
 
-	switch (index)
-	{
-	case DSP_PARAM_LTIME:
-		state->setTime(0, value);
-		break;
-	case DSP_PARAM_RTIME:
-		state->setTime(1, value);
-		break;
-	case DSP_PARAM_MIX:
-		state->setMix(value);
-		break;
-	case DSP_PARAM_GAIN:
-		state->setGain(value);
-		break;
-	default:
-		break;
+	// channels past the delay lines pass through ungained, which the lanes cannot
+	float* planes[FMOD_MAX_CHANNEL_WIDTH];
+	if (m_channel_count < (unsigned int)channels || m_gain.pending(length) || m_mix.pending(length)
+		|| !stagedPlanes(planes, length, channels)) {
+		return false;
 	}
+	m_gain.skip(length);
+	m_mix.skip(length);
+	float gain = m_gain.value();
+	float mix = m_mix.value();
 
-	return FMOD_OK;
-}
-FMOD_RESULT F_CALL DOUBLER_DSP_GETPARAM_FLOAT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, float* value, char* valuestr)
-{
-	Doubler* state = (Doubler*)dsp_state->plugindata;
+	// the delayed signal alone, left in the planes for batchGather
+	processLines(planes, length, channels, 0, 0, 0, 1, 1);
 
-	switch (index)
+	for (int channel = 0; channel < channels; channel++)
 	{
-	case DSP_PARAM_LTIME:
-		*value = state->getTime(0);
-		break;
-	case DSP_PARAM_RTIME:
-		*value = state->getTime(1);
-		break;
-	case DSP_PARAM_MIX:
-		*value = state->getMix();
-	case DSP_PARAM_GAIN:
-		*value = state->getGain();
-		break;
-	default:
-		break;
+		lanes.wetGain[base + channel] = mix * gain;
+		lanes.dryGain[base + channel] = (1 - mix) * gain;
 	}
-
-	return FMOD_OK;
+	return true;
 }
-FMOD_RESULT F_CALL DOUBLER_DSP_SETPARAM_INT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, int value)
-{
-	Doubler* state = (Doubler*)dsp_state->plugindata;
-
-	switch (index)
-	{
-	default:
-		break;
-	}
 
-	return FMOD_OK;
-}
-FMOD_RESULT F_CALL DOUBLER_DSP_GETPARAM_INT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, int* value, char* valuestr)
+void Doubler::batchGather(BatchLanes& lanes, int base, unsigned int frame, unsigned int count, int channels)
 {
-	Doubler* state = (Doubler*)dsp_state->plugindata;
+	float* planes[FMOD_MAX_CHANNEL_WIDTH];
+	scratchPlanes(planes, frame + count, channels);
 
-	switch (index)
+	float* lane = lanes.delayed + base;
+	for (unsigned int f = 0; f < count; f++, lane += DSP_BATCH_LANES)
 	{
-	default:
-		break;
+		for (int channel = 0; channel < channels; channel++)
+		{
+			lane[channel] = planes[channel][frame + f];
+		}
 	}
+}
 
-	return FMOD_OK;
+void Doubler::batchTile(BatchLanes& lanes, unsigned int count, unsigned int width)
+{
+	DSPKernels().mixLanes(lanes.delayed, lanes.input, lanes.output, count, width, DSP_BATCH_LANES,
+		lanes.wetGain, lanes.dryGain);
 }
 
-#pragma endregion
\ No newline at end of file
+#pragma endregion
@@ -21,67 +21,200 @@
 #include <stdlib.h>
 
 #include "pch.h"
+#include "ring_buffer.h"
+#include "dsp_plugin.h"
+#include "smoother.h"
 #include "fmod.hpp"
 #include "fmod_dsp.h"
 #include "fmod_studio.hpp"
 
 #endif // !__DOUBLER_H__
 
-FMOD_RESULT F_CALL DOUBLER_DSP_CREATE_CALLBACK(FMOD_DSP_STATE* dsp_state);
-FMOD_RESULT F_CALL DOUBLER_DSP_RELEASE_CALLBACK(FMOD_DSP_STATE* dsp_state);
-FMOD_RESULT F_CALL DOUBLER_DSP_RESET_CALLBACK(FMOD_DSP_STATE* dsp_state);
-FMOD_RESULT F_CALL DOUBLER_DSP_READ_CALLBACK(FMOD_DSP_STATE* dsp_state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int* outchannels);
-FMOD_RESULT F_CALL DOUBLER_DSP_PROCESS_CALLBACK(FMOD_DSP_STATE* dsp_state, unsigned int length, const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray, FMOD_BOOL inputsidle, FMOD_DSP_PROCESS_OPERATION op);
-FMOD_RESULT F_CALL DOUBLER_DSP_SETPOSITION_CALLBACK(FMOD_DSP_STATE* dsp_state, unsigned int pos);
+// frames per SIMD run in Doubler::processChannel
+#define DOUBLER_RUN_LENGTH 64
+// widest layout the delay lines are sized for (7.1)
+#define DOUBLER_MAX_CHANNELS 8
+// upper bound of the Left/Right Time parameters
+#define DOUBLER_MAX_TIME_MS 500
+// upper bound of the chorus Depth parameter; the delay lines hold time + depth
+#define DOUBLER_MAX_DEPTH_MS 20
+// samples a Left/Right Time change glides over instead of jumping
+#define DOUBLER_TIME_RAMPCOUNT 2048
+#define DOUBLER_TWO_PI 6.28318530718f
+// alignment of the instance arena and of every channel plane in it
+#define DOUBLER_ALIGNMENT 64
+// Channel planes are padded by this many samples (and positions are offset per
+// instance, see m_write_stagger) so that many power-of-two delay lines
+// advancing in lockstep do not keep hitting the same cache sets.
+#define DOUBLER_CHANNEL_STAGGER 1040
+
+enum
+{
+	DOUBLER_INTERPOLATION_LINEAR = 0,
+	DOUBLER_INTERPOLATION_CUBIC,
+};
 
-FMOD_RESULT F_CALL DOUBLER_DSP_SETPARAM_FLOAT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, float value);
-FMOD_RESULT F_CALL DOUBLER_DSP_GETPARAM_FLOAT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, float* value, char* valuestr);
-FMOD_RESULT F_CALL DOUBLER_DSP_SETPARAM_INT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, int value);
-FMOD_RESULT F_CALL DOUBLER_DSP_GETPARAM_INT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, int* value, char* valuestr);
+extern const char* Doubler_Interpolation_Names[2];
 
 FMOD_DSP_DESCRIPTION* get_doubler();
 
-class Doubler
+// One Doubler lives at the start of a single DOUBLER_ALIGNMENT-aligned allocation
+// (see DSPPlugin::allocate), followed by its delay lines:
+//
+//   [ Doubler | channel 0 plane | channel 1 plane | ... ]
+//
+// Each plane is m_buffer_stride samples apart, so the hot loop finds a channel's
+// delay line with one multiply instead of a pointer load.
+class alignas(DOUBLER_ALIGNMENT) Doubler : public DSPPlugin<Doubler>
 {
 public:
-	void Initialize(FMOD_DSP_STATE* dsp_state);
-	void Reserve(FMOD_DSP_STATE* dsp_state);
+	// Allocates and initializes an instance sized for the mixer's speaker mode.
+	// Returns null when the allocation fails.
+	static Doubler* create(FMOD_DSP_STATE* dsp_state);
 
 	float getGain();
 	void setGain(float);
 
-	float getTime(int channel);
-	void setTime(int channel, float value);
+	// side 0 = Left Time, side 1 = Right Time
+	float getTime(int side);
+	void setTime(int side, float value);
+	void setLeftTime(float value) { setTime(0, value); }
+	void setRightTime(float value) { setTime(1, value); }
 
 	float getMix();
 	void setMix(float);
 
-	void clear();
-	void reset();
-	void process(float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int outchannels);
-
-private:
-	float m_target_gain;
-	float m_current_gain;
+	// chorus LFO; a depth of 0 turns the modulation off
+	float getRate();
+	void setRate(float hz);
+	float getDepth();
+	void setDepth(float ms);
 
-	//holds = second, input = ms
-	float* m_time_parameter;
+	// DOUBLER_INTERPOLATION_*
+	int getInterpolation();
+	void setInterpolation(int);
 
-	float m_mix;
+	// Maps every channel of `speakermode` to the Left or Right delay.
+	void setSpeakerMode(FMOD_SPEAKERMODE speakermode);
 
-	int m_ramp_samples_left;
+	// Forgets the delay lines. Nothing is zeroed here; process() zeroes the
+	// part of a line it is about to read that was not written since.
+	void clear();
+	void reset();
+	void processPlanar(float* const* planes, unsigned int length, int inchannels);
+
+	// silent input plays out for as long as a read can still reach older signal
+	unsigned int tailLength() { return readReach(); }
+	void skip(unsigned int length);
+	// follows the input's speaker mode before processing
+	void perform(unsigned int length, const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray);
+
+	// Batch pass once gain and mix are steady, see dsp_batch.h: batchBegin runs
+	// the delay lines alone and the pass mixes their output per lane.
+	struct BatchLanes : DSPBatchLanes
+	{
+		alignas(DSP_BATCH_ALIGNMENT) float delayed[DSP_BATCH_TILE * DSP_BATCH_LANES];
+	};
+	bool batchBegin(BatchLanes& lanes, int base, unsigned int length, int channels, FMOD_SPEAKERMODE speakermode);
+	void batchGather(BatchLanes& lanes, int base, unsigned int frame, unsigned int count, int channels);
+	static void batchTile(BatchLanes& lanes, unsigned int count, unsigned int width);
+
+	static constexpr DSPPluginInfo Info = { "Point Doubler", 0x00010000, 1, 1,
+		DSP_PLUGIN_BATCHED | DSP_PLUGIN_OFFLOADABLE | DSP_PLUGIN_PLANAR };
+	static constexpr DSPParameter<Doubler> Parameters[] = {
+		DSPParameter_Float<Doubler>("Left Time", "ms", "", 0, DOUBLER_MAX_TIME_MS, 0, &Doubler::setLeftTime),
+		DSPParameter_Float<Doubler>("Right Time", "ms", "", 0, DOUBLER_MAX_TIME_MS, 50, &Doubler::setRightTime),
+		DSPParameter_Float<Doubler>("Mix", "", "", 0, 1, .5f, &Doubler::setMix),
+		DSPParameter_Float<Doubler>("Gain", "dB", "Gain in dB. -80 to 10. Default = 0", GAIN_MIN, GAIN_MAX, 0, &Doubler::setGain),
+		DSPParameter_Float<Doubler>("Rate", "Hz", "Chorus LFO rate. 0.05 to 5. Default = 0.5", .05f, 5, .5f, &Doubler::setRate),
+		DSPParameter_Float<Doubler>("Depth", "ms", "Chorus LFO depth. 0 turns the chorus off. Default = 0",
+			0, DOUBLER_MAX_DEPTH_MS, 0, &Doubler::setDepth),
+		DSPParameter_Int<Doubler>("Interpolation", "", "Read head interpolation while the delay moves. Default = 0 (linear)",
+			DOUBLER_INTERPOLATION_LINEAR, DOUBLER_INTERPOLATION_CUBIC, DOUBLER_INTERPOLATION_LINEAR,
+			Doubler_Interpolation_Names, &Doubler::setInterpolation),
+	};
 
-	// buffer length
-	int m_buffer_size;
-	// channel count
+private:
+	#pragma region Hot
+
+	Smoother<SmoothLinear> m_gain;
+	Smoother<SmoothOnePole> m_mix;
+
+	// free-running write position shared by every channel; channel reads at m_write_pos - m_delay[channel]
+	unsigned int m_write_pos;
+	// samples behind m_write_pos written since clear(), saturating at m_buffer_size
+	unsigned int m_written;
+	unsigned int m_buffer_mask;
+	// distance between channel planes, in samples
+	unsigned int m_buffer_stride;
+	// channels with a delay line; any further channels pass through dry
 	unsigned int m_channel_count;
+	// channels the last block wrote to
+	unsigned int m_active_channels;
+
+	float* m_buffer;
+	// whole-sample delay per channel, used while its side is neither gliding nor modulated
+	unsigned int m_delay[DOUBLER_MAX_CHANNELS];
+	// 0 = Left, 1 = Right per channel of m_speakermode
+	unsigned char m_channel_side[DOUBLER_MAX_CHANNELS];
+
+	// per side: read head delay in samples, gliding linearly to the target
+	float m_delay_current[2];
+	float m_delay_target[2];
+	float m_delay_step[2];
+	unsigned int m_glide_left[2];
+
+	// chorus LFO, phase in cycles and depth in samples; depth ramps like mix
+	float m_lfo_phase;
+	float m_lfo_increment;
+	Smoother<SmoothLinear> m_lfo_depth;
+	// depth at the start of the current block and the frames of it that still ramp
+	float m_lfo_depth_start;
+	unsigned int m_lfo_depth_ramp;
+	int m_interpolation;
+	// nothing has been written since clear(), so delay changes need no glide
+	bool m_cleared;
+
+	#pragma endregion
+
+	#pragma region Cold
 
-	float** m_buffer;
-	float** m_rd_ptr;
-	float** m_wr_ptr;
-
+	//holds = second, input = ms
+	float m_time_parameter[2];
+	float m_rate_parameter;
+	float m_depth_parameter;
+	FMOD_SPEAKERMODE m_speakermode;
+
+	// buffer length, power of two
+	unsigned int m_buffer_size;
+	unsigned int m_write_stagger;
 	int m_samplerate;
 
-	void rdPtrCheck();
-	void setBuffer(int, float);
-};
\ No newline at end of file
+	#pragma endregion
+
+	void updateDelay();
+	// Samples behind the write head the next block may read: the longest delay
+	// either side is at or gliding to, chorus included, plus interpolation taps.
+	unsigned int readReach();
+	// least delay the fractional read head is held to, by interpolation
+	float shortestDelay();
+	// moves the delay glides and the chorus LFO on by `length` frames
+	void advance(unsigned int length);
+	// read head delay of `side` at `frame` samples into the current block
+	float delayAt(int side, unsigned int frame);
+	// chorus depth at `frame` samples into the current block
+	float depthAt(unsigned int frame);
+	// chorus offset of `side` at `frame` samples into the current block
+	float modulationAt(int side, unsigned int frame);
+
+	// Everything processPlanar does past the gain and mix smoothers: the
+	// channels' delay lines, mixed with gain and mix as processChannel takes them.
+	void processLines(float* const* planes, unsigned int length, int inchannels,
+		const float* gainCurve, const float* mixCurve, unsigned int ramp, float steadyGain, float steadyMix);
+	// Processes one channel plane in place, in runs through the delay line.
+	// Frames before `ramp` take gain and mix from the curves, the rest steadyGain and steadyMix.
+	// While the channel's delay glides or is modulated it is read through a
+	// fractional read head, otherwise at a whole-sample offset.
+	void processChannel(int channel, float* plane, unsigned int length,
+		const float* gainCurve, const float* mixCurve, unsigned int ramp, float steadyGain, float steadyMix);
+};
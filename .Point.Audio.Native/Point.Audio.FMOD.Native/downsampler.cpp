@@ -22,70 +22,25 @@
 #include "fmod_studio.hpp"
 
 #include "downsampler.h"
+#include "simd.h"
+#include "dsp_dispatch.h"
+#include "resampler.h"
 
-/// <summary>
-/// quentize   
-/// </summary>
-static FMOD_DSP_PARAMETER_DESC p_downsample_count;
-/// <summary>
-/// input Ƿ gate ó
-/// </summary>
-static FMOD_DSP_PARAMETER_DESC p_downsample_input_amplitude;
-/// <summary>
-///   mixer
-/// </summary>
-static FMOD_DSP_PARAMETER_DESC p_downsample_noise;
-/// <summary>
-/// μ̵ ƿǲ ΰ ͽ 
-/// </summary>
-static FMOD_DSP_PARAMETER_DESC p_downsample_mix;
-/// <summary>
-///  ƿǲ  
-/// </summary>
-static FMOD_DSP_PARAMETER_DESC p_downsample_gain;
-
-enum
+const char* Downsampler_Mode_Names[2] = { "Hold", "Band-limited" };
+
+constexpr DSPPluginInfo Downsampler::Info;
+constexpr DSPParameter<Downsampler> Downsampler::Parameters[];
+
+// The ratio the Band-limited mode resamples by: input frames per frame at the
+// reduced rate, from Rate when it is set and Sample Count otherwise.
+static void Downsampler_Ratio(int samplerate, int sampleCount, float rate, unsigned int* num, unsigned int* den)
 {
-	DSP_PARAM_SAMPLECOUNT = 0,
-	DSP_PARAM_NOISE,
-	DSP_PARAM_INPUT_AMPLITUDE,
-	DSP_PARAM_MIX,
-	DSP_PARAM_GAIN,
-
-	DSP_PARAM_NUM_PARAMETERS
-};
-
-FMOD_DSP_PARAMETER_DESC* DownSampler_ParameterList[DSP_PARAM_NUM_PARAMETERS] = {
-	&p_downsample_count,
-	&p_downsample_noise,
-	&p_downsample_input_amplitude,
-	&p_downsample_mix,
-	&p_downsample_gain,
-};
-FMOD_DSP_DESCRIPTION Point_Downsampler_Desc = {
-	FMOD_PLUGIN_SDK_VERSION,
-	"Point Downsampler",		//	name
-	0x00010000,					//	plug-in version
-	1,							//	number of input buffers to process
-	1,							//	number of output buffers to process
-	DOWNSAMPLER_DSP_CREATE_CALLBACK,		//	create callback
-	DOWNSAMPLER_DSP_RELEASE_CALLBACK,		//	release callback
-	DOWNSAMPLER_DSP_RESET_CALLBACK,			//
-	0/*DSP_READ_CALLBACK*/,			//
-	DOWNSAMPLER_DSP_PROCESS_CALLBACK,		//
-	0/*DSP_SETPOSITION_CALLBACK*/,	//
-
-	DSP_PARAM_NUM_PARAMETERS,	//	number of parameters
-	DownSampler_ParameterList,				//
-	DOWNSAMPLER_DSP_SETPARAM_FLOAT_CALLBACK,
-	DOWNSAMPLER_DSP_SETPARAM_INT_CALLBACK,
-	0,
-	0,
-	DOWNSAMPLER_DSP_GETPARAM_FLOAT_CALLBACK,
-	DOWNSAMPLER_DSP_GETPARAM_INT_CALLBACK,
-	0,
-	0
-};
+	double ratio = 0 < rate ? (double)samplerate / rate : (double)sampleCount;
+	if (ratio < 1) {
+		ratio = 1;
+	}
+	Resampler_Approximate(ratio, num, den);
+}
 
 #pragma region Downsampler Class
 
@@ -96,9 +51,87 @@ FMOD_DSP_DESCRIPTION Point_Downsampler_Desc = {
 	{
 	}
 
+	Downsampler* Downsampler::create(FMOD_DSP_STATE* dsp_state) {
+		// every table Sample Count alone can ask for, and the fallback for a Rate whose table is missing
+		for (unsigned int count = 1; count <= RESAMPLER_MAX_RATIO; count++)
+		{
+			ResamplerTable_Prepare(count, 1);
+			ResamplerTable_Prepare(1, count);
+		}
+
+		unsigned int channels = DSPPlugin_MixerChannels(dsp_state);
+		unsigned int stride = DOWNSAMPLER_DECIMATE_HISTORY + DOWNSAMPLER_RECONSTRUCT_HISTORY;
+		Downsampler* downsampler = allocate(dsp_state, sizeof(float) * stride * channels);
+		if (!downsampler) {
+			return 0;
+		}
+
+		float* history = (float*)((size_t)downsampler + sizeof(Downsampler));
+		downsampler->m_channel_count = channels;
+		for (unsigned int channel = 0; channel < channels; channel++)
+		{
+			float* plane = history + channel * stride;
+			downsampler->m_decimate[channel].init(plane, DOWNSAMPLER_DECIMATE_HISTORY);
+			downsampler->m_reconstruct[channel].init(plane + DOWNSAMPLER_DECIMATE_HISTORY, DOWNSAMPLER_RECONSTRUCT_HISTORY);
+		}
+		downsampler->m_decimate_table = 0;
+		downsampler->m_reconstruct_table = 0;
+		downsampler->m_resampler_tail = 0;
+
+		downsampler->init(dsp_state);
+		return downsampler;
+	}
+
 	void Downsampler::reset() {
-		m_current_gain = m_target_gain;
-		m_ramp_samples_left = 0;
+		m_gain.snap();
+		m_mix.snap();
+
+		memset(m_held, 0, sizeof(m_held));
+		m_hold_phase = 0;
+		m_ratio_changed = true;
+		m_restart = true;
+
+		m_random.seed(m_seed);
+	}
+
+	unsigned int Downsampler::tailLength() {
+		if (m_mode == DOWNSAMPLER_MODE_BANDLIMITED && m_decimate_table) {
+			return m_resampler_tail;
+		}
+		return holdCount();
+	}
+
+	void Downsampler::skip(unsigned int length) {
+		m_gain.skip(length);
+		m_mix.skip(length);
+
+		// the windows that ended during the skip held silence; the resamplers
+		// have nothing but silence left in their windows and simply pause
+		memset(m_held, 0, sizeof(m_held));
+		unsigned int count = holdCount();
+		m_hold_phase = ((m_hold_phase < count ? m_hold_phase : 0) + length) % count;
+	}
+
+	void Downsampler::setSampleRate(int samplerate) {
+		m_gain.init(1, POINT_GAIN_RAMP_MS, samplerate);
+		m_mix.init(.5f, POINT_MIX_RAMP_MS, samplerate);
+	}
+
+	void Downsampler::setSeed(unsigned long long seed) {
+		m_seed = seed;
+		m_random.seed(seed);
+	}
+
+	void Downsampler::init(FMOD_DSP_STATE* dsp_state) {
+		int samplerate;
+		FMOD_DSP_GETSAMPLERATE(dsp_state, &samplerate);
+
+		m_samplerate = samplerate;
+		m_mode = DOWNSAMPLER_MODE_HOLD;
+		m_rate = 0;
+		setSampleRate(samplerate);
+		setSeed(Random::nextSeed());
+		reset();
 	}
 
 	int Downsampler::getSampleCount() {
@@ -106,14 +139,14 @@ FMOD_DSP_DESCRIPTION Point_Downsampler_Desc = {
 	}
 	void Downsampler::setSampleCount(int count) {
 		current_sampleCount = count;
+		m_ratio_changed = true;
 	}
 
 	float Downsampler::getGain() {
-		return LINEAR_TO_DECIBELS(m_target_gain);
+		return LINEAR_TO_DECIBELS(m_gain.target());
 	}
 	void Downsampler::setGain(float level) {
-		m_target_gain = DECIBELS_TO_LINEAR(level);
-		m_ramp_samples_left = FMOD_NOISE_RAMPCOUNT;
+		m_gain.setTarget(DECIBELS_TO_LINEAR(level));
 	}
 
 	float Downsampler::getNoise() {
@@ -131,264 +164,398 @@ FMOD_DSP_DESCRIPTION Point_Downsampler_Desc = {
 	}
 
 	float Downsampler::getMix() {
-		return m_mix;
+		return m_mix.target();
 	}
 	void Downsampler::setMix(float value) {
-		m_mix = value;
+		m_mix.setTarget(value);
 	}
 
-	float Downsampler::processBufferValue(float element) {
-		float processed = element + (element * (MINUSONE_TO_ONE * m_noiseamplitude));
-
-		element += MINUSONE_TO_ONE * m_noiseamplitude;
+	int Downsampler::getMode() {
+		return m_mode;
+	}
+	void Downsampler::setMode(int mode) {
+		if (mode != m_mode) {
+			// whatever the resamplers held is stale by the time they run again
+			m_restart = true;
+			m_ratio_changed = true;
+		}
+		m_mode = mode;
+	}
 
-		//float processed = MIX(MINUSONE_TO_ONE + element, element, m_noiseamplitude);
-		processed = max(-1, min(1, processed));
+	float Downsampler::getRate() {
+		return m_rate;
+	}
+	void Downsampler::setRate(float hz) {
+		m_rate = hz;
+		m_ratio_changed = true;
+	}
 
-		return processed;
+	void Downsampler::prepare(int index, float value) {
+		if (index != DOWNSAMPLER_PARAMETER_SAMPLE_COUNT && index != DOWNSAMPLER_PARAMETER_RATE) {
+			return;
+		}
+		// the other parameter as last posted, which is what the mixer thread will apply
+		int sampleCount = index == DOWNSAMPLER_PARAMETER_SAMPLE_COUNT ? (int)value : params().getInt(DOWNSAMPLER_PARAMETER_SAMPLE_COUNT);
+		float rate = index == DOWNSAMPLER_PARAMETER_RATE ? value : params().getFloat(DOWNSAMPLER_PARAMETER_RATE);
+
+		unsigned int num, den;
+		Downsampler_Ratio(m_samplerate, sampleCount, rate, &num, &den);
+		ResamplerTable_Prepare(num, den);
+		ResamplerTable_Prepare(den, num);
 	}
-	void Downsampler::process(float* inbuffer, float* outbuffer, unsigned int length, 
-		int inchannels, int outchannels) {
 
-		float gain = m_current_gain;
-		unsigned int samples = length * inchannels;
-		int normalizeCount = current_sampleCount * inchannels;
+	void Downsampler::updateTables() {
+		unsigned int num, den;
+		Downsampler_Ratio(m_samplerate, current_sampleCount, m_rate, &num, &den);
+		const ResamplerTable* decimate = ResamplerTable_Find(num, den);
+		const ResamplerTable* reconstruct = ResamplerTable_Find(den, num);
+		if (!decimate || !reconstruct) {
+			// not prepared, e.g. the cache is full: the nearest whole ratio, built by create
+			unsigned int whole = (num + den / 2) / den;
+			if (whole < 1) whole = 1;
+			if (whole > RESAMPLER_MAX_RATIO) whole = RESAMPLER_MAX_RATIO;
+			num = whole;
+			den = 1;
+			decimate = ResamplerTable_Find(num, 1);
+			reconstruct = ResamplerTable_Find(1, num);
+		}
+		if (!decimate || !reconstruct) {
+			return;
+		}
 
-		if (m_ramp_samples_left) {
-			float target = m_target_gain;
-			float delta = (target - gain) / m_ramp_samples_left;
+		bool restart = m_restart || !m_decimate_table;
+		for (unsigned int channel = 0; channel < m_channel_count; channel++)
+		{
+			if (restart) {
+				m_decimate[channel].reset(decimate, 0);
+				m_reconstruct[channel].reset(reconstruct, DOWNSAMPLER_RESAMPLER_SLACK);
+			}
+			else {
+				m_decimate[channel].setTable(decimate);
+				m_reconstruct[channel].setTable(reconstruct);
+			}
+		}
+		m_decimate_table = decimate;
+		m_reconstruct_table = reconstruct;
+		// the decimating window, then the reconstructing one and its slack at the reduced rate
+		m_resampler_tail = decimate->taps
+			+ (reconstruct->taps + DOWNSAMPLER_RESAMPLER_SLACK + 2) * ((num + den - 1) / den);
+		m_ratio_changed = false;
+		m_restart = false;
+	}
 
-			for (unsigned int i = 0; i < samples; i += normalizeCount)
-			{
-				if (0 < m_ramp_samples_left) {
+	void Downsampler::processHoldValues(const float* input, float* held, unsigned int count) {
+		float noise[DOWNSAMPLER_RUN_LENGTH];
+		m_random.fill(noise, count);
 
-					gain += delta;
+		vfloat amplitude = simd_set1(m_noiseamplitude);
+		vfloat lo = simd_set1(-1.0f);
+		vfloat hi = simd_set1(1.0f);
 
-					float processed = processBufferValue(inbuffer[i]);
+		unsigned int i = 0;
+		for (; i + POINT_SIMD_WIDTH <= count; i += POINT_SIMD_WIDTH)
+		{
+			vfloat element = simd_load(input + i);
+			vfloat processed = simd_madd(simd_mul(element, simd_load(noise + i)), amplitude, element);
+			simd_store(held + i, simd_max(lo, simd_min(hi, processed)));
+		}
+		for (; i < count; i++)
+		{
+			float processed = input[i] + (input[i] * (noise[i] * m_noiseamplitude));
+			held[i] = fmaxf(-1.0f, fminf(1.0f, processed));
+		}
+	}
 
-					outbuffer[i] = MIX(processed, inbuffer[i], m_mix) * gain;
-					for (int j = 1; 
-						j < normalizeCount && i + j < samples && 0 < m_ramp_samples_left; j++, 
-						m_ramp_samples_left--)
-					{
-						//outbuffer[i + j] = processed;
-						outbuffer[i + j] = MIX(processed, inbuffer[i + j], m_mix) * gain;
-					}
+	// wet[w * N + j] = held[w] for j < N, as broadcast stores where the vector width allows.
+	template <int N>
+	static inline void Downsampler_Expand(const float* held, float* wet, unsigned int windows) {
+		for (unsigned int w = 0; w < windows; w++, wet += N)
+		{
+			if (N % POINT_SIMD_WIDTH == 0) {
+				vfloat value = simd_set1(held[w]);
+				for (int j = 0; j < N; j += POINT_SIMD_WIDTH)
+				{
+					simd_store(wet + j, value);
 				}
-				else {
-					gain = target;
-					break;
+			}
+			else {
+				for (int j = 0; j < N; j++)
+				{
+					wet[j] = held[w];
 				}
 			}
 		}
-
-		for (unsigned int i = 0; i < samples; i += normalizeCount)
+	}
+	static inline void Downsampler_ExpandN(const float* held, float* wet, unsigned int windows, unsigned int holdCount) {
+		for (unsigned int w = 0; w < windows; w++, wet += holdCount)
 		{
-			float processed = processBufferValue(inbuffer[i]);
-			
-			//outbuffer[i] = processed;
-			outbuffer[i] = MIX(processed, inbuffer[i], m_mix) * gain;
-			for (int j = 1; j < normalizeCount && i + j < samples; j++)
+			for (unsigned int j = 0; j < holdCount; j++)
 			{
-				//outbuffer[i + j] = processed;
-				outbuffer[i + j] = MIX(processed, inbuffer[i + j], m_mix) * gain;
+				wet[j] = held[w];
 			}
 		}
-
-		m_current_gain = gain;
 	}
 
-#pragma endregion
+	void Downsampler::processChannel(int channel, float* plane, unsigned int length,
+		unsigned int holdCount, unsigned int phase,
+		const float* gainCurve, const float* mixCurve, unsigned int ramp, float steadyGain, float steadyMix) {
 
-FMOD_DSP_DESCRIPTION* get_downsampler() {
-	FMOD_DSP_INIT_PARAMDESC_INT(
-		p_downsample_count, "Sample Count", "Sample(s)", "Count for downsampling. 1 to 32. Default = 4", 
-		1, 32, 4, false, 0);
-	FMOD_DSP_INIT_PARAMDESC_FLOAT(
-		p_downsample_noise, "Noise", "", "",
-		0, 1, .02f
-		);
-	FMOD_DSP_INIT_PARAMDESC_FLOAT(
-		p_downsample_input_amplitude, "Gate", "", "",
-		0, 1, .01f
-		);
-	FMOD_DSP_INIT_PARAMDESC_FLOAT(
-		p_downsample_mix, "Mix", "", "",
-		0, 1, .5f
-		);
-	FMOD_DSP_INIT_PARAMDESC_FLOAT(
-		p_downsample_gain, "Gain", "dB", "Gain in dB. -80 to 10. Default = 0",
-		GAIN_MIN, GAIN_MAX, 0
-		);
-
-	return &Point_Downsampler_Desc;
-}
+		float wet[DOWNSAMPLER_RUN_LENGTH];
+		float input[DOWNSAMPLER_RUN_LENGTH];
+		float held[DOWNSAMPLER_RUN_LENGTH];
 
-#pragma region Callbacks
+		float current = m_held[channel];
 
-	#pragma region Inits
+		unsigned int frame = 0;
+		while (frame < length)
+		{
+			unsigned int count = length - frame;
+			if (count > DOWNSAMPLER_RUN_LENGTH) count = DOWNSAMPLER_RUN_LENGTH;
+			if (frame < ramp && count > ramp - frame) count = ramp - frame;
+
+			// mixed in place; the dry signal is read before the output lands on it
+			const float* dry = plane + frame;
+			float* out = plane + frame;
+
+			// rest of the window that started in an earlier run or block
+			unsigned int k = 0;
+			if (phase) {
+				k = holdCount - phase < count ? holdCount - phase : count;
+				for (unsigned int j = 0; j < k; j++)
+				{
+					wet[j] = current;
+				}
+			}
 
-	FMOD_RESULT F_CALL DOWNSAMPLER_DSP_CREATE_CALLBACK(FMOD_DSP_STATE* dsp_state)
-	{
-		dsp_state->plugindata = (Downsampler*)FMOD_DSP_ALLOC(dsp_state, sizeof(Downsampler));
-		if (!dsp_state->plugindata) {
-			return FMOD_ERR_MEMORY;
-		}
+			// windows starting in this run, the last one possibly cut short
+			unsigned int windows = (count - k + holdCount - 1) / holdCount;
+			if (windows) {
+				if (holdCount == 1) {
+					processHoldValues(dry + k, wet + k, windows);
+					current = wet[count - 1];
+				}
+				else {
+					for (unsigned int w = 0; w < windows; w++)
+					{
+						input[w] = dry[k + w * holdCount];
+					}
+					processHoldValues(input, held, windows);
 
-		return FMOD_OK;
-	}
-	FMOD_RESULT F_CALL DOWNSAMPLER_DSP_RELEASE_CALLBACK(FMOD_DSP_STATE* dsp_state)
-	{
-		Downsampler* state = (Downsampler*)dsp_state->plugindata;
-		FMOD_DSP_FREE(dsp_state, state);
-		return FMOD_OK;
-	}
+					unsigned int full = (count - k) / holdCount;
+					switch (holdCount)
+					{
+					case 2:
+						Downsampler_Expand<2>(held, wet + k, full);
+						break;
+					case 4:
+						Downsampler_Expand<4>(held, wet + k, full);
+						break;
+					case 8:
+						Downsampler_Expand<8>(held, wet + k, full);
+						break;
+					default:
+						Downsampler_ExpandN(held, wet + k, full, holdCount);
+						break;
+					}
 
-	FMOD_RESULT F_CALL DOWNSAMPLER_DSP_RESET_CALLBACK(FMOD_DSP_STATE* dsp_state)
-	{
-		Downsampler* state = (Downsampler*)dsp_state->plugindata;
+					current = held[windows - 1];
+					for (unsigned int j = k + full * holdCount; j < count; j++)
+					{
+						wet[j] = current;
+					}
+				}
+			}
 
-		state->reset();
+			phase = (phase + count) % holdCount;
 
-		return FMOD_OK;
-	}
+			if (frame < ramp) {
+				DSPKernels().mixCurve(wet, dry, out, count, mixCurve + frame, gainCurve + frame);
+			}
+			else {
+				DSPKernels().mixSteady(wet, dry, out, count, steadyMix, steadyGain);
+			}
 
-	FMOD_RESULT F_CALL DOWNSAMPLER_DSP_READ_CALLBACK(FMOD_DSP_STATE* dsp_state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int* outchannels)
-	{
-		return FMOD_OK;
-	}
+			frame += count;
+		}
 
-	FMOD_RESULT F_CALL DOWNSAMPLER_DSP_SETPOSITION_CALLBACK(FMOD_DSP_STATE* dsp_state, unsigned int pos)
-	{
-		return FMOD_OK;
+		m_held[channel] = current;
 	}
 
-	#pragma endregion
+	void Downsampler::processChannelResampled(int channel, float* plane, unsigned int length,
+		const float* gainCurve, const float* mixCurve, unsigned int ramp, float steadyGain, float steadyMix) {
 
-	FMOD_RESULT F_CALL DOWNSAMPLER_DSP_PROCESS_CALLBACK(
-		FMOD_DSP_STATE* dsp_state, unsigned int length, 
-		const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray, 
-		FMOD_BOOL inputsidle, FMOD_DSP_PROCESS_OPERATION op)
-	{
-		Downsampler* state = (Downsampler*)dsp_state->plugindata;
+		float reduced[DOWNSAMPLER_RUN_LENGTH];
+		float wet[DOWNSAMPLER_RUN_LENGTH];
 
-		if (op == FMOD_DSP_PROCESS_QUERY) {
+		Resampler& decimate = m_decimate[channel];
+		Resampler& reconstruct = m_reconstruct[channel];
+		// frames the reconstruction keeps past its next window while it keeps up
+		const unsigned int settled = m_reconstruct_table->taps - 1 + DOWNSAMPLER_RESAMPLER_SLACK;
 
-			if (outbufferarray && inbufferarray)
+		unsigned int frame = 0;
+		while (frame < length)
+		{
+			unsigned int count = length - frame;
+			if (count > DOWNSAMPLER_RUN_LENGTH) count = DOWNSAMPLER_RUN_LENGTH;
+			if (frame < ramp && count > ramp - frame) count = ramp - frame;
+
+			const float* dry = plane + frame;
+			float* out = plane + frame;
+
+			// at most one reduced frame per input frame, the ratio being at least 1
+			decimate.write(dry, count);
+			unsigned int reducedCount = decimate.read(reduced, count);
+			// the same noise and clipping a held window gets, once per reduced frame
+			processHoldValues(reduced, reduced, reducedCount);
+			reconstruct.write(reduced, reducedCount);
+
+			unsigned int produced = reconstruct.read(wet, count);
+			// short only across a ratio change; the last frame holds meanwhile
+			float last = produced ? wet[produced - 1] : m_held[channel];
+			for (unsigned int j = produced; j < count; j++)
 			{
-				outbufferarray[0].buffernumchannels[0] = inbufferarray[0].buffernumchannels[0];
-				outbufferarray[0].speakermode = inbufferarray[0].speakermode;
+				wet[j] = last;
+			}
+			m_held[channel] = wet[count - 1];
+			// a ratio change may also leave a surplus, which would only add latency
+			if (reconstruct.available() > settled + DOWNSAMPLER_RESAMPLER_SLACK) {
+				reconstruct.drop(reconstruct.available() - settled);
 			}
 
-			if (inputsidle) {
-				return FMOD_ERR_DSP_DONTPROCESS;
+			if (frame < ramp) {
+				DSPKernels().mixCurve(wet, dry, out, count, mixCurve + frame, gainCurve + frame);
+			}
+			else {
+				DSPKernels().mixSteady(wet, dry, out, count, steadyMix, steadyGain);
 			}
 
-			return FMOD_OK;
+			frame += count;
 		}
+	}
 
-		//if (inputsidle) {
-		//	return FMOD_ERR_DSP_SILENCE;
-		//}
+	void Downsampler::processPlanar(float* const* planes, unsigned int length, int channels) {
 
-		state->process(
-			inbufferarray->buffers[0], outbufferarray->buffers[0], 
-			length, 
-			inbufferarray->buffernumchannels[0],
-			outbufferarray->buffernumchannels[0]);
+		// frames at the start of the block where gain or mix still move
+		unsigned int ramp = m_gain.pending(length);
+		unsigned int mixRamp = m_mix.pending(length);
+		if (ramp < mixRamp) ramp = mixRamp;
 
-		return FMOD_OK;
-	}
-	
-	/*																									*/
+		float gainCurve[SMOOTHER_MAX_RAMP];
+		float mixCurve[SMOOTHER_MAX_RAMP];
+		if (ramp) {
+			m_gain.fill(gainCurve, ramp);
+			m_mix.fill(mixCurve, ramp);
+		}
+		m_gain.skip(length - ramp);
+		m_mix.skip(length - ramp);
+		float steadyGain = m_gain.value();
+		float steadyMix = m_mix.value();
 
-	FMOD_RESULT F_CALL DOWNSAMPLER_DSP_SETPARAM_FLOAT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, float value)
-	{
-		Downsampler* state = (Downsampler*)dsp_state->plugindata;
+		unsigned int count = holdCount();
+		unsigned int phase = m_hold_phase < count ? m_hold_phase : 0;
 
-		switch (index)
+		bool resampled = m_mode == DOWNSAMPLER_MODE_BANDLIMITED;
+		if (resampled && m_ratio_changed) {
+			updateTables();
+		}
+		resampled = resampled && m_decimate_table;
+
+		for (int channel = 0; channel < channels; channel++)
 		{
-		case DSP_PARAM_NOISE:
-			state->setNoise(value);
-			break;
-		case DSP_PARAM_INPUT_AMPLITUDE:
-			state->setInputAmplitude(value);
-			break;
-		case DSP_PARAM_MIX:
-			state->setMix(value);
-			break;
-		case DSP_PARAM_GAIN:
-			state->setGain(value);
-			break;
-		default:
-			break;
+			if (resampled && (unsigned int)channel < m_channel_count) {
+				processChannelResampled(channel, planes[channel], length,
+					gainCurve, mixCurve, ramp, steadyGain, steadyMix);
+				continue;
+			}
+			processChannel(channel, planes[channel], length,
+				count, phase, gainCurve, mixCurve, ramp, steadyGain, steadyMix);
 		}
 
-		return FMOD_OK;
+		m_hold_phase = (phase + length) % count;
 	}
-	FMOD_RESULT F_CALL DOWNSAMPLER_DSP_GETPARAM_FLOAT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, float* value, char* valuestr)
-	{
-		Downsampler* state = (Downsampler*)dsp_state->plugindata;
 
-		switch (index)
+	bool Downsampler::batchBegin(BatchLanes& lanes, int base, unsigned int length, int channels, FMOD_SPEAKERMODE /*speakermode*/) {
+		// the resamplers and the gain and mix ramps stay with processPlanar
+		float* noise[FMOD_MAX_CHANNEL_WIDTH];
+		if (m_mode != DOWNSAMPLER_MODE_HOLD || m_gain.pending(length) || m_mix.pending(length)
+			|| !scratchPlanes(noise, length, channels)) {
+			return false;
+		}
+		m_gain.skip(length);
+		m_mix.skip(length);
+		float gain = m_gain.value();
+		float mix = m_mix.value();
+
+		unsigned int count = holdCount();
+		unsigned int phase = m_hold_phase < count ? m_hold_phase : 0;
+		unsigned int first = phase ? count - phase : 0;
+		unsigned int windows = first < length ? (length - first + count - 1) / count : 0;
+		// channel by channel, the order processChannel draws in
+		for (int channel = 0; channel < channels; channel++)
 		{
-		case DSP_PARAM_NOISE:
-			*value = state->getNoise();
-
-			break;
-		case DSP_PARAM_INPUT_AMPLITUDE:
-			*value = state->getInputAmplitude();
-
-			break;
-		case DSP_PARAM_MIX:
-			*value = state->getMix();
-			break;
-		case DSP_PARAM_GAIN:
-			*value = state->getGain();
-			//if (valuestr) {
-			//	sprintf(valuestr, "%.1f dB", state->getGain());
-			//}
-
-			break;
-		default:
-			break;
+			m_random.fill(noise[channel], windows);
 		}
 
-		return FMOD_OK;
+		for (int channel = 0; channel < channels; channel++)
+		{
+			lanes.wetGain[base + channel] = mix * gain;
+			lanes.dryGain[base + channel] = (1 - mix) * gain;
+			lanes.held[base + channel] = m_held[channel];
+			lanes.amplitude[base + channel] = m_noiseamplitude;
+		}
+		return true;
 	}
-	FMOD_RESULT F_CALL DOWNSAMPLER_DSP_SETPARAM_INT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, int value)
-	{
-		Downsampler* state = (Downsampler*)dsp_state->plugindata;
 
-		switch (index)
-		{
-		case DSP_PARAM_SAMPLECOUNT:
+	void Downsampler::batchGather(BatchLanes& lanes, int base, unsigned int frame, unsigned int count, int channels) {
+		float* noise[FMOD_MAX_CHANNEL_WIDTH];
+		scratchPlanes(noise, frame + count, channels);
+
+		unsigned int hold = holdCount();
+		unsigned int phase = m_hold_phase < hold ? m_hold_phase : 0;
+		unsigned int first = phase ? hold - phase : 0;
+		// window the next start begins, and frames of the current one written before `frame`
+		unsigned int window = frame <= first ? 0 : (frame - first + hold - 1) / hold;
+		unsigned int offset = (phase + frame) % hold;
 
-			state->setSampleCount(value);
-			break;
-		default:
-			break;
+		for (unsigned int f = 0; f < count; f++, offset++)
+		{
+			if (offset == hold) {
+				offset = 0;
+			}
+			unsigned int* gate = lanes.gate + f * DSP_BATCH_LANES + base;
+			unsigned int start = offset ? 0 : ~0u;
+			for (int channel = 0; channel < channels; channel++)
+			{
+				gate[channel] = start;
+			}
+			if (!offset) {
+				float* value = lanes.noise + f * DSP_BATCH_LANES + base;
+				for (int channel = 0; channel < channels; channel++)
+				{
+					value[channel] = noise[channel][window];
+				}
+				window++;
+			}
 		}
+	}
 
-		return FMOD_OK;
+	void Downsampler::batchTile(BatchLanes& lanes, unsigned int count, unsigned int width) {
+		DSPKernels().holdLanes(lanes.input, lanes.noise, lanes.gate, lanes.output, count, width, DSP_BATCH_LANES,
+			lanes.held, lanes.amplitude, lanes.wetGain, lanes.dryGain);
 	}
-	FMOD_RESULT F_CALL DOWNSAMPLER_DSP_GETPARAM_INT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, int* value, char* valuestr)
-	{
-		Downsampler* state = (Downsampler*)dsp_state->plugindata;
 
-		switch (index)
+	void Downsampler::batchEnd(const BatchLanes& lanes, int base, unsigned int length, int channels) {
+		for (int channel = 0; channel < channels; channel++)
 		{
-		case DSP_PARAM_SAMPLECOUNT:
-
-			*value = state->getSampleCount();
-			//if (valuestr) sprintf(valuestr, "%s", state->getSampleCount());
-
-			break;
-		default:
-			break;
+			m_held[channel] = lanes.held[base + channel];
 		}
-
-		return FMOD_OK;
+		unsigned int count = holdCount();
+		unsigned int phase = m_hold_phase < count ? m_hold_phase : 0;
+		m_hold_phase = (phase + length) % count;
 	}
 
-#pragma endregion
\ No newline at end of file
+#pragma endregion
+
+FMOD_DSP_DESCRIPTION* get_downsampler() {
+	return Downsampler::description();
+}
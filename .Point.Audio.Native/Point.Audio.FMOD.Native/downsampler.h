@@ -21,32 +21,59 @@
 #include <stdlib.h>
 
 #include "pch.h"
+#include "random.h"
+#include "dsp_plugin.h"
+#include "resampler.h"
+#include "smoother.h"
 #include "fmod.hpp"
 #include "fmod_dsp.h"
 #include "fmod_studio.hpp"
 
 #endif // ! __DOWNSAMPLER_H__
 
-FMOD_RESULT F_CALL DOWNSAMPLER_DSP_CREATE_CALLBACK(FMOD_DSP_STATE* dsp_state);
-FMOD_RESULT F_CALL DOWNSAMPLER_DSP_RELEASE_CALLBACK(FMOD_DSP_STATE* dsp_state);
-FMOD_RESULT F_CALL DOWNSAMPLER_DSP_RESET_CALLBACK(FMOD_DSP_STATE* dsp_state);
-FMOD_RESULT F_CALL DOWNSAMPLER_DSP_READ_CALLBACK(FMOD_DSP_STATE* dsp_state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int* outchannels);
-FMOD_RESULT F_CALL DOWNSAMPLER_DSP_PROCESS_CALLBACK(FMOD_DSP_STATE* dsp_state, unsigned int length, const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray, FMOD_BOOL inputsidle, FMOD_DSP_PROCESS_OPERATION op);
-FMOD_RESULT F_CALL DOWNSAMPLER_DSP_SETPOSITION_CALLBACK(FMOD_DSP_STATE* dsp_state, unsigned int pos);
+// frames per run in Downsampler::processChannel
+#define DOWNSAMPLER_RUN_LENGTH RESAMPLER_RUN_LENGTH
+// upper bound of the Rate parameter
+#define DOWNSAMPLER_MAX_RATE 24000
+// low-rate frames the reconstructing resampler is primed with past its window;
+// covers the jitter between what decimation hands it and what it uses per run
+#define DOWNSAMPLER_RESAMPLER_SLACK 3
+// floats of resampler history per channel: decimation, then reconstruction
+#define DOWNSAMPLER_DECIMATE_HISTORY RESAMPLER_HISTORY(RESAMPLER_MAX_TAPS)
+#define DOWNSAMPLER_RECONSTRUCT_HISTORY RESAMPLER_HISTORY(RESAMPLER_INTERPOLATE_TAPS)
+
+enum
+{
+	// every window holds its first sample, aliasing on purpose
+	DOWNSAMPLER_MODE_HOLD = 0,
+	// decimates to the reduced rate and reconstructs from it, band-limited both ways
+	DOWNSAMPLER_MODE_BANDLIMITED,
+};
+
+// indices into Downsampler::Parameters that the resampler tables depend on
+enum
+{
+	DOWNSAMPLER_PARAMETER_SAMPLE_COUNT = 0,
+	DOWNSAMPLER_PARAMETER_RATE = 6,
+};
 
-FMOD_RESULT F_CALL DOWNSAMPLER_DSP_SETPARAM_FLOAT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, float value);
-FMOD_RESULT F_CALL DOWNSAMPLER_DSP_GETPARAM_FLOAT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, float* value, char* valuestr);
-FMOD_RESULT F_CALL DOWNSAMPLER_DSP_SETPARAM_INT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, int value);
-FMOD_RESULT F_CALL DOWNSAMPLER_DSP_GETPARAM_INT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, int* value, char* valuestr);
+extern const char* Downsampler_Mode_Names[2];
 
 FMOD_DSP_DESCRIPTION* get_downsampler();
 
-class Downsampler
+// The instance is followed by the resampler history of every channel the
+// mixer's layout has (see create), used by the Band-limited mode.
+class Downsampler : public DSPPlugin<Downsampler>
 {
 public:
 	Downsampler();
 	~Downsampler();
 
+	// Allocates an instance with resampler history for the mixer's speaker
+	// mode, and builds the tables of every whole ratio Sample Count reaches.
+	// Returns null when the allocation fails.
+	static Downsampler* create(FMOD_DSP_STATE* dsp_state);
+
 	int getSampleCount();
 	void setSampleCount(int);
 
@@ -62,20 +89,111 @@ public:
 	float getMix();
 	void setMix(float);
 
-	float processBufferValue(float element);
+	// DOWNSAMPLER_MODE_*
+	int getMode();
+	void setMode(int);
+
+	// reduced rate of the Band-limited mode in Hz, 0 to follow Sample Count
+	float getRate();
+	void setRate(float hz);
 
+	// sets up the gain and mix smoothers
+	void setSampleRate(int samplerate);
+	void setSeed(unsigned long long seed);
+
+	void init(FMOD_DSP_STATE* dsp_state);
 	void reset();
-	void process(float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int outchannels);
+	// builds the resampler tables a Sample Count or Rate change will look up
+	void prepare(int index, float value);
+	void processPlanar(float* const* planes, unsigned int length, int channels);
+
+	// a held value outlives silent input by at most one window, a resampled
+	// one by both resamplers' windows
+	unsigned int tailLength();
+	void skip(unsigned int length);
+
+	// Batch pass of the Hold mode once gain and mix are steady, see dsp_batch.h:
+	// per lane the noise drawn for each window start, a mask of the frames that
+	// start a window, and the value held across tiles.
+	struct BatchLanes : DSPBatchLanes
+	{
+		alignas(DSP_BATCH_ALIGNMENT) float noise[DSP_BATCH_TILE * DSP_BATCH_LANES];
+		alignas(DSP_BATCH_ALIGNMENT) unsigned int gate[DSP_BATCH_TILE * DSP_BATCH_LANES];
+		alignas(DSP_BATCH_ALIGNMENT) float held[DSP_BATCH_LANES];
+		alignas(DSP_BATCH_ALIGNMENT) float amplitude[DSP_BATCH_LANES];
+	};
+	// draws the block's noise into the scratch planes, one value per window start
+	bool batchBegin(BatchLanes& lanes, int base, unsigned int length, int channels, FMOD_SPEAKERMODE speakermode);
+	void batchGather(BatchLanes& lanes, int base, unsigned int frame, unsigned int count, int channels);
+	static void batchTile(BatchLanes& lanes, unsigned int count, unsigned int width);
+	void batchEnd(const BatchLanes& lanes, int base, unsigned int length, int channels);
+
+	static constexpr DSPPluginInfo Info = { "Point Downsampler", 0x00010000, 1, 1,
+		DSP_PLUGIN_BATCHED | DSP_PLUGIN_OFFLOADABLE | DSP_PLUGIN_PLANAR };
+	static constexpr DSPParameter<Downsampler> Parameters[] = {
+		// length of the quantized window
+		DSPParameter_Int<Downsampler>("Sample Count", "Sample(s)", "Count for downsampling. 1 to 32. Default = 4",
+			1, 32, 4, nullptr, &Downsampler::setSampleCount),
+		// random noise mixed into each held value
+		DSPParameter_Float<Downsampler>("Noise", "", "", 0, 1, .02f, &Downsampler::setNoise),
+		// gate on the input value
+		DSPParameter_Float<Downsampler>("Gate", "", "", 0, 1, .01f, &Downsampler::setInputAmplitude),
+		// level of the processed output against the original
+		DSPParameter_Float<Downsampler>("Mix", "", "", 0, 1, .5f, &Downsampler::setMix),
+		// final output gain
+		DSPParameter_Float<Downsampler>("Gain", "dB", "Gain in dB. -80 to 10. Default = 0", GAIN_MIN, GAIN_MAX, 0, &Downsampler::setGain),
+		// DOWNSAMPLER_MODE_*
+		DSPParameter_Int<Downsampler>("Mode", "", "Hold aliases, Band-limited resamples cleanly. Default = 0 (Hold)",
+			DOWNSAMPLER_MODE_HOLD, DOWNSAMPLER_MODE_BANDLIMITED, DOWNSAMPLER_MODE_HOLD, Downsampler_Mode_Names, &Downsampler::setMode),
+		// reduced rate of the Band-limited mode
+		DSPParameter_Float<Downsampler>("Rate", "Hz", "Band-limited rate in Hz. 0 = sample rate / Sample Count. Default = 0",
+			0, DOWNSAMPLER_MAX_RATE, 0, &Downsampler::setRate),
+	};
 
 private:
 	int current_sampleCount;
 	float m_noiseamplitude;
 	float m_inputamplitude;
 
-	float m_mix;
-
-	float m_target_gain;
-	float m_current_gain;
-
-	int m_ramp_samples_left;
+	Smoother<SmoothLinear> m_gain;
+	Smoother<SmoothOnePole> m_mix;
+
+	unsigned long long m_seed;
+	Random m_random;
+
+	// value each channel holds for the current window
+	float m_held[FMOD_MAX_CHANNEL_WIDTH];
+	// frames of the current window already written
+	unsigned int m_hold_phase;
+
+	int m_samplerate;
+	int m_mode;
+	float m_rate;
+	// Sample Count, Rate or Mode changed since the tables were looked up
+	bool m_ratio_changed;
+	// the resamplers start over from silence with the next tables
+	bool m_restart;
+	// null until the Band-limited mode first runs
+	const ResamplerTable* m_decimate_table;
+	const ResamplerTable* m_reconstruct_table;
+	// tailLength() of the Band-limited mode
+	unsigned int m_resampler_tail;
+	// channels with resampler history; any further ones are held instead
+	unsigned int m_channel_count;
+	Resampler m_decimate[DSP_PLUGIN_MAX_CHANNELS];
+	Resampler m_reconstruct[DSP_PLUGIN_MAX_CHANNELS];
+
+	unsigned int holdCount() { return 0 < current_sampleCount ? (unsigned int)current_sampleCount : 1; }
+	// looks the tables for the current ratio up, or the nearest whole ratio's
+	void updateTables();
+
+	// held[w] = clamp(input[w] + input[w] * noise, -1, 1), one noise value per window
+	void processHoldValues(const float* input, float* held, unsigned int count);
+	// processes one channel plane in place
+	void processChannel(int channel, float* plane, unsigned int length,
+		unsigned int holdCount, unsigned int phase,
+		const float* gainCurve, const float* mixCurve, unsigned int ramp, float steadyGain, float steadyMix);
+	// processes one channel plane in place through the channel's resamplers
+	void processChannelResampled(int channel, float* plane, unsigned int length,
+		const float* gainCurve, const float* mixCurve, unsigned int ramp, float steadyGain, float steadyMix);
 };
\ No newline at end of file
@@ -0,0 +1,593 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "pch.h"
+#include "dsp_bake.h"
+#include "dsp_memory.h"
+#include "random.h"
+
+#include "dsp_dispatch.h"
+
+// pch.cpp
+FMOD_PLUGINLIST* Plugin_GetList();
+
+// bumped whenever a bake of the same inputs may render differently
+#define DSP_BAKE_KEY_VERSION 1ull
+
+#pragma region Stand-in FMOD_DSP_STATE
+
+namespace
+{
+	struct BakeContext
+	{
+		int samplerate;
+		FMOD_SPEAKERMODE speakermode;
+	};
+
+	inline BakeContext* Bake_Context(FMOD_DSP_STATE* dsp_state)
+	{
+		return (BakeContext*)dsp_state->instance;
+	}
+
+	void* F_CALL Bake_Alloc(unsigned int size, FMOD_MEMORY_TYPE /*type*/, const char* /*sourcestr*/)
+	{
+		return malloc(size);
+	}
+	void* F_CALL Bake_Realloc(void* ptr, unsigned int size, FMOD_MEMORY_TYPE /*type*/, const char* /*sourcestr*/)
+	{
+		return realloc(ptr, size);
+	}
+	void F_CALL Bake_Free(void* ptr, FMOD_MEMORY_TYPE /*type*/, const char* /*sourcestr*/)
+	{
+		free(ptr);
+	}
+	FMOD_RESULT F_CALL Bake_GetSamplerate(FMOD_DSP_STATE* dsp_state, int* rate)
+	{
+		*rate = Bake_Context(dsp_state)->samplerate;
+		return FMOD_OK;
+	}
+	FMOD_RESULT F_CALL Bake_GetBlocksize(FMOD_DSP_STATE* /*dsp_state*/, unsigned int* blocksize)
+	{
+		*blocksize = DSP_BAKE_BLOCK_LENGTH;
+		return FMOD_OK;
+	}
+	FMOD_RESULT F_CALL Bake_GetSpeakermode(FMOD_DSP_STATE* dsp_state, FMOD_SPEAKERMODE* speakermode_mixer, FMOD_SPEAKERMODE* speakermode_output)
+	{
+		if (speakermode_mixer) *speakermode_mixer = Bake_Context(dsp_state)->speakermode;
+		if (speakermode_output) *speakermode_output = Bake_Context(dsp_state)->speakermode;
+		return FMOD_OK;
+	}
+	FMOD_RESULT F_CALL Bake_GetUserData(FMOD_DSP_STATE* /*dsp_state*/, void** userdata)
+	{
+		*userdata = 0;
+		return FMOD_OK;
+	}
+	void F_CALL Bake_Log(FMOD_DEBUG_FLAGS /*level*/, const char* /*file*/, int /*line*/, const char* /*function*/, const char* /*str*/, ...)
+	{
+	}
+
+	FMOD_DSP_STATE_FUNCTIONS Bake_Functions()
+	{
+		FMOD_DSP_STATE_FUNCTIONS functions;
+		memset(&functions, 0, sizeof(functions));
+		functions.alloc = Bake_Alloc;
+		functions.realloc = Bake_Realloc;
+		functions.free = Bake_Free;
+		functions.getsamplerate = Bake_GetSamplerate;
+		functions.getblocksize = Bake_GetBlocksize;
+		functions.getspeakermode = Bake_GetSpeakermode;
+		functions.getuserdata = Bake_GetUserData;
+		functions.log = Bake_Log;
+		return functions;
+	}
+
+	// every bake's state points here, which is how DSPBake_Owns knows one
+	FMOD_DSP_STATE_FUNCTIONS s_functions = Bake_Functions();
+
+	FMOD_SPEAKERMODE Bake_SpeakerMode(int channels)
+	{
+		switch (channels)
+		{
+		case 1:
+			return FMOD_SPEAKERMODE_MONO;
+		case 2:
+			return FMOD_SPEAKERMODE_STEREO;
+		case 4:
+			return FMOD_SPEAKERMODE_QUAD;
+		case 5:
+			return FMOD_SPEAKERMODE_SURROUND;
+		case 6:
+			return FMOD_SPEAKERMODE_5POINT1;
+		case 8:
+			return FMOD_SPEAKERMODE_7POINT1;
+		default:
+			return FMOD_SPEAKERMODE_RAW;
+		}
+	}
+}
+
+bool DSPBake_Owns(FMOD_DSP_STATE* dsp_state)
+{
+	return dsp_state->functions == &s_functions;
+}
+
+#pragma endregion
+
+#pragma region Cache
+
+namespace
+{
+	struct BakeEntry
+	{
+		unsigned long long key;
+		float* samples;
+		unsigned int frames;
+		int channels;
+		size_t bytes;
+		// DSPBake_Acquire calls not yet released
+		int references;
+		// last use, for eviction
+		unsigned long long used;
+	};
+
+	struct BakeCache
+	{
+		std::mutex lock;
+		std::vector<BakeEntry> entries;
+		size_t bytes = 0;
+		size_t capacity = DSP_BAKE_DEFAULT_CAPACITY;
+		unsigned long long clock = 0;
+		DSPMemory memory;
+
+		~BakeCache()
+		{
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				free(entries[i].samples);
+			}
+		}
+	};
+
+	BakeCache s_cache;
+
+	// under the lock
+	BakeEntry* Bake_Find(unsigned long long key)
+	{
+		for (size_t i = 0; i < s_cache.entries.size(); i++)
+		{
+			if (s_cache.entries[i].key == key) {
+				return &s_cache.entries[i];
+			}
+		}
+		return 0;
+	}
+	// Under the lock: drops unacquired entries, least recently used first,
+	// until the cache is within `capacity`.
+	void Bake_Evict(size_t capacity)
+	{
+		while (capacity < s_cache.bytes)
+		{
+			size_t oldest = s_cache.entries.size();
+			for (size_t i = 0; i < s_cache.entries.size(); i++)
+			{
+				const BakeEntry& entry = s_cache.entries[i];
+				if (!entry.references && (oldest == s_cache.entries.size() || entry.used < s_cache.entries[oldest].used)) {
+					oldest = i;
+				}
+			}
+			if (oldest == s_cache.entries.size()) {
+				return;
+			}
+
+			BakeEntry& entry = s_cache.entries[oldest];
+			free(entry.samples);
+			s_cache.bytes -= entry.bytes;
+			s_cache.memory.credit(entry.bytes);
+			entry = s_cache.entries.back();
+			s_cache.entries.pop_back();
+		}
+	}
+
+	bool Bake_Cached(unsigned long long key)
+	{
+		std::lock_guard<std::mutex> lock(s_cache.lock);
+		return Bake_Find(key) != 0;
+	}
+	// Takes ownership of `samples`; a result another thread cached first wins.
+	void Bake_Insert(unsigned long long key, float* samples, unsigned int frames, int channels)
+	{
+		size_t bytes = sizeof(float) * frames * channels;
+
+		std::lock_guard<std::mutex> lock(s_cache.lock);
+		if (Bake_Find(key)) {
+			free(samples);
+			return;
+		}
+		BakeEntry entry;
+		entry.key = key;
+		entry.samples = samples;
+		entry.frames = frames;
+		entry.channels = channels;
+		entry.bytes = bytes;
+		entry.references = 0;
+		entry.used = ++s_cache.clock;
+		s_cache.entries.push_back(entry);
+		s_cache.bytes += bytes;
+
+		s_cache.memory.attach("Point bake cache", 0);
+		s_cache.memory.charge(bytes);
+		Bake_Evict(s_cache.capacity);
+	}
+}
+
+const float* DSPBake_Acquire(unsigned long long key, unsigned int* frames, int* channels)
+{
+	std::lock_guard<std::mutex> lock(s_cache.lock);
+	BakeEntry* entry = Bake_Find(key);
+	if (!entry) {
+		return 0;
+	}
+	entry->references++;
+	entry->used = ++s_cache.clock;
+	if (frames) *frames = entry->frames;
+	if (channels) *channels = entry->channels;
+	return entry->samples;
+}
+
+void DSPBake_Release(unsigned long long key)
+{
+	std::lock_guard<std::mutex> lock(s_cache.lock);
+	BakeEntry* entry = Bake_Find(key);
+	if (entry && 0 < entry->references) {
+		entry->references--;
+	}
+	Bake_Evict(s_cache.capacity);
+}
+
+void DSPBake_Clear()
+{
+	std::lock_guard<std::mutex> lock(s_cache.lock);
+	Bake_Evict(0);
+}
+
+void DSPBake_SetCapacity(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock(s_cache.lock);
+	s_cache.capacity = bytes;
+	Bake_Evict(bytes);
+}
+
+#pragma endregion
+
+#pragma region Render
+
+namespace
+{
+	FMOD_DSP_DESCRIPTION* Bake_FindPlugin(const char* name)
+	{
+		if (!name) {
+			return 0;
+		}
+		FMOD_PLUGINLIST* list = Plugin_GetList();
+		for (int i = 0; list[i].type != FMOD_PLUGINTYPE_MAX; i++)
+		{
+			FMOD_DSP_DESCRIPTION* description = (FMOD_DSP_DESCRIPTION*)list[i].description;
+			if (list[i].type == FMOD_PLUGINTYPE_DSP && strcmp(description->name, name) == 0) {
+				return description;
+			}
+		}
+		return 0;
+	}
+
+	// eight bytes at a time, then the rest; not cryptographic, only well mixed
+	unsigned long long Bake_Hash(unsigned long long hash, const void* data, size_t size)
+	{
+		const unsigned char* bytes = (const unsigned char*)data;
+		for (; 8 <= size; bytes += 8, size -= 8)
+		{
+			unsigned long long word;
+			memcpy(&word, bytes, 8);
+			hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+			hash ^= hash >> 29;
+		}
+		for (; size; bytes++, size--)
+		{
+			hash = (hash ^ *bytes) * 0x100000001B3ull;
+		}
+		return hash;
+	}
+
+	bool Bake_Valid(const DSPBakeRequest& request)
+	{
+		return 0 < request.channels && request.channels <= DSP_BAKE_MAX_CHANNELS
+			&& 0 < request.samplerate
+			&& (request.source || !request.frames)
+			&& (request.parameters || request.parameterCount <= 0);
+	}
+
+	FMOD_RESULT Bake_SetParameter(FMOD_DSP_DESCRIPTION* description, FMOD_DSP_STATE* state, const DSPBakeParameter& parameter)
+	{
+		if (parameter.index < 0 || description->numparameters <= parameter.index) {
+			return FMOD_ERR_INVALID_PARAM;
+		}
+		int rounded = (int)(parameter.value < 0 ? parameter.value - .5f : parameter.value + .5f);
+		switch (description->paramdesc[parameter.index]->type)
+		{
+		case FMOD_DSP_PARAMETER_TYPE_FLOAT:
+			return description->setparameterfloat ? description->setparameterfloat(state, parameter.index, parameter.value) : FMOD_ERR_INVALID_PARAM;
+		case FMOD_DSP_PARAMETER_TYPE_INT:
+			return description->setparameterint ? description->setparameterint(state, parameter.index, rounded) : FMOD_ERR_INVALID_PARAM;
+		case FMOD_DSP_PARAMETER_TYPE_BOOL:
+			return description->setparameterbool ? description->setparameterbool(state, parameter.index, rounded != 0) : FMOD_ERR_INVALID_PARAM;
+		default:
+			return FMOD_ERR_INVALID_PARAM;
+		}
+	}
+
+	// Runs the source and then silence through a fresh instance, block by block
+	// as the mixer would, until the source is done and the plugin reports its
+	// tail silent or DSP_BAKE_MAX_TAIL_SECONDS have passed.
+	FMOD_RESULT Bake_Process(FMOD_DSP_DESCRIPTION* description, FMOD_DSP_STATE* state, const DSPBakeRequest& request,
+		std::vector<float>* output, int* outchannels)
+	{
+		const int channels = request.channels;
+		std::vector<float> input(DSP_BAKE_BLOCK_LENGTH * channels, 0.0f);
+		std::vector<float> block(DSP_BAKE_BLOCK_LENGTH * DSP_BAKE_MAX_CHANNELS);
+		output->reserve((size_t)request.frames * channels);
+
+		const unsigned int tailLimit = DSP_BAKE_MAX_TAIL_SECONDS * (unsigned int)request.samplerate;
+		unsigned int position = 0;
+		unsigned int tail = 0;
+		*outchannels = 0;
+		for (;;)
+		{
+			bool idle = request.frames <= position;
+			if (idle && tailLimit <= tail) {
+				break;
+			}
+			unsigned int length = idle || DSP_BAKE_BLOCK_LENGTH < request.frames - position
+				? DSP_BAKE_BLOCK_LENGTH : request.frames - position;
+			if (idle) {
+				memset(&input[0], 0, sizeof(float) * length * channels);
+			}
+			else {
+				memcpy(&input[0], request.source + (size_t)position * channels, sizeof(float) * length * channels);
+			}
+
+			int in_numchannels = channels;
+			int out_numchannels = channels;
+			FMOD_CHANNELMASK in_mask = 0, out_mask = 0;
+			float* in_buffers[1] = { &input[0] };
+			float* out_buffers[1] = { &block[0] };
+
+			FMOD_DSP_BUFFER_ARRAY in_array;
+			in_array.numbuffers = 1;
+			in_array.buffernumchannels = &in_numchannels;
+			in_array.bufferchannelmask = &in_mask;
+			in_array.buffers = in_buffers;
+			in_array.speakermode = Bake_SpeakerMode(channels);
+			FMOD_DSP_BUFFER_ARRAY out_array = in_array;
+			out_array.buffernumchannels = &out_numchannels;
+			out_array.bufferchannelmask = &out_mask;
+			out_array.buffers = out_buffers;
+
+			FMOD_RESULT result = description->process(state, length, &in_array, &out_array, idle, FMOD_DSP_PROCESS_QUERY);
+			if (out_numchannels <= 0 || DSP_BAKE_MAX_CHANNELS < out_numchannels
+				|| (*outchannels && *outchannels != out_numchannels)) {
+				return FMOD_ERR_FORMAT;
+			}
+			*outchannels = out_numchannels;
+
+			if (result == FMOD_ERR_DSP_SILENCE || result == FMOD_ERR_DSP_DONTPROCESS) {
+				if (idle) {
+					// the tail has run out
+					break;
+				}
+				memset(&block[0], 0, sizeof(float) * length * out_numchannels);
+			}
+			else if (result != FMOD_OK) {
+				return result;
+			}
+			else {
+				result = description->process(state, length, &in_array, &out_array, idle, FMOD_DSP_PROCESS_PERFORM);
+				if (result != FMOD_OK) {
+					return result;
+				}
+			}
+
+			output->insert(output->end(), block.begin(), block.begin() + length * out_numchannels);
+			position += length;
+			if (idle) {
+				tail += length;
+			}
+		}
+		return FMOD_OK;
+	}
+
+	FMOD_RESULT Bake_RenderOne(const DSPBakeRequest& request, unsigned long long key)
+	{
+		FMOD_DSP_DESCRIPTION* description = Bake_FindPlugin(request.plugin);
+		if (!description || !description->create || !description->process) {
+			return FMOD_ERR_PLUGIN_MISSING;
+		}
+		if (!Bake_Valid(request)) {
+			return FMOD_ERR_INVALID_PARAM;
+		}
+
+		BakeContext context;
+		context.samplerate = request.samplerate;
+		context.speakermode = Bake_SpeakerMode(request.channels);
+
+		FMOD_DSP_STATE state;
+		memset(&state, 0, sizeof(state));
+		state.instance = &context;
+		state.source_speakermode = context.speakermode;
+		state.functions = &s_functions;
+
+		// the instance's noise depends on the key alone
+		RandomSeedScope seeds(key);
+
+		FMOD_RESULT result = description->create(&state);
+		for (int i = 0; result == FMOD_OK && i < request.parameterCount; i++)
+		{
+			result = Bake_SetParameter(description, &state, request.parameters[i]);
+		}
+		if (result == FMOD_OK && description->reset) {
+			result = description->reset(&state);
+		}
+
+		std::vector<float> output;
+		int outchannels = 0;
+		if (result == FMOD_OK) {
+			result = Bake_Process(description, &state, request, &output, &outchannels);
+		}
+		if (state.plugindata && description->release) {
+			description->release(&state);
+		}
+		if (result != FMOD_OK) {
+			return result;
+		}
+
+		unsigned int frames = outchannels ? (unsigned int)(output.size() / outchannels) : 0;
+		float* samples = (float*)malloc(sizeof(float) * (output.size() ? output.size() : 1));
+		if (!samples) {
+			return FMOD_ERR_MEMORY;
+		}
+		if (output.size()) {
+			memcpy(samples, &output[0], sizeof(float) * output.size());
+		}
+		Bake_Insert(key, samples, frames, outchannels);
+		return FMOD_OK;
+	}
+}
+
+unsigned long long DSPBake_Key(const DSPBakeRequest* request)
+{
+	unsigned long long hash = 0xCBF29CE484222325ull;
+	unsigned long long version = DSP_BAKE_KEY_VERSION;
+	hash = Bake_Hash(hash, &version, sizeof(version));
+
+	FMOD_DSP_DESCRIPTION* description = Bake_FindPlugin(request->plugin);
+	if (request->plugin) {
+		hash = Bake_Hash(hash, request->plugin, strlen(request->plugin));
+	}
+	unsigned int pluginversion = description ? description->version : 0;
+	hash = Bake_Hash(hash, &pluginversion, sizeof(pluginversion));
+
+	int layout[3] = { request->channels, request->samplerate, (int)request->frames };
+	hash = Bake_Hash(hash, layout, sizeof(layout));
+	for (int i = 0; request->parameters && i < request->parameterCount; i++)
+	{
+		hash = Bake_Hash(hash, &request->parameters[i].index, sizeof(int));
+		hash = Bake_Hash(hash, &request->parameters[i].value, sizeof(float));
+	}
+	if (request->source && 0 < request->channels) {
+		hash = Bake_Hash(hash, request->source, sizeof(float) * request->frames * request->channels);
+	}
+
+	// final avalanche, so that close inputs land far apart
+	return Random_SplitMix64(&hash);
+}
+
+int DSPBake_Render(const DSPBakeRequest* requests, int count, unsigned long long* keys, FMOD_RESULT* results)
+{
+	if (!requests || count <= 0) {
+		return 0;
+	}
+	// settle the kernels before the first bake instance exists
+	DSPKernels_Select();
+
+	std::atomic<int> next(0);
+	std::atomic<int> failed(0);
+	auto work = [&]() {
+		for (int i = next++; i < count; i = next++)
+		{
+			unsigned long long key = DSPBake_Key(&requests[i]);
+			FMOD_RESULT result = Bake_Cached(key) ? FMOD_OK : Bake_RenderOne(requests[i], key);
+			if (keys) keys[i] = key;
+			if (results) results[i] = result;
+			if (result != FMOD_OK) {
+				failed++;
+			}
+		}
+	};
+
+	int threads = (int)std::thread::hardware_concurrency();
+	if (threads > DSP_BAKE_MAX_THREADS) threads = DSP_BAKE_MAX_THREADS;
+	if (threads > count) threads = count;
+	if (threads < 1) threads = 1;
+
+	// the calling thread renders too
+	std::vector<std::thread> helpers;
+	for (int i = 1; i < threads; i++)
+	{
+		helpers.push_back(std::thread(work));
+	}
+	work();
+	for (size_t i = 0; i < helpers.size(); i++)
+	{
+		helpers[i].join();
+	}
+	return failed.load();
+}
+
+#pragma endregion
+
+#pragma region Exports
+
+// Renders `count` requests and fills keys[i] (and results[i], if given) for
+// each; returns the number that failed. Blocks until every request is done.
+DLLEXPORT int PointDSP_Bake(const DSPBakeRequest* requests, int count, unsigned long long* keys, int* results)
+{
+	std::vector<FMOD_RESULT> codes(results && 0 < count ? count : 0);
+	int failed = DSPBake_Render(requests, count, keys, codes.empty() ? 0 : &codes[0]);
+	for (size_t i = 0; i < codes.size(); i++)
+	{
+		results[i] = (int)codes[i];
+	}
+	return failed;
+}
+DLLEXPORT unsigned long long PointDSP_BakeKey(const DSPBakeRequest* request)
+{
+	return request ? DSPBake_Key(request) : 0;
+}
+// The cached PCM of `key` or null; valid until PointDSP_ReleaseBake(key).
+DLLEXPORT const float* PointDSP_AcquireBake(unsigned long long key, unsigned int* frames, int* channels)
+{
+	return DSPBake_Acquire(key, frames, channels);
+}
+DLLEXPORT void PointDSP_ReleaseBake(unsigned long long key)
+{
+	DSPBake_Release(key);
+}
+DLLEXPORT void PointDSP_ClearBakes()
+{
+	DSPBake_Clear();
+}
+DLLEXPORT void PointDSP_SetBakeCapacity(unsigned long long bytes)
+{
+	DSPBake_SetCapacity((size_t)bytes);
+}
+
+#pragma endregion
@@ -0,0 +1,95 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// dsp_bake.h: offline rendering of Point DSP effects whose parameters never
+// change, so that a sound can play the processed PCM instead of running a live
+// instance. A bake drives the plugin's own FMOD_DSP_DESCRIPTION from Plugin_List
+// (create, setparam, reset, query and process) on a stand-in FMOD_DSP_STATE, as
+// fast as the CPU allows; requests given together render on as many threads.
+//
+// Instances of a bake always process directly, never batched or offloaded, so
+// the result carries no latency the live mixer would not add. Their noise is
+// seeded from the bake's key (RandomSeedScope), so a bake renders the same PCM
+// every time, whatever else the process created before it.
+//
+// Results go into a process-wide cache keyed by a 64-bit hash of the plugin and
+// its version, the parameter values in the order given, the source layout and
+// the source samples.
+// A result stays while it is acquired; unacquired ones are evicted oldest first
+// once the cache grows past its capacity. Its memory is charged to the
+// "Point bake cache" DSPMemory account.
+
+#pragma once
+
+#ifndef __DSP_BAKE_H__
+#define __DSP_BAKE_H__
+
+#include "fmod.hpp"
+#include "fmod_dsp.h"
+
+// frames per process call of a bake
+#define DSP_BAKE_BLOCK_LENGTH 1024
+// longest tail rendered after the source, in seconds
+#define DSP_BAKE_MAX_TAIL_SECONDS 10
+// threads a batch of requests renders on, at most
+#define DSP_BAKE_MAX_THREADS 8
+// channels a bake's source or result may have
+#define DSP_BAKE_MAX_CHANNELS 8
+// default DSPBake_SetCapacity
+#define DSP_BAKE_DEFAULT_CAPACITY (64u << 20)
+
+// One parameter of a bake: the plugin's parameter index and its value. Int and
+// bool parameters take the value rounded.
+struct DSPBakeParameter
+{
+	int index;
+	float value;
+};
+
+// What to render; plain C layout so that it can be marshalled as is.
+struct DSPBakeRequest
+{
+	// FMOD_DSP_DESCRIPTION::name of a plugin in Plugin_List
+	const char* plugin;
+	const DSPBakeParameter* parameters;
+	int parameterCount;
+	// interleaved source, frames * channels samples
+	const float* source;
+	unsigned int frames;
+	int channels;
+	int samplerate;
+};
+
+// Renders every request not cached yet, on up to DSP_BAKE_MAX_THREADS threads,
+// and returns the number that failed. keys[i] receives request i's key and
+// results[i], if results is given, FMOD_OK or why it failed.
+int DSPBake_Render(const DSPBakeRequest* requests, int count, unsigned long long* keys, FMOD_RESULT* results);
+// The key a request is cached under.
+unsigned long long DSPBake_Key(const DSPBakeRequest* request);
+
+// The cached PCM of `key`, interleaved, or null. It stays valid until the
+// matching DSPBake_Release.
+const float* DSPBake_Acquire(unsigned long long key, unsigned int* frames, int* channels);
+void DSPBake_Release(unsigned long long key);
+// Evicts every result that is not acquired.
+void DSPBake_Clear();
+// Bytes the cache keeps before it evicts; acquired results may exceed it.
+void DSPBake_SetCapacity(size_t bytes);
+
+// `dsp_state` belongs to a bake, whose instances process directly.
+bool DSPBake_Owns(FMOD_DSP_STATE* dsp_state);
+
+#endif
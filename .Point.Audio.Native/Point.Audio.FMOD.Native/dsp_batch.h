@@ -0,0 +1,306 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// dsp_batch.h: per-type instance table behind POINT_DSP_BATCH builds.
+// A plugin flagged DSP_PLUGIN_BATCHED does not process inside its own PERFORM
+// pass there. It copies the input into its staging buffer, hands back the block
+// computed at the previous mixer tick, and marks its slot. At sys_mix stage 1
+// DSPBatch<T>::run() then processes every staged instance of the type in one
+// pass, walking the table's parallel arrays instead of FMOD's DSP graph.
+// The cost is one block of latency, which DSPPlugin folds into tailLength().
+//
+// A type with a steady-state path that vectorizes across instances runs it as
+// structure of arrays: each channel of each joining instance becomes a lane,
+// and the pass walks the block in tiles of DSP_BATCH_TILE frames laid out
+// lane-major (T::BatchLanes, see DSPBatchLanes), so one vector holds the same
+// frame of POINT_SIMD_WIDTH lanes. Per tile the staged inputs are gathered in,
+// T::batchTile computes every lane at once, and the outputs are scattered back
+// to the staging buffers. An instance joins through T::batchBegin, which may
+// decline, e.g. while a parameter ramps; declined blocks and types without the
+// hooks (DSPPlugin's defaults) go through performStage one by one.
+
+#pragma once
+
+#ifndef __DSP_BATCH_H__
+#define __DSP_BATCH_H__
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "fmod.hpp"
+#include "fmod_dsp.h"
+
+// live instances per plugin type that can be batched; later ones process directly
+#define DSP_BATCH_CAPACITY 1024
+// lanes of one structure-of-arrays pass; a multiple of every SIMD width
+#define DSP_BATCH_LANES 128
+// a pass rounds its lanes up to this, the widest vector
+#define DSP_BATCH_LANE_GROUP 16
+// frames per tile; a few tiles of DSP_BATCH_LANES lanes stay in L2
+#define DSP_BATCH_TILE 32
+#define DSP_BATCH_ALIGNMENT 64
+
+// Lane-major tiles of a pass: sample f of lane l at [f * DSP_BATCH_LANES + l].
+// A type's T::BatchLanes derives from this and adds the tiles and per-lane
+// state its kernel needs.
+struct DSPBatchLanes
+{
+	// the staged inputs, gathered by the pass
+	alignas(DSP_BATCH_ALIGNMENT) float input[DSP_BATCH_TILE * DSP_BATCH_LANES];
+	// written by T::batchTile, scattered to the staging outputs
+	alignas(DSP_BATCH_ALIGNMENT) float output[DSP_BATCH_TILE * DSP_BATCH_LANES];
+	// steady weights of the wet and dry signal per lane, see Kernel_MixLanes
+	alignas(DSP_BATCH_ALIGNMENT) float wetGain[DSP_BATCH_LANES];
+	alignas(DSP_BATCH_ALIGNMENT) float dryGain[DSP_BATCH_LANES];
+};
+
+// Short critical sections between the mixer thread and create/release. Never
+// held while an instance processes.
+class DSPBatchLock
+{
+public:
+	void lock()
+	{
+		while (m_flag.test_and_set(std::memory_order_acquire))
+		{
+		}
+	}
+	void unlock() { m_flag.clear(std::memory_order_release); }
+
+private:
+	std::atomic_flag m_flag = ATOMIC_FLAG_INIT;
+};
+
+template<typename T>
+class DSPBatch
+{
+public:
+	// Gives `instance` a slot; false when the table is full. The slot is kept
+	// in the instance and only read or moved under the lock.
+	static bool add(T* instance)
+	{
+		Table& table = s_table;
+		table.lock.lock();
+		bool added = table.count < DSP_BATCH_CAPACITY;
+		if (added) {
+			int slot = table.count++;
+			table.instance[slot] = instance;
+			table.staged[slot] = 0;
+			instance->setBatchSlot(slot);
+		}
+		table.lock.unlock();
+		return added;
+	}
+	// Moves the last entry into the slot of `instance`; returns it so its owner can follow.
+	// Waits out a run() that may still be processing the removed instance, so
+	// the caller can free it on return.
+	static T* remove(T* instance)
+	{
+		Table& table = s_table;
+		table.lock.lock();
+		int slot = instance->batchSlot();
+		instance->setBatchSlot(-1);
+		int last = --table.count;
+		T* moved = 0;
+		if (slot != last) {
+			moved = table.instance[last];
+			table.instance[slot] = moved;
+			table.length[slot] = table.length[last];
+			table.channels[slot] = table.channels[last];
+			table.speakermode[slot] = table.speakermode[last];
+			table.staged[slot] = table.staged[last];
+			moved->setBatchSlot(slot);
+		}
+		unsigned int epoch = table.epoch.load(std::memory_order_acquire);
+		table.lock.unlock();
+
+		// odd while a run is processing its snapshot
+		while ((epoch & 1) && table.epoch.load(std::memory_order_acquire) == epoch)
+		{
+			std::this_thread::yield();
+		}
+		return moved;
+	}
+
+	// The instance's input for this tick is in its staging buffer.
+	static void stage(T* instance, unsigned int length, int channels, FMOD_SPEAKERMODE speakermode)
+	{
+		Table& table = s_table;
+		table.lock.lock();
+		// looked up here, as a remove() may have moved the instance since its owner checked
+		int slot = instance->batchSlot();
+		table.length[slot] = length;
+		table.channels[slot] = channels;
+		table.speakermode[slot] = speakermode;
+		table.staged[slot] = 1;
+		table.lock.unlock();
+	}
+
+	// Processes every staged instance into its staging output. The staged
+	// entries are copied out under the lock and processed after it is released;
+	// the odd epoch keeps remove() from returning meanwhile. Consecutive entries
+	// of one block length share a pass while their lanes fit. Mixer thread only.
+	static void run()
+	{
+		Table& table = s_table;
+		table.lock.lock();
+		int count = 0;
+		for (int slot = 0; slot < table.count; slot++)
+		{
+			if (!table.staged[slot]) {
+				continue;
+			}
+			table.staged[slot] = 0;
+
+			Entry& entry = table.snapshot[count++];
+			entry.instance = table.instance[slot];
+			entry.length = table.length[slot];
+			entry.channels = table.channels[slot];
+			entry.speakermode = table.speakermode[slot];
+		}
+		if (count) {
+			table.epoch.fetch_add(1, std::memory_order_relaxed);
+		}
+		table.lock.unlock();
+
+		if (!count) {
+			return;
+		}
+		int members = 0;
+		int lanes = 0;
+		for (int index = 0; index < count; index++)
+		{
+			const Entry& entry = table.snapshot[index];
+			if (members && (entry.length != table.member[0].length || DSP_BATCH_LANES < lanes + entry.channels)) {
+				runPass(table, members, lanes);
+				members = 0;
+				lanes = 0;
+			}
+
+			T* instance = entry.instance;
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			if (entry.channels <= 0 || DSP_BATCH_LANES < entry.channels
+				|| !instance->batchBegin(table.lanes, lanes, entry.length, entry.channels, entry.speakermode)) {
+				instance->performStage(entry.length, entry.channels, entry.speakermode);
+				continue;
+			}
+			instance->m_stage_ns = T::elapsedNs(start);
+			table.member[members] = entry;
+			table.base[members++] = lanes;
+			lanes += entry.channels;
+		}
+		if (members) {
+			runPass(table, members, lanes);
+		}
+		table.epoch.fetch_add(1, std::memory_order_release);
+	}
+
+private:
+	struct Entry
+	{
+		T* instance;
+		unsigned int length;
+		int channels;
+		FMOD_SPEAKERMODE speakermode;
+	};
+	struct Table;
+
+	// Runs the block of every member through the tiles, then hands each its
+	// lane state back and its output to the next PERFORM pass. The pass's time
+	// is split between the members by channels.
+	static void runPass(Table& table, int members, int lanes)
+	{
+		typename T::BatchLanes& tiles = table.lanes;
+		unsigned int length = table.member[0].length;
+		unsigned int width = (lanes + DSP_BATCH_LANE_GROUP - 1) & ~(DSP_BATCH_LANE_GROUP - 1);
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for (unsigned int frame = 0; frame < length; frame += DSP_BATCH_TILE)
+		{
+			unsigned int count = length - frame < DSP_BATCH_TILE ? length - frame : DSP_BATCH_TILE;
+			for (int m = 0; m < members; m++)
+			{
+				const Entry& entry = table.member[m];
+				int channels = entry.channels;
+				const float* input = entry.instance->m_stage + frame * channels;
+				float* lane = tiles.input + table.base[m];
+				for (unsigned int f = 0; f < count; f++, input += channels, lane += DSP_BATCH_LANES)
+				{
+					for (int c = 0; c < channels; c++)
+					{
+						lane[c] = input[c];
+					}
+				}
+				entry.instance->batchGather(tiles, table.base[m], frame, count, channels);
+			}
+
+			T::batchTile(tiles, count, width);
+
+			for (int m = 0; m < members; m++)
+			{
+				const Entry& entry = table.member[m];
+				int channels = entry.channels;
+				float* output = entry.instance->m_stage + entry.instance->m_stage_capacity + frame * channels;
+				const float* lane = tiles.output + table.base[m];
+				for (unsigned int f = 0; f < count; f++, output += channels, lane += DSP_BATCH_LANES)
+				{
+					for (int c = 0; c < channels; c++)
+					{
+						output[c] = lane[c];
+					}
+				}
+			}
+		}
+		unsigned long long ns = T::elapsedNs(start);
+
+		for (int m = 0; m < members; m++)
+		{
+			const Entry& entry = table.member[m];
+			T* instance = entry.instance;
+			instance->batchEnd(tiles, table.base[m], length, entry.channels);
+			instance->m_stage_ns += (unsigned int)(ns * entry.channels / lanes);
+			instance->m_stage_ready = length * entry.channels;
+		}
+	}
+	struct Table
+	{
+		DSPBatchLock lock;
+		int count;
+		// bumped when run() starts and ends processing a snapshot
+		std::atomic<unsigned int> epoch;
+
+		T* instance[DSP_BATCH_CAPACITY];
+		unsigned int length[DSP_BATCH_CAPACITY];
+		int channels[DSP_BATCH_CAPACITY];
+		FMOD_SPEAKERMODE speakermode[DSP_BATCH_CAPACITY];
+		unsigned char staged[DSP_BATCH_CAPACITY];
+
+		// the staged entries of the run in progress
+		Entry snapshot[DSP_BATCH_CAPACITY];
+
+		// the pass being gathered: its members, where their lanes start, and the tiles
+		Entry member[DSP_BATCH_LANES];
+		int base[DSP_BATCH_LANES];
+		typename T::BatchLanes lanes;
+	};
+	static Table s_table;
+};
+
+template<typename T>
+typename DSPBatch<T>::Table DSPBatch<T>::s_table;
+
+#endif // !__DSP_BATCH_H__
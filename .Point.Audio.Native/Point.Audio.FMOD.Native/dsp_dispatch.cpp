@@ -0,0 +1,209 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pch.h"
+#include "dsp_dispatch.h"
+
+#if defined(DSP_DISPATCH_X86) && defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(DSP_DISPATCH_X86)
+#include <cpuid.h>
+#endif
+
+#if defined(DSP_DISPATCH_X86) && (defined(_M_X64) || defined(__x86_64__))
+const DSPKernelTable* DSPKernels_Active = &DSPKernels_SSE2;
+#elif defined(DSP_DISPATCH_NEON)
+const DSPKernelTable* DSPKernels_Active = &DSPKernels_NEON;
+#else
+const DSPKernelTable* DSPKernels_Active = &DSPKernels_Scalar;
+#endif
+
+#pragma region Detection
+
+namespace
+{
+	// every table built for this architecture, by DSPKernelISA
+	const DSPKernelTable* const s_tables[DSP_ISA_COUNT] = {
+		&DSPKernels_Scalar,
+#if defined(DSP_DISPATCH_X86)
+		&DSPKernels_SSE2,
+		&DSPKernels_AVX2,
+		&DSPKernels_AVX512,
+#else
+		0, 0, 0,
+#endif
+#if defined(DSP_DISPATCH_NEON)
+		&DSPKernels_NEON,
+#else
+		0,
+#endif
+	};
+
+#if defined(DSP_DISPATCH_X86)
+
+	// eax, ebx, ecx, edx of cpuid leaf/subleaf
+	void DSPDispatch_CPUID(unsigned int leaf, unsigned int subleaf, unsigned int regs[4])
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuidex(info, (int)leaf, (int)subleaf);
+		for (int i = 0; i < 4; i++) regs[i] = (unsigned int)info[i];
+#else
+		if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3])) {
+			regs[0] = regs[1] = regs[2] = regs[3] = 0;
+		}
+#endif
+	}
+
+	// register state the OS saves on a context switch (XCR0)
+	unsigned long long DSPDispatch_XCR0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int lo, hi;
+		__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+		return ((unsigned long long)hi << 32) | lo;
+#endif
+	}
+
+	bool DSPDispatch_Detect(DSPKernelISA isa)
+	{
+		unsigned int leaf1[4], leaf7[4];
+		DSPDispatch_CPUID(0, 0, leaf1);
+		unsigned int maxleaf = leaf1[0];
+		DSPDispatch_CPUID(1, 0, leaf1);
+
+		if (isa == DSP_ISA_SSE2) {
+			return (leaf1[3] & (1u << 26)) != 0;
+		}
+
+		// AVX state needs OSXSAVE and an OS that saves the XMM and YMM registers
+		bool osxsave = (leaf1[2] & (1u << 27)) != 0;
+		bool avx = (leaf1[2] & (1u << 28)) != 0;
+		if (!osxsave || !avx || maxleaf < 7) {
+			return false;
+		}
+		unsigned long long xcr0 = DSPDispatch_XCR0();
+		DSPDispatch_CPUID(7, 0, leaf7);
+
+		if (isa == DSP_ISA_AVX2) {
+			// /arch:AVX2 lets MSVC contract into FMA, so kernels_avx2.cpp needs it too
+			bool fma = (leaf1[2] & (1u << 12)) != 0;
+			return (xcr0 & 0x6) == 0x6 && fma && (leaf7[1] & (1u << 5)) != 0;
+		}
+		if (isa == DSP_ISA_AVX512) {
+			// opmask and both halves of the ZMM registers as well
+			return (xcr0 & 0xE6) == 0xE6 && (leaf7[1] & (1u << 16)) != 0;
+		}
+		return false;
+	}
+
+#endif // DSP_DISPATCH_X86
+
+	DSPKernelISA DSPDispatch_Parse(const char* name)
+	{
+		for (int i = 0; i < DSP_ISA_COUNT; i++)
+		{
+			static const char* const names[DSP_ISA_COUNT] = { "scalar", "sse2", "avx2", "avx512", "neon" };
+			const char* a = name;
+			const char* b = names[i];
+			while (*a && (*a | 0x20) == *b) { a++; b++; }
+			if (!*a && !*b) {
+				return (DSPKernelISA)i;
+			}
+		}
+		return DSP_ISA_COUNT;
+	}
+}
+
+bool DSPKernels_IsSupported(DSPKernelISA isa)
+{
+	if ((unsigned int)isa >= DSP_ISA_COUNT || !s_tables[isa]) {
+		return false;
+	}
+	switch (isa)
+	{
+	case DSP_ISA_SCALAR:
+		return true;
+#if defined(DSP_DISPATCH_X86)
+	case DSP_ISA_SSE2:
+	case DSP_ISA_AVX2:
+	case DSP_ISA_AVX512:
+		return DSPDispatch_Detect(isa);
+#endif
+#if defined(DSP_DISPATCH_NEON)
+	case DSP_ISA_NEON:
+		// part of every ARM64 CPU; other ARM builds only get here when compiled for it
+		return true;
+#endif
+	default:
+		return false;
+	}
+}
+
+#pragma endregion
+
+namespace
+{
+	const DSPKernelTable& DSPDispatch_Choose()
+	{
+		DSPKernelISA isa = DSP_ISA_COUNT;
+
+		const char* forced = getenv("POINT_DSP_ISA");
+		if (forced && *forced) {
+			isa = DSPDispatch_Parse(forced);
+			if (isa != DSP_ISA_COUNT && !DSPKernels_IsSupported(isa)) {
+				isa = DSP_ISA_COUNT;
+			}
+		}
+		if (isa == DSP_ISA_COUNT) {
+			// the enum runs from narrow to wide within an architecture
+			isa = DSP_ISA_SCALAR;
+			for (int i = DSP_ISA_COUNT - 1; i > DSP_ISA_SCALAR; i--)
+			{
+				if (DSPKernels_IsSupported((DSPKernelISA)i)) {
+					isa = (DSPKernelISA)i;
+					break;
+				}
+			}
+		}
+
+		DSPKernels_Active = s_tables[isa];
+		return *DSPKernels_Active;
+	}
+}
+
+const DSPKernelTable& DSPKernels_Select()
+{
+	// only the first call writes DSPKernels_Active; the others wait for it
+	static const DSPKernelTable& selected = DSPDispatch_Choose();
+	return selected;
+}
+
+#pragma region Exports
+
+// POINT_DSP_ISA spelling of the kernels the plugins run on
+DLLEXPORT const char* PointDSP_GetKernelISA()
+{
+	return DSPKernels().name;
+}
+
+#pragma endregion
@@ -0,0 +1,105 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// dsp_dispatch.h: the kernels of kernels.h, built once per instruction set.
+// kernels_scalar.cpp, kernels_sse2.cpp, kernels_avx2.cpp, kernels_avx512.cpp
+// and kernels_neon.cpp each compile kernels.h for their own target and publish
+// it as a DSPKernelTable. FMODGetPluginDescriptionList() calls
+// DSPKernels_Select(), which keeps the widest table the CPU and the OS
+// support, and from then on every plugin calls through DSPKernels().
+//
+// POINT_DSP_ISA=scalar|sse2|avx2|avx512|neon in the environment overrides the
+// choice, e.g. to benchmark one variant on its own; a variant that is not
+// built for this architecture or not supported by the CPU is ignored.
+//
+// The variant files include nothing but this header and kernels.h, so the
+// only code they compile for their target is kernels.h's static functions.
+// Variants agree to rounding; the sums of Kernel_Dot run in a different order
+// for each vector width, so bit-exact comparisons need the same variant.
+
+#pragma once
+
+#ifndef __DSP_DISPATCH_H__
+#define __DSP_DISPATCH_H__
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DSP_DISPATCH_X86
+#elif defined(_M_ARM64) || defined(__aarch64__) || defined(__ARM_NEON)
+#define DSP_DISPATCH_NEON
+#endif
+
+enum DSPKernelISA
+{
+	DSP_ISA_SCALAR,
+	DSP_ISA_SSE2,
+	DSP_ISA_AVX2,
+	DSP_ISA_AVX512,
+	DSP_ISA_NEON,
+
+	DSP_ISA_COUNT
+};
+
+// See kernels.h for what each one computes.
+struct DSPKernelTable
+{
+	DSPKernelISA isa;
+	// as POINT_DSP_ISA spells it
+	const char* name;
+
+	void (*mixSteady)(const float* wet, const float* dry, float* out, unsigned int count, float mix, float gain);
+	void (*mixCurve)(const float* wet, const float* dry, float* out, unsigned int count, const float* mix, const float* gain);
+	void (*gain)(const float* in, float* out, unsigned int count, float gain);
+	void (*gainCurve)(const float* in, float* out, unsigned int frames, int channels, const float* gain);
+	bool (*isSilent)(const float* in, unsigned int count, float threshold);
+	void (*deinterleave)(const float* in, float* const* planes, unsigned int frames, int channels);
+	void (*interleave)(const float* const* planes, float* out, unsigned int frames, int channels);
+	unsigned int (*polyphase)(const float* history, unsigned int fill, const float* rows, unsigned int taps,
+		unsigned int step, unsigned int rest, unsigned int den, unsigned int* index, unsigned int* phase, float* output, unsigned int count);
+	void (*mixLanes)(const float* wet, const float* dry, float* out, unsigned int frames,
+		unsigned int lanes, unsigned int stride, const float* wetGain, const float* dryGain);
+	void (*holdLanes)(const float* in, const float* noise, const unsigned int* gate, float* out, unsigned int frames,
+		unsigned int lanes, unsigned int stride, float* held, const float* amplitude, const float* wetGain, const float* dryGain);
+};
+
+// Defined by the variant files built for this architecture only.
+extern const DSPKernelTable DSPKernels_Scalar;
+extern const DSPKernelTable DSPKernels_SSE2;
+extern const DSPKernelTable DSPKernels_AVX2;
+extern const DSPKernelTable DSPKernels_AVX512;
+extern const DSPKernelTable DSPKernels_NEON;
+
+// The table in use. Until DSPKernels_Select() runs it is the variant every CPU
+// of the architecture has: SSE2 on x64, NEON on ARM64, scalar otherwise.
+extern const DSPKernelTable* DSPKernels_Active;
+
+static inline const DSPKernelTable& DSPKernels() { return *DSPKernels_Active; }
+
+// Picks the table for this CPU, or the one POINT_DSP_ISA names, and returns
+// it. Only the first call picks, before any plugin instance exists: FMOD's
+// load of the plugin list or the first bake. Later calls return the same
+// table, so it never changes while an instance processes.
+const DSPKernelTable& DSPKernels_Select();
+// Whether `isa` is built into the library and the CPU and OS can run it.
+bool DSPKernels_IsSupported(DSPKernelISA isa);
+
+// Defines the table `symbol` over the kernels.h just included.
+#define DSP_KERNEL_TABLE(symbol, isa, name) \
+	const DSPKernelTable symbol = { isa, name, \
+		Kernel_MixSteady, Kernel_MixCurve, Kernel_Gain, Kernel_GainCurve, \
+		Kernel_IsSilent, Kernel_Deinterleave, Kernel_Interleave, Kernel_Polyphase, \
+		Kernel_MixLanes, Kernel_HoldLanes }
+
+#endif // !__DSP_DISPATCH_H__
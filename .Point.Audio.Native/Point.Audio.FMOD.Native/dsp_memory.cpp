@@ -0,0 +1,152 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <mutex>
+
+#include "pch.h"
+#include "dsp_memory.h"
+
+static std::mutex s_memory_lock;
+static DSPMemory* s_memory_head = 0;
+
+#pragma region DSPMemory
+
+DSPMemory::DSPMemory()
+	: m_live(0), m_peak(0), m_allocations(0), m_frees(0), m_instances(0),
+	m_name(""), m_id(0), m_attached(false), m_prev(0), m_next(0)
+{
+}
+
+void DSPMemory::charge(size_t bytes)
+{
+	unsigned long long live = m_live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	unsigned long long peak = m_peak.load(std::memory_order_relaxed);
+	while (peak < live && !m_peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+	{
+	}
+	m_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DSPMemory::credit(size_t bytes)
+{
+	m_live.fetch_sub(bytes, std::memory_order_relaxed);
+	m_frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void DSPMemory::snapshot(DSPMemorySnapshot* snapshot) const
+{
+	strncpy(snapshot->name, m_name, DSP_MEMORY_NAME_LENGTH - 1);
+	snapshot->name[DSP_MEMORY_NAME_LENGTH - 1] = 0;
+	snapshot->id = m_id;
+	snapshot->instances = m_id ? 1 : m_instances.load(std::memory_order_relaxed);
+	snapshot->padding = 0;
+	snapshot->live = m_live.load(std::memory_order_relaxed);
+	snapshot->peak = m_peak.load(std::memory_order_relaxed);
+	// a charge in flight may have moved live past the peak it has not set yet
+	if (snapshot->peak < snapshot->live) {
+		snapshot->peak = snapshot->live;
+	}
+	snapshot->allocations = m_allocations.load(std::memory_order_relaxed);
+	snapshot->frees = m_frees.load(std::memory_order_relaxed);
+}
+
+void DSPMemory::resetPeak()
+{
+	m_peak.store(m_live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void DSPMemory::attach(const char* name, unsigned long long id)
+{
+	std::lock_guard<std::mutex> lock(s_memory_lock);
+	if (m_attached) {
+		return;
+	}
+	m_name = name;
+	m_id = id;
+	m_attached = true;
+	m_prev = 0;
+	m_next = s_memory_head;
+	if (s_memory_head) {
+		s_memory_head->m_prev = this;
+	}
+	s_memory_head = this;
+}
+
+void DSPMemory::detach()
+{
+	std::lock_guard<std::mutex> lock(s_memory_lock);
+	if (!m_attached) {
+		return;
+	}
+	if (m_prev) {
+		m_prev->m_next = m_next;
+	}
+	else {
+		s_memory_head = m_next;
+	}
+	if (m_next) {
+		m_next->m_prev = m_prev;
+	}
+	m_prev = m_next = 0;
+	m_attached = false;
+}
+
+#pragma endregion
+
+int DSPMemory_Collect(DSPMemorySnapshot* table, int capacity)
+{
+	std::lock_guard<std::mutex> lock(s_memory_lock);
+	int count = 0;
+	// types and the pool, then instances
+	for (int pass = 0; pass < 2; pass++)
+	{
+		for (DSPMemory* memory = s_memory_head; memory; memory = memory->m_next)
+		{
+			if ((memory->m_id != 0) != (pass != 0)) {
+				continue;
+			}
+			if (table && count < capacity) {
+				memory->snapshot(&table[count]);
+			}
+			count++;
+		}
+	}
+	return count;
+}
+
+void DSPMemory_ResetPeaks()
+{
+	std::lock_guard<std::mutex> lock(s_memory_lock);
+	for (DSPMemory* memory = s_memory_head; memory; memory = memory->m_next)
+	{
+		memory->resetPeak();
+	}
+}
+
+#pragma region Exports
+
+// Fills `table` with up to `capacity` rows and returns the account count; call
+// with a null table to size it. Never blocks the mixer.
+DLLEXPORT int PointDSP_GetMemory(DSPMemorySnapshot* table, int capacity)
+{
+	return DSPMemory_Collect(table, capacity);
+}
+DLLEXPORT void PointDSP_ResetMemoryPeaks()
+{
+	DSPMemory_ResetPeaks();
+}
+
+#pragma endregion
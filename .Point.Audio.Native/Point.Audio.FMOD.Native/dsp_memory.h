@@ -0,0 +1,112 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// dsp_memory.h: bytes every Point DSP plugin type and instance holds.
+// A DSPMemory account counts what is charged to it and credited back: live
+// bytes, the high-water mark of those, and the allocations and frees. DSPPool
+// charges each block to the account it is allocated for and credits it when
+// the block is freed, whoever frees it, so a type's account covers its live
+// instances, their staging buffers and the released instances its warm pool
+// keeps, and a block some teardown forgets stays live on it.
+// Every instance also keeps an account of its own blocks, charged at create
+// and credited at release.
+//
+// Accounts are only touched on create, release and the first offloaded or
+// batched block, never per block, so they use plain atomic read-modify-writes.
+// The list PointDSP_GetMemory walks is guarded by a mutex, like dsp_stats.h.
+
+#pragma once
+
+#ifndef __DSP_MEMORY_H__
+#define __DSP_MEMORY_H__
+
+#include <atomic>
+
+// bytes of DSPMemorySnapshot::name, terminator included
+#define DSP_MEMORY_NAME_LENGTH 32
+
+// One account; plain C layout so that it can be marshalled as is.
+struct DSPMemorySnapshot
+{
+	// plugin type, FMOD_DSP_DESCRIPTION::name, or the pool's arenas
+	char name[DSP_MEMORY_NAME_LENGTH];
+	// the instance's DSPStatsSnapshot::id, 0 for a type
+	unsigned long long id;
+	// live instances of a type, 1 for an instance
+	unsigned int instances;
+	unsigned int padding;
+	unsigned long long live;
+	// most bytes live at once since create or the last reset
+	unsigned long long peak;
+	unsigned long long allocations;
+	unsigned long long frees;
+};
+
+class DSPMemory
+{
+public:
+	DSPMemory();
+
+	void charge(size_t bytes);
+	void credit(size_t bytes);
+
+	// Any thread.
+	void snapshot(DSPMemorySnapshot* snapshot) const;
+	// Moves the high-water mark down to the bytes live now.
+	void resetPeak();
+
+	// Joins or leaves the list PointDSP_GetMemory walks; joining again is a
+	// no-op. A type joins on its first create and stays, an instance joins at
+	// create and leaves at release.
+	void attach(const char* name, unsigned long long id);
+	void detach();
+
+	// Live instances of a type.
+	void addInstance() { m_instances.fetch_add(1, std::memory_order_relaxed); }
+	void removeInstance() { m_instances.fetch_sub(1, std::memory_order_relaxed); }
+
+private:
+	std::atomic<unsigned long long> m_live;
+	std::atomic<unsigned long long> m_peak;
+	std::atomic<unsigned long long> m_allocations;
+	std::atomic<unsigned long long> m_frees;
+	std::atomic<unsigned int> m_instances;
+
+	const char* m_name;
+	unsigned long long m_id;
+	bool m_attached;
+	DSPMemory* m_prev;
+	DSPMemory* m_next;
+
+	friend int DSPMemory_Collect(DSPMemorySnapshot* table, int capacity);
+	friend void DSPMemory_ResetPeaks();
+};
+
+// Fills up to `capacity` rows, types and the pool first and then instances,
+// and returns the number of accounts, which may be more than it filled.
+int DSPMemory_Collect(DSPMemorySnapshot* table, int capacity);
+// Moves every account's high-water mark down to its live bytes.
+void DSPMemory_ResetPeaks();
+
+// The account of plugin type T, shared by every instance of it.
+template<typename T>
+DSPMemory* DSPMemory_Type()
+{
+	static DSPMemory s_memory;
+	return &s_memory;
+}
+
+#endif // !__DSP_MEMORY_H__
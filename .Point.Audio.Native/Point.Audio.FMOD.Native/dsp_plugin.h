@@ -0,0 +1,1078 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// dsp_plugin.h: header-only scaffolding shared by the Point DSP plugins.
+// A plugin derives from DSPPlugin<Self> and declares its parameters as a
+// constexpr table, `static constexpr DSPParameter<Self> Parameters[]`, plus a
+// `static constexpr DSPPluginInfo Info`. DSPPlugin<Self>::description() builds
+// the FMOD_DSP_DESCRIPTION and every callback from those:
+//
+//   create/release  one allocation holding the instance, from DSPPool and kept
+//                   warm for the next create of the type (see allocate)
+//   setparam        prepare() on the calling thread, then posts into the
+//                   instance's ParamMailbox
+//   getparam        reads the latest posted value back
+//   process QUERY   applies posted parameters through the table's setters, then query()
+//   process PERFORM perform(), which calls Self::process directly, or for a
+//                   DSP_PLUGIN_PLANAR plugin Self::processPlanar on channel planes
+//   shouldiprocess  the same silence decision the QUERY pass makes
+//   getparamdata    the "Stats" and "Memory" parameters, appended after the
+//                   table: a DSPStatsSnapshot of the instance's process times
+//                   and a DSPMemorySnapshot of the bytes it holds
+//
+// Effects (plugins with an input) also get silence handling: once the input has
+// been silent for tailLength() frames the output is silent too, so a silent
+// block is answered with zeros and skip() instead of perform(), and an idle
+// input reports FMOD_ERR_DSP_SILENCE so the mixer idles everything downstream.
+//
+// In POINT_DSP_BATCH builds a plugin flagged DSP_PLUGIN_BATCHED is processed a
+// tick late, together with the other instances of its type; see dsp_batch.h.
+// In POINT_DSP_OFFLOAD builds one flagged DSP_PLUGIN_OFFLOADABLE is processed a
+// tick late on the worker pool instead (dsp_worker_pool.h); a tick whose job
+// has not finished waits for it, so the output stays wet and one block behind. An
+// instance a bake created (dsp_bake.h) is never batched or offloaded.
+//
+// Every block an instance allocates comes from DSPPool and is charged to its
+// type's DSPMemory account and its own (dsp_memory.h).
+//
+// Every PERFORM pass is timed into the instance's DSPStats (dsp_stats.h),
+// including the staged work a batched or offloaded block hands out. In
+// POINT_DSP_TRACE builds every callback also leaves begin/end events on its
+// thread's timeline (dsp_trace.h).
+//
+// process, the batch run and the offload job flush subnormals to zero while
+// they run (SimdDenormalScope), unless the build defines POINT_DSP_KEEP_DENORMALS.
+//
+// Every hook below resolves at compile time against Self, so a plugin
+// customises one by declaring a member with the same signature, and the hot
+// path carries no virtual call or parameter switch.
+
+#pragma once
+
+#ifndef __DSP_PLUGIN_H__
+#define __DSP_PLUGIN_H__
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "param_mailbox.h"
+#include "dsp_dispatch.h"
+#include "dsp_bake.h"
+#include "dsp_batch.h"
+#include "dsp_worker_pool.h"
+#include "dsp_pool.h"
+#include "dsp_memory.h"
+#include "dsp_stats.h"
+#include "dsp_trace.h"
+#include "fmod.hpp"
+#include "fmod_dsp.h"
+
+// alignment of every plugin instance; the mailbox gets its own cache lines
+#define DSP_PLUGIN_ALIGNMENT 64
+// smallest page size of the platforms the plugins ship on
+#define DSP_PLUGIN_PAGE_SIZE 4096
+// size of the valuestr buffer FMOD passes to getparam
+#define DSP_PLUGIN_VALUESTR_LENGTH 32
+// channels assumed for speaker modes without a fixed layout
+#define DSP_PLUGIN_MAX_CHANNELS 8
+
+// DSPPluginInfo::flags
+// instances may be processed together at sys_mix, one block late (POINT_DSP_BATCH builds)
+#define DSP_PLUGIN_BATCHED 0x1
+// instances may be processed on the worker pool, one block late (POINT_DSP_OFFLOAD builds)
+#define DSP_PLUGIN_OFFLOADABLE 0x2
+// processes deinterleaved channel planes, see DSPPlugin::perform
+#define DSP_PLUGIN_PLANAR 0x4
+
+// flushes subnormals for the rest of the enclosing block
+#ifdef POINT_DSP_KEEP_DENORMALS
+#define DSP_PLUGIN_DENORMAL_SCOPE() ((void)0)
+#else
+#define DSP_PLUGIN_DENORMAL_SCOPE() SimdDenormalScope dsp_plugin_denormals
+#endif
+
+// Least scratch, in samples, a planar instance deinterleaves into. It is sized
+// for one block of the mixer's layout; wider blocks go through in chunks.
+#define DSP_PLUGIN_PLANAR_SAMPLES 1024
+
+struct DSPPluginInfo
+{
+	const char* name;
+	unsigned int version;
+	int numinputbuffers;
+	int numoutputbuffers;
+	unsigned int flags;
+};
+
+static inline unsigned int DSPPlugin_SpeakerModeChannels(FMOD_SPEAKERMODE speakermode)
+{
+	switch (speakermode)
+	{
+	case FMOD_SPEAKERMODE_MONO:
+		return 1;
+	case FMOD_SPEAKERMODE_STEREO:
+		return 2;
+	case FMOD_SPEAKERMODE_QUAD:
+		return 4;
+	case FMOD_SPEAKERMODE_SURROUND:
+		return 5;
+	case FMOD_SPEAKERMODE_5POINT1:
+		return 6;
+	case FMOD_SPEAKERMODE_DEFAULT:
+		return 2;
+	default:
+		return DSP_PLUGIN_MAX_CHANNELS;
+	}
+}
+// channels of the wider of the mixer's and the output's speaker mode
+static inline unsigned int DSPPlugin_MixerChannels(FMOD_DSP_STATE* dsp_state)
+{
+	FMOD_SPEAKERMODE mixer_speakermode, out_speakermode;
+	FMOD_DSP_GETSPEAKERMODE(dsp_state, &mixer_speakermode, &out_speakermode);
+	unsigned int channels = DSPPlugin_SpeakerModeChannels(mixer_speakermode);
+	unsigned int out_channels = DSPPlugin_SpeakerModeChannels(out_speakermode);
+	return channels < out_channels ? out_channels : channels;
+}
+
+template<typename T>
+struct DSPParameter
+{
+	FMOD_DSP_PARAMETER_TYPE type;
+	const char* name;
+	const char* label;
+	const char* description;
+	float min;
+	float max;
+	float defaultval;
+	const char* const* valuenames;
+	// piecewise linear mapping of a float parameter, 0 points for none;
+	// a mapped parameter takes min and max from its first and last point
+	float* mappingvalues;
+	float* mappingpositions;
+	int mappingpoints;
+
+	void (T::*setFloat)(float);
+	void (T::*setInt)(int);
+	void (T::*setBool)(bool);
+};
+
+template<typename T>
+constexpr DSPParameter<T> DSPParameter_Float(const char* name, const char* label, const char* description,
+	float min, float max, float defaultval, void (T::*set)(float))
+{
+	return DSPParameter<T>{ FMOD_DSP_PARAMETER_TYPE_FLOAT, name, label, description,
+		min, max, defaultval, nullptr, nullptr, nullptr, 0, set, nullptr, nullptr };
+}
+template<typename T>
+constexpr DSPParameter<T> DSPParameter_Mapped(const char* name, const char* label, const char* description,
+	float defaultval, float* values, float* positions, int points, void (T::*set)(float))
+{
+	return DSPParameter<T>{ FMOD_DSP_PARAMETER_TYPE_FLOAT, name, label, description,
+		0, 0, defaultval, nullptr, values, positions, points, set, nullptr, nullptr };
+}
+template<typename T>
+constexpr DSPParameter<T> DSPParameter_Int(const char* name, const char* label, const char* description,
+	int min, int max, int defaultval, const char* const* valuenames, void (T::*set)(int))
+{
+	return DSPParameter<T>{ FMOD_DSP_PARAMETER_TYPE_INT, name, label, description,
+		(float)min, (float)max, (float)defaultval, valuenames, nullptr, nullptr, 0, nullptr, set, nullptr };
+}
+template<typename T>
+constexpr DSPParameter<T> DSPParameter_Bool(const char* name, const char* label, const char* description,
+	bool defaultval, const char* const* valuenames, void (T::*set)(bool))
+{
+	return DSPParameter<T>{ FMOD_DSP_PARAMETER_TYPE_BOOL, name, label, description,
+		0, 1, defaultval ? 1.0f : 0.0f, valuenames, nullptr, nullptr, 0, nullptr, nullptr, set };
+}
+
+template<typename T>
+class alignas(DSP_PLUGIN_ALIGNMENT) DSPPlugin
+{
+public:
+	static const int ParameterCount = sizeof(T::Parameters) / sizeof(T::Parameters[0]);
+	// index of the data parameter that reads the instance's DSPStatsSnapshot
+	static const int StatsParameter = ParameterCount;
+	// index of the data parameter that reads the instance's DSPMemorySnapshot
+	static const int MemoryParameter = ParameterCount + 1;
+
+	// Fills the descriptor on first use and returns it.
+	static FMOD_DSP_DESCRIPTION* description()
+	{
+		static FMOD_DSP_PARAMETER_DESC params[sizeof(T::Parameters) / sizeof(T::Parameters[0]) + 2];
+		static FMOD_DSP_PARAMETER_DESC* paramlist[sizeof(T::Parameters) / sizeof(T::Parameters[0]) + 2];
+		static FMOD_DSP_DESCRIPTION desc;
+
+		for (int i = 0; i < ParameterCount; i++)
+		{
+			const DSPParameter<T>& p = T::Parameters[i];
+			switch (p.type)
+			{
+			case FMOD_DSP_PARAMETER_TYPE_FLOAT:
+				FMOD_DSP_INIT_PARAMDESC_FLOAT(params[i], p.name, p.label, p.description, p.min, p.max, p.defaultval);
+				if (p.mappingpoints) {
+					params[i].floatdesc.min = p.mappingvalues[0];
+					params[i].floatdesc.max = p.mappingvalues[p.mappingpoints - 1];
+					params[i].floatdesc.mapping.type = FMOD_DSP_PARAMETER_FLOAT_MAPPING_TYPE_PIECEWISE_LINEAR;
+					params[i].floatdesc.mapping.piecewiselinearmapping.numpoints = p.mappingpoints;
+					params[i].floatdesc.mapping.piecewiselinearmapping.pointparamvalues = p.mappingvalues;
+					params[i].floatdesc.mapping.piecewiselinearmapping.pointpositions = p.mappingpositions;
+				}
+				break;
+			case FMOD_DSP_PARAMETER_TYPE_INT:
+				FMOD_DSP_INIT_PARAMDESC_INT(params[i], p.name, p.label, p.description,
+					(int)p.min, (int)p.max, (int)p.defaultval, false, p.valuenames);
+				break;
+			case FMOD_DSP_PARAMETER_TYPE_BOOL:
+				FMOD_DSP_INIT_PARAMDESC_BOOL(params[i], p.name, p.label, p.description, p.defaultval != 0, p.valuenames);
+				break;
+			default:
+				break;
+			}
+			paramlist[i] = &params[i];
+		}
+		FMOD_DSP_INIT_PARAMDESC_DATA(params[StatsParameter], "Stats", "", "Process time statistics (DSPStatsSnapshot)",
+			FMOD_DSP_PARAMETER_DATA_TYPE_USER);
+		paramlist[StatsParameter] = &params[StatsParameter];
+		FMOD_DSP_INIT_PARAMDESC_DATA(params[MemoryParameter], "Memory", "", "Bytes the instance holds (DSPMemorySnapshot)",
+			FMOD_DSP_PARAMETER_DATA_TYPE_USER);
+		paramlist[MemoryParameter] = &params[MemoryParameter];
+
+		memset(&desc, 0, sizeof(desc));
+		desc.pluginsdkversion = FMOD_PLUGIN_SDK_VERSION;
+		strncpy(desc.name, T::Info.name, sizeof(desc.name) - 1);
+		desc.version = T::Info.version;
+		desc.numinputbuffers = T::Info.numinputbuffers;
+		desc.numoutputbuffers = T::Info.numoutputbuffers;
+		desc.create = CREATE_CALLBACK;
+		desc.release = RELEASE_CALLBACK;
+		desc.reset = RESET_CALLBACK;
+		desc.process = PROCESS_CALLBACK;
+		desc.shouldiprocess = SHOULDIPROCESS_CALLBACK;
+		desc.numparameters = ParameterCount + 2;
+		desc.paramdesc = paramlist;
+		desc.setparameterfloat = SETPARAM_FLOAT_CALLBACK;
+		desc.setparameterint = SETPARAM_INT_CALLBACK;
+		desc.setparameterbool = SETPARAM_BOOL_CALLBACK;
+		desc.getparameterfloat = GETPARAM_FLOAT_CALLBACK;
+		desc.getparameterint = GETPARAM_INT_CALLBACK;
+		desc.getparameterbool = GETPARAM_BOOL_CALLBACK;
+		desc.getparameterdata = GETPARAM_DATA_CALLBACK;
+		desc.sys_register = SYS_REGISTER_CALLBACK;
+		desc.sys_deregister = SYS_DEREGISTER_CALLBACK;
+#ifdef POINT_DSP_BATCH
+		if (T::Info.flags & DSP_PLUGIN_BATCHED) {
+			desc.sys_mix = SYS_MIX_CALLBACK;
+		}
+#endif
+
+		T::describe(&desc);
+		return &desc;
+	}
+
+	ParamMailbox& params() { return m_params; }
+
+	// Applies every parameter posted since the last call through the table's
+	// setters. Runs on the mixer thread at block start and before reset().
+	void applyParams()
+	{
+		T* self = static_cast<T*>(this);
+		m_params.drain([this, self](int index) {
+			if (ParameterCount <= index) {
+				return;
+			}
+			const DSPParameter<T>& p = T::Parameters[index];
+			switch (p.type)
+			{
+			case FMOD_DSP_PARAMETER_TYPE_FLOAT:
+				(self->*p.setFloat)(m_params.getFloat(index));
+				break;
+			case FMOD_DSP_PARAMETER_TYPE_INT:
+				(self->*p.setInt)(m_params.getInt(index));
+				break;
+			case FMOD_DSP_PARAMETER_TYPE_BOOL:
+				(self->*p.setBool)(m_params.getInt(index) != 0);
+				break;
+			default:
+				break;
+			}
+		});
+	}
+
+	#pragma region Hooks
+
+	// Allocates and sets up an instance; null when out of memory.
+	static T* create(FMOD_DSP_STATE* dsp_state)
+	{
+		T* state = allocate(dsp_state, 0);
+		if (state) {
+			state->init(dsp_state);
+		}
+		return state;
+	}
+	void release(FMOD_DSP_STATE* /*dsp_state*/)
+	{
+		if (m_offload) {
+			waitJob();
+			DSPWorkerPool::release();
+		}
+		m_stats.detach();
+		if (batched()) {
+			DSPBatch<T>::remove(static_cast<T*>(this));
+		}
+		if (m_stage) {
+			m_memory.credit(sizeof(float) * m_stage_capacity * 2);
+			DSPPool::free(m_stage);
+		}
+		m_memory.credit(m_allocation_size);
+		m_memory.detach();
+		DSPMemory_Type<T>()->removeInstance();
+
+		void* allocation = this;
+		size_t size = m_allocation_size;
+		static_cast<T*>(this)->~T();
+		if (!DSPWarmPool<T>::keep(allocation, size)) {
+			DSPPool::free(allocation);
+		}
+	}
+
+	void init(FMOD_DSP_STATE* dsp_state) {}
+	void reset() {}
+
+	// QUERY pass: one output buffer shaped like the input. Idle inputs are
+	// handled by the caller, see tailLength().
+	FMOD_RESULT query(const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray, FMOD_BOOL /*inputsidle*/)
+	{
+		if (outbufferarray && inbufferarray)
+		{
+			outbufferarray[0].buffernumchannels[0] = inbufferarray[0].buffernumchannels[0];
+			outbufferarray[0].speakermode = inbufferarray[0].speakermode;
+		}
+
+		return FMOD_OK;
+	}
+	// PERFORM pass: Self::process on the first interleaved buffer. A planar
+	// plugin instead gets the block deinterleaved into the instance's scratch
+	// planes, processes them in place with Self::processPlanar, and the result
+	// is interleaved into the output.
+	void perform(unsigned int length, const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray)
+	{
+		if (T::Info.flags & DSP_PLUGIN_PLANAR) {
+			performPlanar(inbufferarray->buffers[0], outbufferarray->buffers[0], length, inbufferarray->buffernumchannels[0]);
+			return;
+		}
+
+		static_cast<T*>(this)->process(
+			inbufferarray->buffers[0], outbufferarray->buffers[0],
+			length,
+			inbufferarray->buffernumchannels[0],
+			outbufferarray->buffernumchannels[0]);
+	}
+	void process(float* /*inbuffer*/, float* /*outbuffer*/, unsigned int /*length*/, int /*inchannels*/, int /*outchannels*/) {}
+	// planes[c] holds `length` frames of channel c, 64 byte aligned
+	void processPlanar(float* const* /*planes*/, unsigned int /*length*/, int /*channels*/) {}
+
+	// Structure-of-arrays batch pass, see dsp_batch.h. A type that has one
+	// shadows BatchLanes with its own tiles and these hooks; the defaults
+	// decline, leaving every block to performStage.
+	typedef DSPBatchLanes BatchLanes;
+	// Joins the pass with the staged block as lanes [base, base + channels), or
+	// returns false to have it performed on its own. Runs before any tile.
+	bool batchBegin(BatchLanes& /*lanes*/, int /*base*/, unsigned int /*length*/, int /*channels*/, FMOD_SPEAKERMODE /*speakermode*/) { return false; }
+	// Fills the type's own tiles for frames [frame, frame + count) of the block.
+	void batchGather(BatchLanes& /*lanes*/, int /*base*/, unsigned int /*frame*/, unsigned int /*count*/, int /*channels*/) {}
+	// Computes the output tile's first `count` frames across `width` lanes.
+	static void batchTile(BatchLanes& /*lanes*/, unsigned int /*count*/, unsigned int /*width*/) {}
+	// Takes the lane state back after the last tile.
+	void batchEnd(const BatchLanes& /*lanes*/, int /*base*/, unsigned int /*length*/, int /*channels*/) {}
+
+	// Frames of silent input after which the output is silent as well, e.g.
+	// the longest delay an effect still plays out.
+	unsigned int tailLength() { return 0; }
+	// Advances time-based state over a block answered with silence.
+	void skip(unsigned int /*length*/) {}
+
+	// Runs in the setparam callback before the value is posted, on the thread
+	// that set it rather than the mixer thread, e.g. to build something the
+	// setter then only has to look up. Int and bool values arrive as float.
+	void prepare(int /*index*/, float /*value*/) {}
+
+	// Last word on the descriptor, e.g. for sys_* callbacks.
+	static void describe(FMOD_DSP_DESCRIPTION* /*desc*/) {}
+
+	#pragma endregion
+
+protected:
+	// Allocates sizeof(T) + extra bytes aligned to DSP_PLUGIN_ALIGNMENT, a
+	// released instance of the same size if the type kept one, and constructs
+	// T at the start; the extra bytes follow the instance, and a planar
+	// plugin's scratch planes follow those. Every parameter is posted at its
+	// default so the first block applies them.
+	static T* allocate(FMOD_DSP_STATE* dsp_state, size_t extra)
+	{
+		unsigned int planar = 0;
+		if (T::Info.flags & DSP_PLUGIN_PLANAR) {
+			const unsigned int align = DSP_PLUGIN_ALIGNMENT / sizeof(float);
+			unsigned int blocksize;
+			FMOD_DSP_GETBLOCKSIZE(dsp_state, &blocksize);
+			planar = ((blocksize + align - 1) & ~(align - 1)) * DSPPlugin_MixerChannels(dsp_state);
+			if (planar < DSP_PLUGIN_PLANAR_SAMPLES) planar = DSP_PLUGIN_PLANAR_SAMPLES;
+		}
+		static_assert(DSP_PLUGIN_ALIGNMENT <= DSP_POOL_ALIGNMENT, "DSPPool blocks have to be aligned for the instance");
+		size_t bytes = sizeof(T) + extra + (planar ? sizeof(float) * planar + DSP_PLUGIN_ALIGNMENT : 0);
+		void* allocation = DSPWarmPool<T>::take(bytes);
+		bool warm = allocation != 0;
+		if (!allocation) {
+			allocation = DSPPool::allocate(dsp_state, bytes, DSPMemory_Type<T>());
+		}
+		if (!allocation) {
+			return 0;
+		}
+
+		size_t aligned = (size_t)allocation;
+		T* state = new (allocation) T();
+		state->m_allocation_size = bytes;
+		state->m_warm = warm;
+		state->m_silent_frames = UINT_MAX;
+		state->m_planar = 0;
+		state->m_planar_capacity = planar;
+		if (planar) {
+			size_t scratch = aligned + sizeof(T) + extra;
+			state->m_planar = (float*)((scratch + DSP_PLUGIN_ALIGNMENT - 1) & ~(size_t)(DSP_PLUGIN_ALIGNMENT - 1));
+		}
+		state->m_batch_slot.store(-1, std::memory_order_relaxed);
+		state->m_stage = 0;
+		state->m_stage_capacity = 0;
+		state->m_stage_ready = 0;
+		state->m_latency = 0;
+		state->m_offload = false;
+		state->m_job.store(DSP_JOB_IDLE, std::memory_order_relaxed);
+		state->m_stage_ns = 0;
+		state->m_stage_charge = 0;
+
+		int samplerate;
+		FMOD_DSP_GETSAMPLERATE(dsp_state, &samplerate);
+		state->m_frame_ns = 0 < samplerate ? 1e9f / samplerate : 0;
+		state->m_stats.attach(T::Info.name);
+
+		DSPMemory* type = DSPMemory_Type<T>();
+		type->attach(T::Info.name, 0);
+		type->addInstance();
+		state->m_memory.attach(T::Info.name, state->m_stats.id());
+		state->m_memory.charge(bytes);
+#ifdef POINT_DSP_OFFLOAD
+		if ((T::Info.flags & DSP_PLUGIN_OFFLOADABLE) && !DSPBake_Owns(dsp_state)) {
+			state->joinPool(dsp_state);
+		}
+#endif
+#ifdef POINT_DSP_BATCH
+		if (!state->m_offload && (T::Info.flags & DSP_PLUGIN_BATCHED) && !DSPBake_Owns(dsp_state)) {
+			state->joinBatch(dsp_state);
+		}
+#endif
+
+		state->m_params.clear();
+		for (int i = 0; i < ParameterCount; i++)
+		{
+			const DSPParameter<T>& p = T::Parameters[i];
+			if (p.type == FMOD_DSP_PARAMETER_TYPE_FLOAT) {
+				state->m_params.postFloat(i, p.defaultval);
+			}
+			else {
+				state->m_params.postInt(i, (int)p.defaultval);
+			}
+		}
+		return state;
+	}
+
+	// True when allocate() reused an instance the type kept warm, whose memory
+	// a mixer thread has already written.
+	bool warm() const { return m_warm; }
+
+	// Writes one float per page of `bytes` from `data`, so a fresh allocation
+	// is mapped before the mixer thread reaches it. The contents are not cleared.
+	static void prefault(float* data, size_t bytes)
+	{
+		for (size_t offset = 0; offset < bytes; offset += DSP_PLUGIN_PAGE_SIZE)
+		{
+			data[offset / sizeof(float)] = 0;
+		}
+	}
+
+	// Points planes[c] at the scratch as performPlanar lays out one chunk.
+	// False when a block of `length` frames would take more than one.
+	bool scratchPlanes(float** planes, unsigned int length, int channels)
+	{
+		if (channels <= 0 || FMOD_MAX_CHANNEL_WIDTH < channels) {
+			return false;
+		}
+		const unsigned int align = DSP_PLUGIN_ALIGNMENT / sizeof(float);
+		unsigned int chunk = (m_planar_capacity / channels) & ~(align - 1);
+		if (chunk < length) {
+			return false;
+		}
+		for (int c = 0; c < channels; c++)
+		{
+			planes[c] = m_planar + c * chunk;
+		}
+		return true;
+	}
+	// scratchPlanes holding the staged input, for a batch pass
+	bool stagedPlanes(float** planes, unsigned int length, int channels)
+	{
+		if (!scratchPlanes(planes, length, channels)) {
+			return false;
+		}
+		DSPKernels().deinterleave(m_stage, planes, length, channels);
+		return true;
+	}
+
+private:
+	ParamMailbox m_params;
+	// bytes of the DSPPool block the instance starts
+	size_t m_allocation_size;
+	bool m_warm;
+	// frames of silent input in a row, saturating; UINT_MAX after create and reset
+	unsigned int m_silent_frames;
+	// scratch for the channel planes, null unless planar
+	float* m_planar;
+	// samples in m_planar
+	unsigned int m_planar_capacity;
+
+	// Deinterleaves, processes and reinterleaves the block in chunks that fit
+	// the scratch, each plane starting on an alignment boundary. The output has
+	// the input's layout, as the default query() shapes it.
+	void performPlanar(const float* inbuffer, float* outbuffer, unsigned int length, int channels)
+	{
+		if (channels <= 0) {
+			return;
+		}
+		const unsigned int align = DSP_PLUGIN_ALIGNMENT / sizeof(float);
+		unsigned int chunk = (m_planar_capacity / channels) & ~(align - 1);
+
+		// FMOD buffers are at most FMOD_MAX_CHANNEL_WIDTH wide
+		float* planes[FMOD_MAX_CHANNEL_WIDTH];
+		for (int c = 0; c < channels; c++)
+		{
+			planes[c] = m_planar + c * chunk;
+		}
+
+		const DSPKernelTable& kernels = DSPKernels();
+		for (unsigned int frame = 0; frame < length; frame += chunk)
+		{
+			unsigned int count = length - frame < chunk ? length - frame : chunk;
+			kernels.deinterleave(inbuffer + frame * channels, planes, count, channels);
+			static_cast<T*>(this)->processPlanar(planes, count, channels);
+			kernels.interleave(planes, outbuffer + frame * channels, count, channels);
+		}
+	}
+
+	// Batch table slot, -1 while processed directly. Written only under the
+	// table's lock, since removing another instance can move this one.
+	std::atomic<int> m_batch_slot;
+	// staging input followed by staging output, m_stage_capacity samples each
+	float* m_stage;
+	unsigned int m_stage_capacity;
+	// samples of staging output computed for the next PERFORM pass
+	unsigned int m_stage_ready;
+	// frames between input and output, one block while batched or offloaded
+	unsigned int m_latency;
+
+	DSPStats m_stats;
+	// what the Stats parameter last handed out
+	DSPStatsSnapshot m_stats_snapshot;
+	// this instance's share of its type's account
+	DSPMemory m_memory;
+	// what the Memory parameter last handed out
+	DSPMemorySnapshot m_memory_snapshot;
+	// duration of one frame at the mixer's rate
+	float m_frame_ns;
+	// time performStage took over the staged block
+	unsigned int m_stage_ns;
+	// staged time the current PERFORM pass hands out with its output
+	unsigned int m_stage_charge;
+
+	enum
+	{
+		DSP_JOB_IDLE = 0,
+		// owned by a worker; the mixer thread leaves the instance alone
+		DSP_JOB_QUEUED,
+		// staging output holds the block, owned by the mixer thread again
+		DSP_JOB_DONE,
+	};
+	// processed on the worker pool
+	bool m_offload;
+	std::atomic<int> m_job;
+	// block the queued job processes
+	unsigned int m_job_length;
+	int m_job_channels;
+	FMOD_SPEAKERMODE m_job_speakermode;
+
+	friend class DSPBatch<T>;
+
+	// The input is idle and its tail has played out.
+	bool isSilent(FMOD_BOOL inputsidle)
+	{
+		return T::Info.numinputbuffers && inputsidle && tailDone(m_silent_frames);
+	}
+	// `frames` of silent input have played out everything the instance can
+	// still output. Unknown, so false, while a worker owns the instance.
+	bool tailDone(unsigned int frames)
+	{
+		return !busy() && static_cast<T*>(this)->tailLength() + m_latency <= frames;
+	}
+
+	#pragma region Staging
+
+	// Allocates staging input and output sized for one block of the mixer's
+	// widest layout.
+	bool allocateStage(FMOD_DSP_STATE* dsp_state, unsigned int* blocksize)
+	{
+		FMOD_DSP_GETBLOCKSIZE(dsp_state, blocksize);
+		unsigned int capacity = *blocksize * DSPPlugin_MixerChannels(dsp_state);
+		m_stage = (float*)DSPPool::allocate(dsp_state, sizeof(float) * capacity * 2, DSPMemory_Type<T>());
+		if (!m_stage) {
+			return false;
+		}
+		m_memory.charge(sizeof(float) * capacity * 2);
+		m_stage_capacity = capacity;
+		return true;
+	}
+
+	// Runs perform() from the staging input into the staging output.
+	void performStage(unsigned int length, int channels, FMOD_SPEAKERMODE speakermode)
+	{
+		float* input = m_stage;
+		float* output = m_stage + m_stage_capacity;
+		FMOD_CHANNELMASK mask = 0;
+
+		FMOD_DSP_BUFFER_ARRAY in;
+		in.numbuffers = 1;
+		in.buffernumchannels = &channels;
+		in.bufferchannelmask = &mask;
+		in.buffers = &input;
+		in.speakermode = speakermode;
+		FMOD_DSP_BUFFER_ARRAY out = in;
+		out.buffers = &output;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		static_cast<T*>(this)->perform(length, &in, &out);
+		m_stage_ns = elapsedNs(start);
+		m_stage_ready = length * channels;
+	}
+
+	// Forgets a staged result that no PERFORM pass is going to hand out.
+	void dropStage()
+	{
+		m_stage_ready = 0;
+		if (!m_offload) {
+			return;
+		}
+		waitJob();
+		m_job.store(DSP_JOB_IDLE, std::memory_order_relaxed);
+	}
+
+	#pragma endregion
+
+	#pragma region Batch
+
+	// Takes a slot in the type's batch table. Stays direct when that or the
+	// staging allocation fails.
+	void joinBatch(FMOD_DSP_STATE* dsp_state)
+	{
+		unsigned int blocksize;
+		if (!allocateStage(dsp_state, &blocksize)) {
+			return;
+		}
+
+		if (DSPBatch<T>::add(static_cast<T*>(this))) {
+			m_latency = blocksize;
+		}
+	}
+	bool batched() { return 0 <= m_batch_slot.load(std::memory_order_relaxed); }
+	// under the batch table's lock
+	int batchSlot() { return m_batch_slot.load(std::memory_order_relaxed); }
+	void setBatchSlot(int slot) { m_batch_slot.store(slot, std::memory_order_relaxed); }
+
+	// PERFORM pass of a batched instance: stage this block's input and hand
+	// back the previous one's output. False when the block does not fit.
+	bool stageBlock(unsigned int length, const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray)
+	{
+		int channels = inbufferarray->buffernumchannels[0];
+		unsigned int samples = length * channels;
+		if (m_stage_capacity < samples || channels != outbufferarray->buffernumchannels[0]) {
+			return false;
+		}
+
+		if (m_stage_ready == samples) {
+			memcpy(outbufferarray->buffers[0], m_stage + m_stage_capacity, sizeof(float) * samples);
+			m_stage_charge = m_stage_ns;
+		}
+		else {
+			memset(outbufferarray->buffers[0], 0, sizeof(float) * samples);
+		}
+		m_stage_ready = 0;
+
+		memcpy(m_stage, inbufferarray->buffers[0], sizeof(float) * samples);
+		DSPBatch<T>::stage(static_cast<T*>(this), length, channels, inbufferarray->speakermode);
+		return true;
+	}
+
+	#pragma endregion
+
+	#pragma region Offload
+
+	void joinPool(FMOD_DSP_STATE* dsp_state)
+	{
+		unsigned int blocksize;
+		if (!allocateStage(dsp_state, &blocksize) || !DSPWorkerPool::acquire()) {
+			return;
+		}
+		m_offload = true;
+		m_latency = blocksize;
+	}
+
+	bool busy()
+	{
+		return m_offload && m_job.load(std::memory_order_acquire) == DSP_JOB_QUEUED;
+	}
+	// Blocks until no worker owns the instance; at most one block's processing.
+	void waitJob()
+	{
+		while (busy())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// PERFORM pass of an offloaded instance: hand back the block the pool
+	// computed since the last tick and queue this one. A job that is late is
+	// waited for, as the mixer thread would have spent that time processing
+	// the block itself; handing out anything else would jump the stream back a
+	// block and drop the wet signal. False when the block does not fit.
+	bool offloadBlock(unsigned int length, const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray)
+	{
+		int channels = inbufferarray->buffernumchannels[0];
+		unsigned int samples = length * channels;
+		const float* input = inbufferarray->buffers[0];
+		float* output = outbufferarray->buffers[0];
+		bool matching = channels == outbufferarray->buffernumchannels[0];
+
+		// the wait is timed into this pass already, so the job's own time is not charged on top
+		bool late = busy();
+		waitJob();
+		int job = m_job.load(std::memory_order_acquire);
+		m_job.store(DSP_JOB_IDLE, std::memory_order_relaxed);
+
+		if (m_stage_capacity < samples || !matching) {
+			m_stage_ready = 0;
+			return false;
+		}
+
+		if (job == DSP_JOB_DONE && m_stage_ready == samples) {
+			memcpy(output, m_stage + m_stage_capacity, sizeof(float) * samples);
+			m_stage_charge = late ? 0 : m_stage_ns;
+		}
+		else {
+			memset(output, 0, sizeof(float) * samples);
+		}
+		m_stage_ready = 0;
+
+		applyParams();
+		memcpy(m_stage, input, sizeof(float) * samples);
+		m_job_length = length;
+		m_job_channels = channels;
+		m_job_speakermode = inbufferarray->speakermode;
+
+		m_job.store(DSP_JOB_QUEUED, std::memory_order_release);
+		DSPWorkerJob work = { OFFLOAD_JOB, static_cast<T*>(this) };
+		if (!DSPWorkerPool::submit(work)) {
+			// every queue is full; the result still goes out next tick
+			OFFLOAD_JOB(static_cast<T*>(this));
+		}
+		return true;
+	}
+
+	static void OFFLOAD_JOB(void* context)
+	{
+		T* state = (T*)context;
+		DSP_TRACE_SCOPE(T::Info.name, "job", state);
+		DSP_PLUGIN_DENORMAL_SCOPE();
+		state->performStage(state->m_job_length, state->m_job_channels, state->m_job_speakermode);
+		state->m_job.store(DSP_JOB_DONE, std::memory_order_release);
+	}
+
+	#pragma endregion
+
+	#pragma region Stats
+
+	static unsigned int elapsedNs(std::chrono::steady_clock::time_point start)
+	{
+		long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - start).count();
+		return ns < 0 ? 0 : (ns < UINT_MAX ? (unsigned int)ns : UINT_MAX);
+	}
+	// Records the PERFORM pass that began at `start`, plus the staged work it
+	// handed out, against a budget of the block's duration.
+	void recordBlock(unsigned int length, std::chrono::steady_clock::time_point start)
+	{
+		unsigned int ns = elapsedNs(start);
+		ns = UINT_MAX - ns < m_stage_charge ? UINT_MAX : ns + m_stage_charge;
+		m_stage_charge = 0;
+		float budget = length * m_frame_ns * DSPStats_GetBudgetShare();
+		m_stats.record(ns, budget < (float)UINT_MAX ? (unsigned int)budget : UINT_MAX);
+	}
+
+	#pragma endregion
+
+	// PERFORM pass: silence, then the offloaded, batched or direct path.
+	void performBlock(unsigned int length, const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray, FMOD_BOOL inputsidle)
+	{
+		if (T::Info.numinputbuffers) {
+			// an idle input is fed with silence, so only a live one needs looking at
+			bool silent = inputsidle || DSPKernels().isSilent(inbufferarray->buffers[0],
+				length * inbufferarray->buffernumchannels[0], POINT_SILENCE_THRESHOLD);
+			unsigned int before = m_silent_frames;
+			m_silent_frames = !silent ? 0 : (UINT_MAX - before < length ? UINT_MAX : before + length);
+
+			if (silent && tailDone(before)) {
+				memset(outbufferarray->buffers[0], 0, sizeof(float) * length * outbufferarray->buffernumchannels[0]);
+				static_cast<T*>(this)->skip(length);
+				dropStage();
+				return;
+			}
+		}
+
+		if (m_offload && offloadBlock(length, inbufferarray, outbufferarray)) {
+			return;
+		}
+
+		if (batched() && stageBlock(length, inbufferarray, outbufferarray)) {
+			return;
+		}
+
+		static_cast<T*>(this)->perform(length, inbufferarray, outbufferarray);
+	}
+
+	#pragma region Callbacks
+
+	static FMOD_RESULT F_CALL CREATE_CALLBACK(FMOD_DSP_STATE* dsp_state)
+	{
+		DSP_TRACE_SCOPE(T::Info.name, "create", 0);
+		T* state = T::create(dsp_state);
+		dsp_state->plugindata = state;
+		if (!state) {
+			return FMOD_ERR_MEMORY;
+		}
+		return FMOD_OK;
+	}
+	static FMOD_RESULT F_CALL RELEASE_CALLBACK(FMOD_DSP_STATE* dsp_state)
+	{
+		T* state = (T*)dsp_state->plugindata;
+		DSP_TRACE_SCOPE(T::Info.name, "release", state);
+		state->release(dsp_state);
+		return FMOD_OK;
+	}
+	static FMOD_RESULT F_CALL RESET_CALLBACK(FMOD_DSP_STATE* dsp_state)
+	{
+		T* state = (T*)dsp_state->plugindata;
+		DSP_TRACE_SCOPE(T::Info.name, "reset", state);
+		state->waitJob();
+		state->applyParams();
+		state->reset();
+		state->m_silent_frames = UINT_MAX;
+		state->dropStage();
+		return FMOD_OK;
+	}
+
+	static FMOD_RESULT F_CALL PROCESS_CALLBACK(
+		FMOD_DSP_STATE* dsp_state, unsigned int length,
+		const FMOD_DSP_BUFFER_ARRAY* inbufferarray, FMOD_DSP_BUFFER_ARRAY* outbufferarray,
+		FMOD_BOOL inputsidle, FMOD_DSP_PROCESS_OPERATION op)
+	{
+		T* state = (T*)dsp_state->plugindata;
+		DSP_PLUGIN_DENORMAL_SCOPE();
+
+		if (op == FMOD_DSP_PROCESS_QUERY) {
+			DSP_TRACE_SCOPE(T::Info.name, "query", state);
+			// an offloaded instance applies them when it queues its next job
+			if (!state->busy()) {
+				state->applyParams();
+			}
+			FMOD_RESULT result = state->query(inbufferarray, outbufferarray, inputsidle);
+			if (result == FMOD_OK && state->isSilent(inputsidle)) {
+				result = FMOD_ERR_DSP_SILENCE;
+			}
+			if (result != FMOD_OK) {
+				// no PERFORM pass follows, so a staged output would go stale
+				state->dropStage();
+			}
+			return result;
+		}
+
+		DSP_TRACE_SCOPE(T::Info.name, "process", state);
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		state->performBlock(length, inbufferarray, outbufferarray, inputsidle);
+		state->recordBlock(length, start);
+		return FMOD_OK;
+	}
+	// Once per FMOD system the type is registered with, before any instance.
+	static FMOD_RESULT F_CALL SYS_REGISTER_CALLBACK(FMOD_DSP_STATE* dsp_state)
+	{
+		DSPPool::acquire(dsp_state);
+		DSPWarmPool<T>::open();
+		return FMOD_OK;
+	}
+	// After the type's last instance is gone.
+	static FMOD_RESULT F_CALL SYS_DEREGISTER_CALLBACK(FMOD_DSP_STATE* /*dsp_state*/)
+	{
+		DSPWarmPool<T>::close();
+		DSPPool::release();
+		return FMOD_OK;
+	}
+	// Once per mixer tick for the type; stage 1 comes after every instance's PERFORM pass.
+	static FMOD_RESULT F_CALL SYS_MIX_CALLBACK(FMOD_DSP_STATE* dsp_state, int stage)
+	{
+		if (stage == 1) {
+			DSP_TRACE_SCOPE(T::Info.name, "batch", 0);
+			DSP_PLUGIN_DENORMAL_SCOPE();
+			DSPBatch<T>::run();
+		}
+		return FMOD_OK;
+	}
+	static FMOD_RESULT F_CALL SHOULDIPROCESS_CALLBACK(
+		FMOD_DSP_STATE* dsp_state, FMOD_BOOL inputsidle, unsigned int /*length*/,
+		FMOD_CHANNELMASK /*inmask*/, int inchannels, FMOD_SPEAKERMODE /*speakermode*/)
+	{
+		T* state = (T*)dsp_state->plugindata;
+		if (state->isSilent(inputsidle) || (T::Info.numinputbuffers && inchannels <= 0)) {
+			return FMOD_ERR_DSP_SILENCE;
+		}
+		return FMOD_OK;
+	}
+
+	static bool isParameter(int index, FMOD_DSP_PARAMETER_TYPE type)
+	{
+		return (unsigned int)index < (unsigned int)ParameterCount && T::Parameters[index].type == type;
+	}
+
+	static FMOD_RESULT F_CALL SETPARAM_FLOAT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, float value)
+	{
+		if (!isParameter(index, FMOD_DSP_PARAMETER_TYPE_FLOAT)) {
+			return FMOD_ERR_INVALID_PARAM;
+		}
+		DSP_TRACE_SCOPE(T::Info.name, "setparam", dsp_state->plugindata);
+		T* state = (T*)dsp_state->plugindata;
+		state->prepare(index, value);
+		state->m_params.postFloat(index, value);
+		return FMOD_OK;
+	}
+	static FMOD_RESULT F_CALL SETPARAM_INT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, int value)
+	{
+		if (!isParameter(index, FMOD_DSP_PARAMETER_TYPE_INT)) {
+			return FMOD_ERR_INVALID_PARAM;
+		}
+		DSP_TRACE_SCOPE(T::Info.name, "setparam", dsp_state->plugindata);
+		T* state = (T*)dsp_state->plugindata;
+		state->prepare(index, (float)value);
+		state->m_params.postInt(index, value);
+		return FMOD_OK;
+	}
+	static FMOD_RESULT F_CALL SETPARAM_BOOL_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, FMOD_BOOL value)
+	{
+		if (!isParameter(index, FMOD_DSP_PARAMETER_TYPE_BOOL)) {
+			return FMOD_ERR_INVALID_PARAM;
+		}
+		DSP_TRACE_SCOPE(T::Info.name, "setparam", dsp_state->plugindata);
+		T* state = (T*)dsp_state->plugindata;
+		state->prepare(index, value ? 1.0f : 0.0f);
+		state->m_params.postInt(index, value ? 1 : 0);
+		return FMOD_OK;
+	}
+
+	static FMOD_RESULT F_CALL GETPARAM_FLOAT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, float* value, char* valuestr)
+	{
+		if (!isParameter(index, FMOD_DSP_PARAMETER_TYPE_FLOAT)) {
+			return FMOD_ERR_INVALID_PARAM;
+		}
+		*value = ((T*)dsp_state->plugindata)->m_params.getFloat(index);
+		if (valuestr) {
+			const char* label = T::Parameters[index].label;
+			snprintf(valuestr, DSP_PLUGIN_VALUESTR_LENGTH, *label ? "%.1f %s" : "%.2f", *value, label);
+		}
+		return FMOD_OK;
+	}
+	static FMOD_RESULT F_CALL GETPARAM_INT_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, int* value, char* valuestr)
+	{
+		if (!isParameter(index, FMOD_DSP_PARAMETER_TYPE_INT)) {
+			return FMOD_ERR_INVALID_PARAM;
+		}
+		*value = ((T*)dsp_state->plugindata)->m_params.getInt(index);
+		if (valuestr) {
+			const DSPParameter<T>& p = T::Parameters[index];
+			if (p.valuenames && p.min <= *value && *value <= p.max) {
+				snprintf(valuestr, DSP_PLUGIN_VALUESTR_LENGTH, "%s", p.valuenames[*value - (int)p.min]);
+			}
+			else {
+				snprintf(valuestr, DSP_PLUGIN_VALUESTR_LENGTH, "%d", *value);
+			}
+		}
+		return FMOD_OK;
+	}
+	static FMOD_RESULT F_CALL GETPARAM_BOOL_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, FMOD_BOOL* value, char* valuestr)
+	{
+		if (!isParameter(index, FMOD_DSP_PARAMETER_TYPE_BOOL)) {
+			return FMOD_ERR_INVALID_PARAM;
+		}
+		*value = ((T*)dsp_state->plugindata)->m_params.getInt(index) ? 1 : 0;
+		if (valuestr) {
+			const char* const* names = T::Parameters[index].valuenames;
+			snprintf(valuestr, DSP_PLUGIN_VALUESTR_LENGTH, "%s", names ? names[*value ? 1 : 0] : (*value ? "On" : "Off"));
+		}
+		return FMOD_OK;
+	}
+	static FMOD_RESULT F_CALL GETPARAM_DATA_CALLBACK(FMOD_DSP_STATE* dsp_state, int index, void** data, unsigned int* length, char* valuestr)
+	{
+		T* state = (T*)dsp_state->plugindata;
+		if (index == MemoryParameter) {
+			state->m_memory.snapshot(&state->m_memory_snapshot);
+			*data = &state->m_memory_snapshot;
+			*length = sizeof(DSPMemorySnapshot);
+			if (valuestr) {
+				snprintf(valuestr, DSP_PLUGIN_VALUESTR_LENGTH, "%.1f KB", state->m_memory_snapshot.live / 1024.0);
+			}
+			return FMOD_OK;
+		}
+		if (index != StatsParameter) {
+			return FMOD_ERR_INVALID_PARAM;
+		}
+		state->m_stats.snapshot(&state->m_stats_snapshot);
+		*data = &state->m_stats_snapshot;
+		*length = sizeof(DSPStatsSnapshot);
+		if (valuestr) {
+			snprintf(valuestr, DSP_PLUGIN_VALUESTR_LENGTH, "%.1f us", state->m_stats_snapshot.average);
+		}
+		return FMOD_OK;
+	}
+
+	#pragma endregion
+};
+
+#endif // !__DSP_PLUGIN_H__
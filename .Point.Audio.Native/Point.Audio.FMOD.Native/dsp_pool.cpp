@@ -0,0 +1,437 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <limits.h>
+#include <string.h>
+
+#include "pch.h"
+#include "dsp_pool.h"
+
+// payload sizes below this map linearly onto the first level
+#define DSP_TLSF_SMALL (DSP_TLSF_SL_COUNT * DSP_POOL_ALIGNMENT)
+#define DSP_TLSF_FL_SHIFT 11
+#define DSP_TLSF_MAX_SIZE ((size_t)1 << (DSP_TLSF_FL_COUNT + DSP_TLSF_FL_SHIFT - 2))
+
+// DSPTlsf::Block::size flags
+#define DSP_TLSF_FREE ((size_t)1)
+#define DSP_TLSF_PREV_FREE ((size_t)2)
+#define DSP_TLSF_FLAGS ((size_t)(DSP_POOL_ALIGNMENT - 1))
+
+static inline int DSPTlsf_Fls(size_t value)
+{
+	int bit = 0;
+	while (value >>= 1)
+	{
+		bit++;
+	}
+	return bit;
+}
+static inline int DSPTlsf_Ffs(unsigned int value)
+{
+	int bit = 0;
+	while (!(value & 1))
+	{
+		value >>= 1;
+		bit++;
+	}
+	return bit;
+}
+
+#pragma region DSPTlsf
+
+void DSPTlsf::init()
+{
+	static_assert(sizeof(Block) <= DSP_POOL_ALIGNMENT, "a block header has to fit one alignment unit");
+	m_fl_bitmap = 0;
+	memset(m_sl_bitmap, 0, sizeof(m_sl_bitmap));
+	memset(m_free, 0, sizeof(m_free));
+	m_used = 0;
+	m_available = 0;
+}
+
+void DSPTlsf::mapping(size_t size, int* fl, int* sl)
+{
+	if (size < DSP_TLSF_SMALL) {
+		*fl = 0;
+		*sl = (int)(size / DSP_POOL_ALIGNMENT);
+		return;
+	}
+	int bit = DSPTlsf_Fls(size);
+	*sl = (int)(size >> (bit - DSP_TLSF_SL_LOG2)) ^ DSP_TLSF_SL_COUNT;
+	*fl = bit - (DSP_TLSF_FL_SHIFT - 1);
+}
+
+void DSPTlsf::insert(Block* block)
+{
+	int fl, sl;
+	mapping(block->size & ~DSP_TLSF_FLAGS, &fl, &sl);
+	Block* head = m_free[fl][sl];
+	block->next_free = head;
+	block->prev_free = 0;
+	if (head) {
+		head->prev_free = block;
+	}
+	m_free[fl][sl] = block;
+	m_fl_bitmap |= 1u << fl;
+	m_sl_bitmap[fl] |= 1u << sl;
+}
+
+void DSPTlsf::remove(Block* block)
+{
+	int fl, sl;
+	mapping(block->size & ~DSP_TLSF_FLAGS, &fl, &sl);
+	if (block->next_free) {
+		block->next_free->prev_free = block->prev_free;
+	}
+	if (block->prev_free) {
+		block->prev_free->next_free = block->next_free;
+	}
+	else {
+		m_free[fl][sl] = block->next_free;
+		if (!block->next_free) {
+			m_sl_bitmap[fl] &= ~(1u << sl);
+			if (!m_sl_bitmap[fl]) {
+				m_fl_bitmap &= ~(1u << fl);
+			}
+		}
+	}
+}
+
+bool DSPTlsf::addRegion(void* memory, size_t size)
+{
+	size &= ~(size_t)(DSP_POOL_ALIGNMENT - 1);
+	// one free block and the zero sized, allocated sentinel that ends the region
+	if (size < 3 * DSP_POOL_ALIGNMENT || DSP_TLSF_MAX_SIZE <= size) {
+		return false;
+	}
+
+	Block* block = (Block*)memory;
+	size_t payload = size - 2 * DSP_POOL_ALIGNMENT;
+	block->prev = 0;
+	block->size = payload | DSP_TLSF_FREE;
+
+	Block* sentinel = (Block*)((char*)memory + DSP_POOL_ALIGNMENT + payload);
+	sentinel->prev = block;
+	sentinel->size = DSP_TLSF_PREV_FREE;
+
+	insert(block);
+	m_available += payload;
+	return true;
+}
+
+void* DSPTlsf::allocate(size_t size)
+{
+	size = (size + DSP_POOL_ALIGNMENT - 1) & ~(size_t)(DSP_POOL_ALIGNMENT - 1);
+	if (!size) {
+		size = DSP_POOL_ALIGNMENT;
+	}
+	if (DSP_TLSF_MAX_SIZE <= size) {
+		return 0;
+	}
+
+	// round up to the next class boundary so that any block of the class found fits
+	size_t search = size;
+	if (DSP_TLSF_SMALL <= search) {
+		search += ((size_t)1 << (DSPTlsf_Fls(search) - DSP_TLSF_SL_LOG2)) - 1;
+	}
+	int fl, sl;
+	mapping(search, &fl, &sl);
+	if (DSP_TLSF_FL_COUNT <= fl) {
+		return 0;
+	}
+
+	unsigned int sl_map = m_sl_bitmap[fl] & (~0u << sl);
+	if (!sl_map) {
+		unsigned int fl_map = fl + 1 < DSP_TLSF_FL_COUNT ? m_fl_bitmap & (~0u << (fl + 1)) : 0;
+		if (!fl_map) {
+			return 0;
+		}
+		fl = DSPTlsf_Ffs(fl_map);
+		sl_map = m_sl_bitmap[fl];
+	}
+	sl = DSPTlsf_Ffs(sl_map);
+	Block* block = m_free[fl][sl];
+	remove(block);
+
+	size_t blocksize = block->size & ~DSP_TLSF_FLAGS;
+	Block* next = (Block*)((char*)block + DSP_POOL_ALIGNMENT + blocksize);
+	if (size + 2 * DSP_POOL_ALIGNMENT <= blocksize) {
+		// the rest becomes a free block of its own
+		Block* rest = (Block*)((char*)block + DSP_POOL_ALIGNMENT + size);
+		rest->prev = block;
+		rest->size = (blocksize - size - DSP_POOL_ALIGNMENT) | DSP_TLSF_FREE;
+		next->prev = rest;
+		insert(rest);
+		block->size = size | (block->size & DSP_TLSF_PREV_FREE);
+		m_available -= size + DSP_POOL_ALIGNMENT;
+	}
+	else {
+		next->size &= ~DSP_TLSF_PREV_FREE;
+		block->size &= ~DSP_TLSF_FREE;
+		m_available -= blocksize;
+	}
+
+	m_used++;
+	return (char*)block + DSP_POOL_ALIGNMENT;
+}
+
+void DSPTlsf::free(void* ptr)
+{
+	if (!ptr) {
+		return;
+	}
+	Block* block = (Block*)((char*)ptr - DSP_POOL_ALIGNMENT);
+	size_t size = block->size & ~DSP_TLSF_FLAGS;
+	Block* next = (Block*)((char*)block + DSP_POOL_ALIGNMENT + size);
+	m_used--;
+	m_available += size;
+
+	if (block->size & DSP_TLSF_PREV_FREE) {
+		Block* prev = block->prev;
+		remove(prev);
+		prev->size += DSP_POOL_ALIGNMENT + size;
+		m_available += DSP_POOL_ALIGNMENT;
+		block = prev;
+	}
+	else {
+		block->size |= DSP_TLSF_FREE;
+	}
+	if (next->size & DSP_TLSF_FREE) {
+		remove(next);
+		size_t nextsize = next->size & ~DSP_TLSF_FLAGS;
+		block->size += DSP_POOL_ALIGNMENT + nextsize;
+		m_available += DSP_POOL_ALIGNMENT;
+		next = (Block*)((char*)next + DSP_POOL_ALIGNMENT + nextsize);
+	}
+	next->prev = block;
+	next->size |= DSP_TLSF_PREV_FREE;
+	insert(block);
+}
+
+#pragma endregion
+
+#pragma region DSPPool
+
+namespace
+{
+	// Sits in the alignment unit in front of every block DSPPool hands out.
+	struct DSPPoolRecord
+	{
+		// null for a block from the heap
+		FMOD_DSP_FREE_FUNC free;
+		// what to give back: the heap block or the FMOD allocation
+		void* allocation;
+		// charged with the block's size, credited on free; may be null
+		DSPMemory* account;
+		size_t size;
+	};
+
+	// Head of every arena, in front of the region it adds to the heap.
+	struct DSPPoolArena
+	{
+		void* allocation;
+		size_t size;
+		DSPPoolArena* next;
+	};
+
+	struct
+	{
+		DSPBatchLock lock;
+		// registered plugin types
+		int users;
+		// allocator of the system the heap serves
+		FMOD_DSP_ALLOC_FUNC alloc;
+		FMOD_DSP_FREE_FUNC free;
+		DSPTlsf heap;
+		DSPPoolArena* arenas;
+	} s_pool;
+
+	// the arenas, as FMOD sees them
+	DSPMemory s_pool_memory;
+
+	inline DSPPoolRecord* DSPPool_Record(void* ptr)
+	{
+		return (DSPPoolRecord*)((char*)ptr - DSP_POOL_ALIGNMENT);
+	}
+
+	inline void DSPPool_Charge(DSPPoolRecord* record, DSPMemory* account, size_t size)
+	{
+		record->account = account;
+		record->size = size;
+		if (account) {
+			account->charge(size);
+		}
+	}
+
+	// Unlinks the arenas once the heap is closed and holds no block; the caller
+	// frees them outside the lock.
+	DSPPoolArena* DSPPool_Retire()
+	{
+		if (s_pool.users || !s_pool.heap.empty()) {
+			return 0;
+		}
+		DSPPoolArena* arenas = s_pool.arenas;
+		s_pool.arenas = 0;
+		s_pool.heap.init();
+		return arenas;
+	}
+	void DSPPool_FreeArenas(DSPPoolArena* arenas, FMOD_DSP_FREE_FUNC freefunc)
+	{
+		while (arenas)
+		{
+			DSPPoolArena* next = arenas->next;
+			s_pool_memory.credit(arenas->size);
+			freefunc(arenas->allocation, FMOD_MEMORY_NORMAL, __FILE__);
+			arenas = next;
+		}
+	}
+
+	// Takes an arena for at least `size` more bytes from FMOD, touches it, and
+	// adds it to the heap.
+	bool DSPPool_Grow(FMOD_DSP_STATE* dsp_state, size_t size)
+	{
+		size_t bytes = size + 4 * DSP_POOL_ALIGNMENT;
+		if (bytes < DSP_POOL_ARENA_SIZE) {
+			bytes = DSP_POOL_ARENA_SIZE;
+		}
+		if (UINT_MAX < bytes) {
+			return false;
+		}
+		void* allocation = FMOD_DSP_ALLOC(dsp_state, (unsigned int)bytes);
+		if (!allocation) {
+			return false;
+		}
+		memset(allocation, 0, bytes);
+
+		size_t aligned = ((size_t)allocation + DSP_POOL_ALIGNMENT - 1) & ~(size_t)(DSP_POOL_ALIGNMENT - 1);
+		DSPPoolArena* arena = (DSPPoolArena*)aligned;
+		arena->allocation = allocation;
+		arena->size = bytes;
+		void* region = (void*)(aligned + DSP_POOL_ALIGNMENT);
+		size_t regionsize = bytes - (aligned - (size_t)allocation) - DSP_POOL_ALIGNMENT;
+
+		s_pool.lock.lock();
+		bool added = s_pool.users && dsp_state->functions->alloc == s_pool.alloc
+			&& s_pool.heap.addRegion(region, regionsize);
+		if (added) {
+			arena->next = s_pool.arenas;
+			s_pool.arenas = arena;
+		}
+		s_pool.lock.unlock();
+
+		if (!added) {
+			FMOD_DSP_FREE(dsp_state, allocation);
+			return false;
+		}
+		s_pool_memory.attach("Point DSP pool", 0);
+		s_pool_memory.charge(bytes);
+		return true;
+	}
+}
+
+void DSPPool::acquire(FMOD_DSP_STATE* dsp_state)
+{
+	s_pool.lock.lock();
+	if (!s_pool.users && !s_pool.arenas) {
+		s_pool.heap.init();
+		s_pool.alloc = dsp_state->functions->alloc;
+		s_pool.free = dsp_state->functions->free;
+	}
+	s_pool.users++;
+	s_pool.lock.unlock();
+}
+
+void DSPPool::release()
+{
+	s_pool.lock.lock();
+	if (0 < s_pool.users) {
+		s_pool.users--;
+	}
+	DSPPoolArena* arenas = DSPPool_Retire();
+	FMOD_DSP_FREE_FUNC freefunc = s_pool.free;
+	s_pool.lock.unlock();
+
+	DSPPool_FreeArenas(arenas, freefunc);
+}
+
+void* DSPPool::allocate(FMOD_DSP_STATE* dsp_state, size_t size, DSPMemory* account)
+{
+	size_t bytes = size + DSP_POOL_ALIGNMENT;
+
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		s_pool.lock.lock();
+		bool open = s_pool.users && dsp_state->functions->alloc == s_pool.alloc;
+		void* block = open ? s_pool.heap.allocate(bytes) : 0;
+		s_pool.lock.unlock();
+
+		if (block) {
+			DSPPoolRecord* record = (DSPPoolRecord*)block;
+			record->free = 0;
+			record->allocation = block;
+			DSPPool_Charge(record, account, size);
+			return (char*)block + DSP_POOL_ALIGNMENT;
+		}
+		if (!open || !DSPPool_Grow(dsp_state, bytes)) {
+			break;
+		}
+	}
+
+	// straight from FMOD, with room to align and for the record
+	if (UINT_MAX - 2 * DSP_POOL_ALIGNMENT < size) {
+		return 0;
+	}
+	void* allocation = FMOD_DSP_ALLOC(dsp_state, (unsigned int)(bytes + DSP_POOL_ALIGNMENT - 1));
+	if (!allocation) {
+		return 0;
+	}
+	size_t aligned = ((size_t)allocation + DSP_POOL_ALIGNMENT - 1) & ~(size_t)(DSP_POOL_ALIGNMENT - 1);
+	DSPPoolRecord* record = (DSPPoolRecord*)aligned;
+	record->free = dsp_state->functions->free;
+	record->allocation = allocation;
+	DSPPool_Charge(record, account, size);
+	return (void*)(aligned + DSP_POOL_ALIGNMENT);
+}
+
+void DSPPool::free(void* ptr)
+{
+	if (!ptr) {
+		return;
+	}
+	DSPPoolRecord* record = DSPPool_Record(ptr);
+	if (record->account) {
+		record->account->credit(record->size);
+	}
+	if (record->free) {
+		record->free(record->allocation, FMOD_MEMORY_NORMAL, __FILE__);
+		return;
+	}
+
+	s_pool.lock.lock();
+	s_pool.heap.free(record->allocation);
+	DSPPoolArena* arenas = DSPPool_Retire();
+	FMOD_DSP_FREE_FUNC freefunc = s_pool.free;
+	s_pool.lock.unlock();
+
+	DSPPool_FreeArenas(arenas, freefunc);
+}
+
+bool DSPPool::pooled(void* ptr)
+{
+	return ptr && !DSPPool_Record(ptr)->free;
+}
+
+#pragma endregion
@@ -0,0 +1,202 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// dsp_pool.h: memory for plugin instances that voice churn does not take to
+// FMOD's general allocator.
+//
+// DSPPool hands out 64 byte aligned blocks from a TLSF heap (two-level
+// segregated fit: a bitmap per size class, so allocate and free are O(1) and
+// never search). The heap grows by arenas of DSP_POOL_ARENA_SIZE taken with
+// FMOD_DSP_ALLOC and touched once when they arrive, so a block taken later is
+// already mapped. It is open while at least one plugin type is registered with
+// FMOD (sys_register) and gives its arenas back once the last type is gone and
+// the last block is free; outside that window, or for a system with another
+// allocator, blocks come straight from FMOD_DSP_ALLOC.
+//
+// On top of it DSPWarmPool<T> keeps up to DSP_POOL_WARM_INSTANCES released
+// instances of one type whole, and hands one back to the next create of the
+// same size, so a voice that comes and goes costs neither allocator anything.
+
+#pragma once
+
+#ifndef __DSP_POOL_H__
+#define __DSP_POOL_H__
+
+#include <stddef.h>
+
+#include "dsp_batch.h"
+#include "dsp_memory.h"
+#include "fmod.hpp"
+#include "fmod_dsp.h"
+
+// alignment of every block, also the size of a block header
+#define DSP_POOL_ALIGNMENT 64
+// least memory the heap grows by
+#define DSP_POOL_ARENA_SIZE (4u << 20)
+// released instances kept per plugin type
+#define DSP_POOL_WARM_INSTANCES 16
+
+// second level classes per power of two, log2
+#define DSP_TLSF_SL_LOG2 5
+#define DSP_TLSF_SL_COUNT (1 << DSP_TLSF_SL_LOG2)
+// first level classes; the largest block is below 2^(DSP_TLSF_FL_COUNT + 9) bytes
+#define DSP_TLSF_FL_COUNT 22
+
+// TLSF heap over memory it is given. Not thread safe; DSPPool locks around it.
+class DSPTlsf
+{
+public:
+	void init();
+	// Adds [memory, memory + size) to the heap; memory is DSP_POOL_ALIGNMENT aligned.
+	bool addRegion(void* memory, size_t size);
+
+	// DSP_POOL_ALIGNMENT aligned, null when no free block is large enough.
+	void* allocate(size_t size);
+	void free(void* ptr);
+
+	// no block is allocated
+	bool empty() const { return m_used == 0; }
+	// bytes that no allocated block holds, headers excluded
+	size_t available() const { return m_available; }
+
+private:
+	struct Block
+	{
+		// physically preceding block, for merging with it
+		Block* prev;
+		// payload bytes, a multiple of DSP_POOL_ALIGNMENT; the low bits are flags
+		size_t size;
+		// free list links, valid while free
+		Block* next_free;
+		Block* prev_free;
+	};
+
+	unsigned int m_fl_bitmap;
+	unsigned int m_sl_bitmap[DSP_TLSF_FL_COUNT];
+	Block* m_free[DSP_TLSF_FL_COUNT][DSP_TLSF_SL_COUNT];
+	size_t m_used;
+	size_t m_available;
+
+	static void mapping(size_t size, int* fl, int* sl);
+	void insert(Block* block);
+	void remove(Block* block);
+};
+
+namespace DSPPool
+{
+	// A plugin type was registered with (or deregistered from) the FMOD system
+	// of `dsp_state`; the first registration opens the heap.
+	void acquire(FMOD_DSP_STATE* dsp_state);
+	void release();
+
+	// DSP_POOL_ALIGNMENT aligned; null when out of memory. `account`, if any,
+	// is charged with `size` until the block is freed.
+	void* allocate(FMOD_DSP_STATE* dsp_state, size_t size, DSPMemory* account);
+	// Takes anything allocate() returned.
+	void free(void* ptr);
+	// `ptr` came out of the heap rather than FMOD_DSP_ALLOC directly.
+	bool pooled(void* ptr);
+}
+
+// Released allocations of plugin type T, kept whole while the type is registered.
+template<typename T>
+class DSPWarmPool
+{
+public:
+	static void open()
+	{
+		Table& table = s_table;
+		table.lock.lock();
+		table.users++;
+		table.lock.unlock();
+	}
+	// Gives every kept allocation back to DSPPool once the last user is gone.
+	static void close()
+	{
+		Table& table = s_table;
+		void* kept[DSP_POOL_WARM_INSTANCES];
+		int count = 0;
+		table.lock.lock();
+		if (0 < table.users && --table.users == 0) {
+			count = table.count;
+			for (int i = 0; i < count; i++)
+			{
+				kept[i] = table.allocation[i];
+			}
+			table.count = 0;
+		}
+		table.lock.unlock();
+
+		for (int i = 0; i < count; i++)
+		{
+			DSPPool::free(kept[i]);
+		}
+	}
+
+	// A kept allocation of exactly `size` bytes, or null.
+	static void* take(size_t size)
+	{
+		Table& table = s_table;
+		void* allocation = 0;
+		table.lock.lock();
+		for (int i = table.count - 1; 0 <= i; i--)
+		{
+			if (table.size[i] == size) {
+				allocation = table.allocation[i];
+				table.count--;
+				table.allocation[i] = table.allocation[table.count];
+				table.size[i] = table.size[table.count];
+				break;
+			}
+		}
+		table.lock.unlock();
+		return allocation;
+	}
+	// Keeps a released allocation; false when the caller has to free it.
+	static bool keep(void* allocation, size_t size)
+	{
+		if (!DSPPool::pooled(allocation)) {
+			return false;
+		}
+		Table& table = s_table;
+		bool kept = false;
+		table.lock.lock();
+		if (table.users && table.count < DSP_POOL_WARM_INSTANCES) {
+			table.allocation[table.count] = allocation;
+			table.size[table.count] = size;
+			table.count++;
+			kept = true;
+		}
+		table.lock.unlock();
+		return kept;
+	}
+
+private:
+	struct Table
+	{
+		DSPBatchLock lock;
+		int users;
+		int count;
+		void* allocation[DSP_POOL_WARM_INSTANCES];
+		size_t size[DSP_POOL_WARM_INSTANCES];
+	};
+	static Table s_table;
+};
+
+template<typename T>
+typename DSPWarmPool<T>::Table DSPWarmPool<T>::s_table;
+
+#endif // !__DSP_POOL_H__
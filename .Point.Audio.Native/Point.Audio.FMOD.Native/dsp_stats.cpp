@@ -0,0 +1,220 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <limits.h>
+#include <mutex>
+
+#include "pch.h"
+#include "dsp_stats.h"
+
+// Bucket of a block that took `ns`: below 4 ns one per nanosecond, above that
+// four per octave, split on the two bits under the leading one.
+static inline unsigned int DSPStats_Bucket(unsigned int ns)
+{
+	if (ns < 4) {
+		return ns;
+	}
+	unsigned int octave = 31;
+	while (!(ns >> octave))
+	{
+		octave--;
+	}
+	return (octave - 1) * 4 + ((ns >> (octave - 2)) & 3);
+}
+// First nanosecond count past `bucket`.
+static inline unsigned long long DSPStats_BucketEnd(unsigned int bucket)
+{
+	if (bucket < 4) {
+		return bucket + 1;
+	}
+	unsigned int octave = bucket / 4 + 1;
+	return (unsigned long long)(5 + bucket % 4) << (octave - 2);
+}
+
+static std::mutex s_stats_lock;
+static DSPStats* s_stats_head = 0;
+static unsigned long long s_stats_next_id = 1;
+static std::atomic<float> s_stats_budget_share(1.0f);
+
+#pragma region DSPStats
+
+DSPStats::DSPStats()
+	: m_name(""), m_id(0), m_prev(0), m_next(0)
+{
+	clear();
+	m_reset.store(false, std::memory_order_relaxed);
+}
+
+void DSPStats::clear()
+{
+	m_blocks.store(0, std::memory_order_relaxed);
+	m_overbudget.store(0, std::memory_order_relaxed);
+	m_budget.store(0, std::memory_order_relaxed);
+	m_min.store(UINT_MAX, std::memory_order_relaxed);
+	m_max.store(0, std::memory_order_relaxed);
+	m_total.store(0, std::memory_order_relaxed);
+	for (int i = 0; i < DSP_STATS_BUCKETS; i++)
+	{
+		m_histogram[i].store(0, std::memory_order_relaxed);
+	}
+}
+
+void DSPStats::record(unsigned int ns, unsigned int budget_ns)
+{
+	if (m_reset.load(std::memory_order_relaxed) && m_reset.exchange(false, std::memory_order_relaxed)) {
+		clear();
+	}
+
+	std::atomic<unsigned int>& bucket = m_histogram[DSPStats_Bucket(ns)];
+	bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	if (ns < m_min.load(std::memory_order_relaxed)) {
+		m_min.store(ns, std::memory_order_relaxed);
+	}
+	if (m_max.load(std::memory_order_relaxed) < ns) {
+		m_max.store(ns, std::memory_order_relaxed);
+	}
+	if (budget_ns < ns) {
+		m_overbudget.store(m_overbudget.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+	m_budget.store(budget_ns, std::memory_order_relaxed);
+	m_total.store(m_total.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+	// last, so a reader never sees more blocks than the counters hold
+	m_blocks.store(m_blocks.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void DSPStats::snapshot(DSPStatsSnapshot* snapshot) const
+{
+	unsigned int blocks = m_blocks.load(std::memory_order_acquire);
+
+	strncpy(snapshot->name, m_name, DSP_STATS_NAME_LENGTH - 1);
+	snapshot->name[DSP_STATS_NAME_LENGTH - 1] = 0;
+	snapshot->id = m_id;
+	snapshot->blocks = blocks;
+	snapshot->overbudget = m_overbudget.load(std::memory_order_relaxed);
+	snapshot->budget = m_budget.load(std::memory_order_relaxed) * 1e-3f;
+	if (!blocks) {
+		snapshot->minimum = snapshot->average = snapshot->maximum = snapshot->p99 = 0;
+		return;
+	}
+	snapshot->minimum = m_min.load(std::memory_order_relaxed) * 1e-3f;
+	snapshot->maximum = m_max.load(std::memory_order_relaxed) * 1e-3f;
+	snapshot->average = (float)((double)m_total.load(std::memory_order_relaxed) / blocks * 1e-3);
+
+	// the histogram may run a block ahead of `blocks`, so count it up as it is
+	unsigned int counts[DSP_STATS_BUCKETS];
+	unsigned long long recorded = 0;
+	for (int i = 0; i < DSP_STATS_BUCKETS; i++)
+	{
+		counts[i] = m_histogram[i].load(std::memory_order_relaxed);
+		recorded += counts[i];
+	}
+	unsigned long long rank = recorded - recorded / 100;
+	unsigned long long seen = 0;
+	int bucket = 0;
+	for (; bucket < DSP_STATS_BUCKETS - 1; bucket++)
+	{
+		seen += counts[bucket];
+		if (rank <= seen) {
+			break;
+		}
+	}
+	// the bucket edge may lie past the slowest block itself
+	float p99 = (float)(DSPStats_BucketEnd(bucket) * 1e-3);
+	snapshot->p99 = snapshot->maximum < p99 ? snapshot->maximum : p99;
+}
+
+void DSPStats::attach(const char* name)
+{
+	std::lock_guard<std::mutex> lock(s_stats_lock);
+	m_name = name;
+	m_id = s_stats_next_id++;
+	m_prev = 0;
+	m_next = s_stats_head;
+	if (s_stats_head) {
+		s_stats_head->m_prev = this;
+	}
+	s_stats_head = this;
+}
+
+void DSPStats::detach()
+{
+	std::lock_guard<std::mutex> lock(s_stats_lock);
+	if (m_prev) {
+		m_prev->m_next = m_next;
+	}
+	else if (s_stats_head == this) {
+		s_stats_head = m_next;
+	}
+	if (m_next) {
+		m_next->m_prev = m_prev;
+	}
+	m_prev = m_next = 0;
+}
+
+#pragma endregion
+
+int DSPStats_Collect(DSPStatsSnapshot* table, int capacity)
+{
+	std::lock_guard<std::mutex> lock(s_stats_lock);
+	int count = 0;
+	for (DSPStats* stats = s_stats_head; stats; stats = stats->m_next)
+	{
+		if (table && count < capacity) {
+			stats->snapshot(&table[count]);
+		}
+		count++;
+	}
+	return count;
+}
+
+void DSPStats_ResetAll()
+{
+	std::lock_guard<std::mutex> lock(s_stats_lock);
+	for (DSPStats* stats = s_stats_head; stats; stats = stats->m_next)
+	{
+		stats->reset();
+	}
+}
+
+float DSPStats_GetBudgetShare()
+{
+	return s_stats_budget_share.load(std::memory_order_relaxed);
+}
+void DSPStats_SetBudgetShare(float share)
+{
+	if (0 < share) {
+		s_stats_budget_share.store(share, std::memory_order_relaxed);
+	}
+}
+
+#pragma region Exports
+
+// Fills `table` with up to `capacity` rows and returns the live instance count;
+// call with a null table to size it. Never blocks the mixer.
+DLLEXPORT int PointDSP_GetStats(DSPStatsSnapshot* table, int capacity)
+{
+	return DSPStats_Collect(table, capacity);
+}
+DLLEXPORT void PointDSP_ResetStats()
+{
+	DSPStats_ResetAll();
+}
+DLLEXPORT void PointDSP_SetStatsBudget(float share)
+{
+	DSPStats_SetBudgetShare(share);
+}
+
+#pragma endregion
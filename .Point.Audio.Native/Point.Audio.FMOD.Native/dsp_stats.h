@@ -0,0 +1,109 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// dsp_stats.h: process time statistics of every live Point DSP instance.
+// The mixer thread is the only writer of an instance's counters, so recording
+// a block is a handful of relaxed loads and stores, no read-modify-write and no
+// lock. Readers (getparameterdata, PointDSP_GetStats) take whatever the counters
+// hold at the time; a row may be a block behind in one field and not another.
+// The list of live instances is guarded by a mutex that only create, release
+// and the readers take, never the mixer thread.
+
+#pragma once
+
+#ifndef __DSP_STATS_H__
+#define __DSP_STATS_H__
+
+#include <atomic>
+
+// histogram buckets: four per octave of nanoseconds, see DSPStats_Bucket
+#define DSP_STATS_BUCKETS 128
+// bytes of DSPStatsSnapshot::name, terminator included
+#define DSP_STATS_NAME_LENGTH 32
+
+// One instance's statistics; plain C layout so that it can be marshalled as is.
+// Times are in microseconds.
+struct DSPStatsSnapshot
+{
+	// plugin type, FMOD_DSP_DESCRIPTION::name
+	char name[DSP_STATS_NAME_LENGTH];
+	// unique per instance for the lifetime of the library
+	unsigned long long id;
+	// blocks recorded since create or the last reset
+	unsigned int blocks;
+	// blocks that took longer than their budget
+	unsigned int overbudget;
+	// budget of the last block, its duration times the budget share
+	float budget;
+	float minimum;
+	float average;
+	float maximum;
+	// upper edge of the histogram bucket holding the 99th percentile, at most maximum
+	float p99;
+};
+
+class DSPStats
+{
+public:
+	DSPStats();
+
+	// Mixer thread only.
+	void record(unsigned int ns, unsigned int budget_ns);
+
+	// Any thread.
+	void snapshot(DSPStatsSnapshot* snapshot) const;
+	// Clears the counters with the next recorded block.
+	void reset() { m_reset.store(true, std::memory_order_relaxed); }
+
+	// Joins or leaves the list PointDSP_GetStats walks; create/release only.
+	void attach(const char* name);
+	void detach();
+	// assigned by attach, 0 before
+	unsigned long long id() const { return m_id; }
+
+private:
+	std::atomic<unsigned int> m_blocks;
+	std::atomic<unsigned int> m_overbudget;
+	std::atomic<unsigned int> m_budget;
+	std::atomic<unsigned int> m_min;
+	std::atomic<unsigned int> m_max;
+	std::atomic<unsigned long long> m_total;
+	std::atomic<unsigned int> m_histogram[DSP_STATS_BUCKETS];
+	std::atomic<bool> m_reset;
+
+	const char* m_name;
+	unsigned long long m_id;
+	DSPStats* m_prev;
+	DSPStats* m_next;
+
+	void clear();
+
+	friend int DSPStats_Collect(DSPStatsSnapshot* table, int capacity);
+	friend void DSPStats_ResetAll();
+};
+
+// Fills up to `capacity` rows, one per live instance, and returns the number of
+// live instances, which may be more than it filled.
+int DSPStats_Collect(DSPStatsSnapshot* table, int capacity);
+// Asks every live instance to clear its counters.
+void DSPStats_ResetAll();
+
+// Share of a block's duration one instance may take before the block counts as
+// over budget; 1 by default, i.e. slower than real time.
+float DSPStats_GetBudgetShare();
+void DSPStats_SetBudgetShare(float share);
+
+#endif // !__DSP_STATS_H__
@@ -0,0 +1,221 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <stdio.h>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "pch.h"
+#include "dsp_trace.h"
+
+#ifdef POINT_DSP_TRACE
+
+struct DSPTraceEvent
+{
+	// steady clock, ns; the clock QueryPerformanceCounter based captures use on Windows
+	long long time;
+	const char* type;
+	const char* event;
+	const void* instance;
+	char phase;
+};
+
+struct DSPTraceRing
+{
+	// events ever written; the writer publishes each one by bumping it
+	std::atomic<unsigned long long> head;
+	// events before this one were cleared
+	std::atomic<unsigned long long> start;
+	std::atomic<const char*> name;
+	int tid;
+	DSPTraceRing* next;
+	DSPTraceEvent events[DSP_TRACE_CAPACITY];
+};
+
+static std::mutex s_trace_lock;
+static DSPTraceRing* s_trace_rings = 0;
+static int s_trace_threads = 0;
+static thread_local DSPTraceRing* s_trace_ring = 0;
+
+// Frees the rings when the library unloads; no thread records by then.
+static struct DSPTraceRings
+{
+	~DSPTraceRings()
+	{
+		while (s_trace_rings)
+		{
+			DSPTraceRing* next = s_trace_rings->next;
+			delete s_trace_rings;
+			s_trace_rings = next;
+		}
+	}
+} s_trace_rings_owner;
+
+// The calling thread's ring, created on its first event. Null when out of memory.
+static DSPTraceRing* DSPTrace_ThreadRing()
+{
+	if (s_trace_ring) {
+		return s_trace_ring;
+	}
+
+	DSPTraceRing* ring = new (std::nothrow) DSPTraceRing;
+	if (!ring) {
+		return 0;
+	}
+	ring->head.store(0, std::memory_order_relaxed);
+	ring->start.store(0, std::memory_order_relaxed);
+	ring->name.store(0, std::memory_order_relaxed);
+
+	std::lock_guard<std::mutex> lock(s_trace_lock);
+	ring->tid = ++s_trace_threads;
+	ring->next = s_trace_rings;
+	s_trace_rings = ring;
+	s_trace_ring = ring;
+	return ring;
+}
+
+void DSPTrace_Record(char phase, const char* type, const char* event, const void* instance)
+{
+	DSPTraceRing* ring = DSPTrace_ThreadRing();
+	if (!ring) {
+		return;
+	}
+
+	unsigned long long head = ring->head.load(std::memory_order_relaxed);
+	DSPTraceEvent& e = ring->events[head & (DSP_TRACE_CAPACITY - 1)];
+	e.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	e.type = type;
+	e.event = event;
+	e.instance = instance;
+	e.phase = phase;
+	ring->head.store(head + 1, std::memory_order_release);
+}
+
+void DSPTrace_NameThread(const char* name)
+{
+	DSPTraceRing* ring = DSPTrace_ThreadRing();
+	if (ring) {
+		ring->name.store(name, std::memory_order_relaxed);
+	}
+}
+
+// Copies the ring's events from oldest to newest and keeps those its writer
+// cannot have touched during the copy.
+static void DSPTrace_Copy(DSPTraceRing* ring, std::vector<DSPTraceEvent>* events)
+{
+	unsigned long long end = ring->head.load(std::memory_order_acquire);
+	unsigned long long begin = ring->start.load(std::memory_order_relaxed);
+	if (begin + DSP_TRACE_CAPACITY < end) {
+		begin = end - DSP_TRACE_CAPACITY;
+	}
+
+	events->clear();
+	for (unsigned long long i = begin; i < end; i++)
+	{
+		events->push_back(ring->events[i & (DSP_TRACE_CAPACITY - 1)]);
+	}
+
+	// meanwhile the writer may have lapped the oldest copies, and be halfway
+	// through the slot after its head
+	std::atomic_thread_fence(std::memory_order_acquire);
+	unsigned long long after = ring->head.load(std::memory_order_relaxed);
+	if (begin + DSP_TRACE_CAPACITY < after + 1) {
+		unsigned long long lapped = after + 1 - DSP_TRACE_CAPACITY - begin;
+		events->erase(events->begin(), events->begin() + (lapped < events->size() ? lapped : events->size()));
+	}
+}
+
+bool DSPTrace_Dump(const char* path)
+{
+	FILE* file = fopen(path, "w");
+	if (!file) {
+		return false;
+	}
+
+	std::vector<DSPTraceEvent> events;
+	events.reserve(DSP_TRACE_CAPACITY);
+	bool first = true;
+
+	fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	std::lock_guard<std::mutex> lock(s_trace_lock);
+	for (DSPTraceRing* ring = s_trace_rings; ring; ring = ring->next)
+	{
+		const char* name = ring->name.load(std::memory_order_relaxed);
+		fprintf(file, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+			first ? "" : ",", ring->tid, name ? name : "Point DSP thread", ring->tid);
+		first = false;
+
+		DSPTrace_Copy(ring, &events);
+		// an end whose begin was overwritten would close the wrong slice
+		int depth = 0;
+		for (size_t i = 0; i < events.size(); i++)
+		{
+			const DSPTraceEvent& e = events[i];
+			if (e.phase == 'E') {
+				if (!depth) {
+					continue;
+				}
+				depth--;
+			}
+			else {
+				depth++;
+			}
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"instance\":\"%p\"}}",
+				e.event, e.type, e.phase, e.time * 1e-3, ring->tid, e.instance);
+		}
+	}
+	fprintf(file, "\n]}\n");
+
+	bool written = !ferror(file);
+	return fclose(file) == 0 && written;
+}
+
+void DSPTrace_Clear()
+{
+	std::lock_guard<std::mutex> lock(s_trace_lock);
+	for (DSPTraceRing* ring = s_trace_rings; ring; ring = ring->next)
+	{
+		ring->start.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+}
+
+#else
+
+void DSPTrace_Record(char /*phase*/, const char* /*type*/, const char* /*event*/, const void* /*instance*/) {}
+void DSPTrace_NameThread(const char* /*name*/) {}
+bool DSPTrace_Dump(const char* /*path*/) { return false; }
+void DSPTrace_Clear() {}
+
+#endif // POINT_DSP_TRACE
+
+#pragma region Exports
+
+// Writes the trace to `path` as Chrome trace JSON; 0 when tracing is compiled
+// out or the file cannot be written.
+DLLEXPORT int PointDSP_DumpTrace(const char* path)
+{
+	return DSPTrace_Dump(path) ? 1 : 0;
+}
+DLLEXPORT void PointDSP_ClearTrace()
+{
+	DSPTrace_Clear();
+}
+
+#pragma endregion
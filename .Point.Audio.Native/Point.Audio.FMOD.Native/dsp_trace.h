@@ -0,0 +1,80 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// dsp_trace.h: timeline of the plugin callbacks, for POINT_DSP_TRACE builds.
+// Every thread that emits an event gets its own ring of DSP_TRACE_CAPACITY
+// events on first use; the thread is the ring's only writer, so recording is a
+// timestamp and a store, wait-free, and the oldest events are overwritten once
+// the ring is full. DSPTrace_Dump() writes whatever the rings hold as Chrome
+// trace JSON (chrome://tracing, ui.perfetto.dev) while the mixer keeps running.
+//
+// Without POINT_DSP_TRACE the DSP_TRACE_* macros expand to nothing and
+// DSPTrace_Dump() reports failure.
+
+#pragma once
+
+#ifndef __DSP_TRACE_H__
+#define __DSP_TRACE_H__
+
+// events one thread's ring holds, power of two
+#define DSP_TRACE_CAPACITY (1 << 15)
+
+// Begin ('B') or end ('E') of `event` on the calling thread. `type` groups the
+// events, e.g. the plugin name; both must be string literals or outlive the
+// library. `instance` tells instances of one type apart, may be null.
+void DSPTrace_Record(char phase, const char* type, const char* event, const void* instance);
+// Names the calling thread in the dump.
+void DSPTrace_NameThread(const char* name);
+
+// Writes every recorded event to `path`; false when tracing is compiled out or
+// the file cannot be written.
+bool DSPTrace_Dump(const char* path);
+// Forgets every recorded event.
+void DSPTrace_Clear();
+
+#ifdef POINT_DSP_TRACE
+
+// Emits a begin event now and the matching end event at the end of the scope.
+class DSPTraceScope
+{
+public:
+	DSPTraceScope(const char* type, const char* event, const void* instance)
+		: m_type(type), m_event(event), m_instance(instance)
+	{
+		DSPTrace_Record('B', type, event, instance);
+	}
+	~DSPTraceScope() { DSPTrace_Record('E', m_type, m_event, m_instance); }
+
+private:
+	const char* m_type;
+	const char* m_event;
+	const void* m_instance;
+};
+
+#define DSP_TRACE_JOIN_(a, b) a##b
+#define DSP_TRACE_JOIN(a, b) DSP_TRACE_JOIN_(a, b)
+#define DSP_TRACE_SCOPE(type, event, instance) \
+	DSPTraceScope DSP_TRACE_JOIN(dsp_trace_scope_, __LINE__)(type, event, instance)
+#define DSP_TRACE_THREAD(name) DSPTrace_NameThread(name)
+
+#else
+
+#define DSP_TRACE_SCOPE(type, event, instance) ((void)0)
+#define DSP_TRACE_THREAD(name) ((void)0)
+
+#endif // POINT_DSP_TRACE
+
+#endif // !__DSP_TRACE_H__
@@ -0,0 +1,289 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <thread>
+#include <mutex>
+
+#include "pch.h"
+#include "dsp_worker_pool.h"
+#include "dsp_trace.h"
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#elif !defined(_WIN32)
+#include <semaphore.h>
+#endif
+
+#pragma region DSPWorkerQueue
+
+void DSPWorkerQueue::clear()
+{
+	for (unsigned int i = 0; i < DSP_WORKER_QUEUE_CAPACITY; i++)
+	{
+		m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+	m_head.store(0, std::memory_order_relaxed);
+	m_tail.store(0, std::memory_order_release);
+}
+
+bool DSPWorkerQueue::push(const DSPWorkerJob& job)
+{
+	unsigned int pos = m_tail.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Cell& cell = m_cells[pos & (DSP_WORKER_QUEUE_CAPACITY - 1)];
+		int diff = (int)(cell.sequence.load(std::memory_order_acquire) - pos);
+		if (diff == 0) {
+			if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				cell.job = job;
+				cell.sequence.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (diff < 0) {
+			// full
+			return false;
+		}
+		else {
+			pos = m_tail.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+bool DSPWorkerQueue::pop(DSPWorkerJob* job)
+{
+	unsigned int pos = m_head.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Cell& cell = m_cells[pos & (DSP_WORKER_QUEUE_CAPACITY - 1)];
+		int diff = (int)(cell.sequence.load(std::memory_order_acquire) - (pos + 1));
+		if (diff == 0) {
+			if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+				*job = cell.job;
+				cell.sequence.store(pos + DSP_WORKER_QUEUE_CAPACITY, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (diff < 0) {
+			// empty
+			return false;
+		}
+		else {
+			pos = m_head.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region DSPWorkerPool
+
+namespace
+{
+	// Counting semaphore of the platform; posting never takes a lock.
+	class DSPWorkerSemaphore
+	{
+	public:
+#if defined(_WIN32)
+		DSPWorkerSemaphore() { m_handle = CreateSemaphoreW(NULL, 0, DSP_WORKER_MAX_THREADS, NULL); }
+		~DSPWorkerSemaphore() { CloseHandle(m_handle); }
+		void post() { ReleaseSemaphore(m_handle, 1, NULL); }
+		void wait() { WaitForSingleObject(m_handle, INFINITE); }
+	private:
+		HANDLE m_handle;
+#elif defined(__APPLE__)
+		DSPWorkerSemaphore() { m_handle = dispatch_semaphore_create(0); }
+		~DSPWorkerSemaphore() { dispatch_release(m_handle); }
+		void post() { dispatch_semaphore_signal(m_handle); }
+		void wait() { dispatch_semaphore_wait(m_handle, DISPATCH_TIME_FOREVER); }
+	private:
+		dispatch_semaphore_t m_handle;
+#else
+		DSPWorkerSemaphore() { sem_init(&m_handle, 0, 0); }
+		~DSPWorkerSemaphore() { sem_destroy(&m_handle); }
+		void post() { sem_post(&m_handle); }
+		void wait()
+		{
+			while (sem_wait(&m_handle) != 0)
+			{
+			}
+		}
+	private:
+		sem_t m_handle;
+#endif
+	};
+
+	struct Pool
+	{
+		// create/release side
+		std::mutex lifetime;
+		int users = 0;
+		std::thread threads[DSP_WORKER_MAX_THREADS];
+
+		// read by submit() without a lock
+		std::atomic<int> count{ 0 };
+		std::atomic<bool> running{ false };
+		std::atomic<unsigned int> next{ 0 };
+
+		// Sleeping workers wait on `wake`. Whoever takes one off `sleepers`
+		// owes it a post, or its own wait when it took itself off.
+		DSPWorkerSemaphore wake;
+		std::atomic<int> sleepers{ 0 };
+		std::atomic<unsigned int> pending{ 0 };
+
+		DSPWorkerQueue queues[DSP_WORKER_MAX_THREADS];
+	};
+
+	Pool s_pool;
+
+	// Takes one sleeper off the count; false when there was none.
+	bool DSPWorkerPool_Claim()
+	{
+		int sleepers = s_pool.sleepers.load();
+		while (0 < sleepers)
+		{
+			if (s_pool.sleepers.compare_exchange_weak(sleepers, sleepers - 1)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Own queue first, then the others starting at the neighbour.
+	bool DSPWorkerPool_Take(int index, int count, DSPWorkerJob* job)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (s_pool.queues[(index + i) % count].pop(job)) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void DSPWorkerPool_Main(int index)
+	{
+		DSP_TRACE_THREAD("Point DSP worker");
+		int count = s_pool.count.load(std::memory_order_acquire);
+		DSPWorkerJob job;
+		int idle = 0;
+
+		while (s_pool.running.load(std::memory_order_acquire))
+		{
+			if (DSPWorkerPool_Take(index, count, &job)) {
+				job.run(job.context);
+				idle = 0;
+				continue;
+			}
+			if (++idle < DSP_WORKER_SPIN_COUNT) {
+				std::this_thread::yield();
+				continue;
+			}
+
+			// A job pushed before `seen` is found by the last poll, one pushed
+			// after it changes pending. running, pending and sleepers stay
+			// sequentially consistent so that submit() or release() sees this
+			// worker, or the worker sees their change below.
+			unsigned int seen = s_pool.pending.load();
+			if (DSPWorkerPool_Take(index, count, &job)) {
+				job.run(job.context);
+				idle = 0;
+				continue;
+			}
+			s_pool.sleepers++;
+			if (s_pool.running.load() && s_pool.pending.load() == seen) {
+				s_pool.wake.wait();
+			}
+			else if (!DSPWorkerPool_Claim()) {
+				// a submit already took a sleeper off and posts for it
+				s_pool.wake.wait();
+			}
+			idle = 0;
+		}
+
+		// jobs still queued at shutdown belong to released instances; nothing to run
+	}
+}
+
+bool DSPWorkerPool::acquire()
+{
+	std::lock_guard<std::mutex> lock(s_pool.lifetime);
+	if (s_pool.users++ > 0) {
+		return true;
+	}
+
+	// leave a core to the mixer thread
+	int count = (int)std::thread::hardware_concurrency() - 1;
+	if (count < 1) count = 1;
+	if (count > DSP_WORKER_MAX_THREADS) count = DSP_WORKER_MAX_THREADS;
+
+	for (int i = 0; i < count; i++)
+	{
+		s_pool.queues[i].clear();
+	}
+	s_pool.count.store(count, std::memory_order_release);
+	s_pool.running.store(true, std::memory_order_release);
+	for (int i = 0; i < count; i++)
+	{
+		s_pool.threads[i] = std::thread(DSPWorkerPool_Main, i);
+	}
+	return true;
+}
+
+void DSPWorkerPool::release()
+{
+	std::lock_guard<std::mutex> lock(s_pool.lifetime);
+	if (--s_pool.users > 0) {
+		return;
+	}
+
+	s_pool.running.store(false);
+	while (DSPWorkerPool_Claim())
+	{
+		s_pool.wake.post();
+	}
+
+	int count = s_pool.count.load(std::memory_order_relaxed);
+	for (int i = 0; i < count; i++)
+	{
+		s_pool.threads[i].join();
+	}
+	s_pool.count.store(0, std::memory_order_release);
+}
+
+bool DSPWorkerPool::submit(const DSPWorkerJob& job)
+{
+	if (!s_pool.running.load(std::memory_order_acquire)) {
+		return false;
+	}
+
+	int count = s_pool.count.load(std::memory_order_acquire);
+	unsigned int first = s_pool.next.fetch_add(1, std::memory_order_relaxed);
+	for (int i = 0; i < count; i++)
+	{
+		if (s_pool.queues[(first + i) % count].push(job)) {
+			s_pool.pending++;
+			// Only a sleeping worker needs the syscall; no lock on this side.
+			if (DSPWorkerPool_Claim()) {
+				s_pool.wake.post();
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+#pragma endregion
@@ -0,0 +1,77 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+// dsp_worker_pool.h: worker threads that take plugin blocks off the mixer thread.
+// Every worker owns a bounded lock-free queue. The mixer thread deals jobs out
+// round robin and never waits; a worker runs its own queue first and steals
+// from the others once it is empty. The pool starts with the first acquire()
+// and joins its threads after the last release(), so nothing outlives the
+// plugin instances that use it (no threads joined during library unload).
+
+#pragma once
+
+#ifndef __DSP_WORKER_POOL_H__
+#define __DSP_WORKER_POOL_H__
+
+#include <atomic>
+
+// jobs one worker queue holds, power of two
+#define DSP_WORKER_QUEUE_CAPACITY 256
+// upper bound of the worker count
+#define DSP_WORKER_MAX_THREADS 16
+// empty polls a worker spins through before it sleeps
+#define DSP_WORKER_SPIN_COUNT 2048
+
+struct DSPWorkerJob
+{
+	void (*run)(void* context);
+	void* context;
+};
+
+// Bounded multi-producer multi-consumer queue: one sequence number per cell
+// tells producers and consumers whether the cell is theirs to fill or empty.
+class DSPWorkerQueue
+{
+public:
+	void clear();
+	bool push(const DSPWorkerJob& job);
+	bool pop(DSPWorkerJob* job);
+
+private:
+	struct Cell
+	{
+		std::atomic<unsigned int> sequence;
+		DSPWorkerJob job;
+	};
+
+	alignas(64) std::atomic<unsigned int> m_head;
+	alignas(64) std::atomic<unsigned int> m_tail;
+	alignas(64) Cell m_cells[DSP_WORKER_QUEUE_CAPACITY];
+};
+
+namespace DSPWorkerPool
+{
+	// Starts the workers on first use; every successful acquire needs a release.
+	bool acquire();
+	void release();
+
+	// Queues `job` without blocking. False when the pool is not running or
+	// every queue is full; the caller then runs the job itself.
+	bool submit(const DSPWorkerJob& job);
+}
+
+#endif // !__DSP_WORKER_POOL_H__
@@ -14,341 +14,134 @@ This example shows how to create a simple gain DSP effect.
 #include <string.h>
 
 #include "pch.h"
+#include "dsp_plugin.h"
+#include "smoother.h"
+#include "dsp_dispatch.h"
 #include "fmod.hpp"
 
-#define FMOD_GAIN_USEPROCESSCALLBACK            /* FMOD plugins have 2 methods of processing data.  
-                                                    1. via a 'read' callback which is compatible with FMOD Ex but limited in functionality, or 
-                                                    2. via a 'process' callback which exposes more functionality, like masks and query before process early out logic. */
-
 //extern "C" {
 //    F_EXPORT FMOD_DSP_DESCRIPTION* F_CALL FMODGetDSPDescription();
 //}
 
-const float FMOD_GAIN_PARAM_GAIN_MIN     = -80.0f;
-const float FMOD_GAIN_PARAM_GAIN_MAX     = 10.0f;
-const float FMOD_GAIN_PARAM_GAIN_DEFAULT = 0.0f;
-#define FMOD_GAIN_RAMPCOUNT 256
-
-enum
-{
-    FMOD_GAIN_PARAM_GAIN = 0,
-    FMOD_GAIN_PARAM_INVERT,
-    FMOD_GAIN_NUM_PARAMETERS
-};
+constexpr float FMOD_GAIN_PARAM_GAIN_MIN     = -80.0f;
+constexpr float FMOD_GAIN_PARAM_GAIN_MAX     = 10.0f;
+constexpr float FMOD_GAIN_PARAM_GAIN_DEFAULT = 0.0f;
 
 #define DECIBELS_TO_LINEAR(__dbval__)  ((__dbval__ <= FMOD_GAIN_PARAM_GAIN_MIN) ? 0.0f : powf(10.0f, __dbval__ / 20.0f))
 #define LINEAR_TO_DECIBELS(__linval__) ((__linval__ <= 0.0f) ? FMOD_GAIN_PARAM_GAIN_MIN : 20.0f * log10f((float)__linval__))
 
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspcreate       (FMOD_DSP_STATE *dsp_state);
-FMOD_RESULT F_CALLBACK FMOD_Gain_dsprelease      (FMOD_DSP_STATE *dsp_state);
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspreset        (FMOD_DSP_STATE *dsp_state);
-#ifdef FMOD_GAIN_USEPROCESSCALLBACK
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspprocess      (FMOD_DSP_STATE *dsp_state, unsigned int length, const FMOD_DSP_BUFFER_ARRAY *inbufferarray, FMOD_DSP_BUFFER_ARRAY *outbufferarray, FMOD_BOOL inputsidle, FMOD_DSP_PROCESS_OPERATION op);
-#else
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspread         (FMOD_DSP_STATE *dsp_state, float *inbuffer, float *outbuffer, unsigned int length, int inchannels, int *outchannels);
-#endif
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspsetparamfloat(FMOD_DSP_STATE *dsp_state, int index, float value);
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspsetparamint  (FMOD_DSP_STATE *dsp_state, int index, int value);
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspsetparambool (FMOD_DSP_STATE *dsp_state, int index, FMOD_BOOL value);
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspsetparamdata (FMOD_DSP_STATE *dsp_state, int index, void *data, unsigned int length);
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspgetparamfloat(FMOD_DSP_STATE *dsp_state, int index, float *value, char *valuestr);
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspgetparamint  (FMOD_DSP_STATE *dsp_state, int index, int *value, char *valuestr);
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspgetparambool (FMOD_DSP_STATE *dsp_state, int index, FMOD_BOOL *value, char *valuestr);
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspgetparamdata (FMOD_DSP_STATE *dsp_state, int index, void **value, unsigned int *length, char *valuestr);
-FMOD_RESULT F_CALLBACK FMOD_Gain_shouldiprocess  (FMOD_DSP_STATE *dsp_state, FMOD_BOOL inputsidle, unsigned int length, FMOD_CHANNELMASK inmask, int inchannels, FMOD_SPEAKERMODE speakermode);
 FMOD_RESULT F_CALLBACK FMOD_Gain_sys_register    (FMOD_DSP_STATE *dsp_state);
 FMOD_RESULT F_CALLBACK FMOD_Gain_sys_deregister  (FMOD_DSP_STATE *dsp_state);
 FMOD_RESULT F_CALLBACK FMOD_Gain_sys_mix         (FMOD_DSP_STATE *dsp_state, int stage);
 
-static bool                    FMOD_Gain_Running = false;
-static FMOD_DSP_PARAMETER_DESC p_gain;
-static FMOD_DSP_PARAMETER_DESC p_invert;
-    
-FMOD_DSP_PARAMETER_DESC *FMOD_Gain_dspparam[FMOD_GAIN_NUM_PARAMETERS] =
-{
-    &p_gain,
-    &p_invert
-};
+static bool FMOD_Gain_Running = false;
 
-FMOD_DSP_DESCRIPTION FMOD_Gain_Desc =
+static float FMOD_Gain_Mapping_Values[] = { -80, -50, -30, -10, 10 };
+static float FMOD_Gain_Mapping_Scale[]  = { 0, 2, 4, 7, 11 };
+const char* FMOD_Gain_Invert_Names[2]   = { "Off", "Inverted" };
+
+class FMODGainState : public DSPPlugin<FMODGainState>
 {
-    FMOD_PLUGIN_SDK_VERSION,
-    "FMOD Gain",    // name
-    0x00010000,     // plug-in version
-    1,              // number of input buffers to process
-    1,              // number of output buffers to process
-    FMOD_Gain_dspcreate,
-    FMOD_Gain_dsprelease,
-    FMOD_Gain_dspreset,
-#ifndef FMOD_GAIN_USEPROCESSCALLBACK
-    FMOD_Gain_dspread,
-#else
-    0,
-#endif
-#ifdef FMOD_GAIN_USEPROCESSCALLBACK
-    FMOD_Gain_dspprocess,
-#else
-    0,
-#endif
-    0,
-    FMOD_GAIN_NUM_PARAMETERS,
-    FMOD_Gain_dspparam,
-    FMOD_Gain_dspsetparamfloat,
-    0, // FMOD_Gain_dspsetparamint,
-    FMOD_Gain_dspsetparambool,
-    0, // FMOD_Gain_dspsetparamdata,
-    FMOD_Gain_dspgetparamfloat,
-    0, // FMOD_Gain_dspgetparamint,
-    FMOD_Gain_dspgetparambool,
-    0, // FMOD_Gain_dspgetparamdata,
-    FMOD_Gain_shouldiprocess,
-    0,                                      // userdata
-    FMOD_Gain_sys_register,
-    FMOD_Gain_sys_deregister,
-    FMOD_Gain_sys_mix
+public:
+    static constexpr DSPPluginInfo Info = { "FMOD Gain", 0x00010000, 1, 1, 0 };
+
+    void init(FMOD_DSP_STATE *dsp_state);
+
+    void read(float *inbuffer, float *outbuffer, unsigned int length, int channels);
+    void reset();
+    void setGain(float);
+    void setInvert(bool);
+    float gain() const { return LINEAR_TO_DECIBELS(m_invert ? -m_gain.target() : m_gain.target()); }
+    FMOD_BOOL invert() const { return m_invert; }
+
+    void perform(unsigned int length, const FMOD_DSP_BUFFER_ARRAY *inbufferarray, FMOD_DSP_BUFFER_ARRAY *outbufferarray);
+    void skip(unsigned int length) { m_gain.skip(length); }
+    static void describe(FMOD_DSP_DESCRIPTION *desc);
+
+    static constexpr DSPParameter<FMODGainState> Parameters[] =
+    {
+        DSPParameter_Mapped<FMODGainState>("Gain", "dB", "Gain in dB. -80 to 10. Default = 0", FMOD_GAIN_PARAM_GAIN_DEFAULT, FMOD_Gain_Mapping_Values, FMOD_Gain_Mapping_Scale, 5, &FMODGainState::setGain),
+        DSPParameter_Bool<FMODGainState>("Invert", "", "Invert signal. Default = off", false, FMOD_Gain_Invert_Names, &FMODGainState::setInvert),
+    };
+
+private:
+    Smoother<SmoothLinear> m_gain;
+    bool  m_invert;
 };
+
+constexpr DSPPluginInfo FMODGainState::Info;
+constexpr DSPParameter<FMODGainState> FMODGainState::Parameters[];
+
 //
 //extern "C"
 //{
 //
 //F_EXPORT FMOD_DSP_DESCRIPTION* F_CALL FMODGetDSPDescription()
 //{
-//	static float gain_mapping_values[] = { -80, -50, -30, -10, 10 };
-//	static float gain_mapping_scale[] = { 0, 2, 4, 7, 11 };
-//
-//    FMOD_DSP_INIT_PARAMDESC_FLOAT_WITH_MAPPING(p_gain, "Gain", "dB", "Gain in dB. -80 to 10. Default = 0", FMOD_GAIN_PARAM_GAIN_DEFAULT, gain_mapping_values, gain_mapping_scale);
-//    FMOD_DSP_INIT_PARAMDESC_BOOL(p_invert, "Invert", "", "Invert signal. Default = off", false, 0);
-//    return &FMOD_Gain_Desc;
+//    return FMODGainState::description();
 //}
 //
 //}
 
 FMOD_DSP_DESCRIPTION* FMOD_TEST_GAIN_GetDSPDescription()
 {
-    static float gain_mapping_values[] = { -80, -50, -30, -10, 10 };
-    static float gain_mapping_scale[] = { 0, 2, 4, 7, 11 };
-
-    FMOD_DSP_INIT_PARAMDESC_FLOAT_WITH_MAPPING(p_gain, "Gain", "dB", "Gain in dB. -80 to 10. Default = 0", FMOD_GAIN_PARAM_GAIN_DEFAULT, gain_mapping_values, gain_mapping_scale);
-    FMOD_DSP_INIT_PARAMDESC_BOOL(p_invert, "Invert", "", "Invert signal. Default = off", false, 0);
-    return &FMOD_Gain_Desc;
+    return FMODGainState::description();
 }
 
-class FMODGainState
+void FMODGainState::init(FMOD_DSP_STATE *dsp_state)
 {
-public:
-    FMODGainState();
-
-    void read(float *inbuffer, float *outbuffer, unsigned int length, int channels);
-    void reset();
-    void setGain(float);
-    void setInvert(bool);
-    float gain() const { return LINEAR_TO_DECIBELS(m_invert ? -m_target_gain : m_target_gain); }
-    FMOD_BOOL invert() const { return m_invert; }
+    int samplerate;
+    FMOD_DSP_GETSAMPLERATE(dsp_state, &samplerate);
 
-private:
-    float m_target_gain;
-    float m_current_gain;
-    int   m_ramp_samples_left;
-    bool  m_invert;
-};
-
-FMODGainState::FMODGainState()
-{
-    m_target_gain = DECIBELS_TO_LINEAR(FMOD_GAIN_PARAM_GAIN_DEFAULT);
+    m_gain.init(DECIBELS_TO_LINEAR(FMOD_GAIN_PARAM_GAIN_DEFAULT), POINT_GAIN_RAMP_MS, samplerate);
     m_invert = 0;
-    reset();
 }
 
 void FMODGainState::read(float *inbuffer, float *outbuffer, unsigned int length, int channels)
 {
     // Note: buffers are interleaved
-    float gain = m_current_gain;
-
-    if (m_ramp_samples_left)
+    unsigned int ramp = m_gain.pending(length);
+    if (ramp)
     {
-        float target = m_target_gain;
-        float delta = (target - gain) / m_ramp_samples_left;
-        while (length)
-        {
-            if (--m_ramp_samples_left)
-            {
-                gain += delta;
-                for (int i = 0; i < channels; ++i)
-                {
-                    *outbuffer++ = *inbuffer++ * gain;
-                }
-            }
-            else
-            {
-                gain = target;
-                break;
-            }
-            --length;
-        }
+        float curve[SMOOTHER_MAX_RAMP];
+        m_gain.fill(curve, ramp);
+        DSPKernels().gainCurve(inbuffer, outbuffer, ramp, channels, curve);
     }
 
-    unsigned int samples = length * channels;
-    while (samples--)
-    {
-        *outbuffer++ = *inbuffer++ * gain;
-    }
-
-    m_current_gain = gain;
+    DSPKernels().gain(inbuffer + ramp * channels, outbuffer + ramp * channels, (length - ramp) * channels, m_gain.value());
 }
 
 void FMODGainState::reset()
 {
-    m_current_gain = m_target_gain;
-    m_ramp_samples_left = 0;
+    m_gain.snap();
 }
 
 void FMODGainState::setGain(float gain)
 {
-    m_target_gain = m_invert ? -DECIBELS_TO_LINEAR(gain) : DECIBELS_TO_LINEAR(gain);
-    m_ramp_samples_left = FMOD_GAIN_RAMPCOUNT;
+    m_gain.setTarget(m_invert ? -DECIBELS_TO_LINEAR(gain) : DECIBELS_TO_LINEAR(gain));
 }
 
 void FMODGainState::setInvert(bool invert)
 {
     if (invert != m_invert)
     {
-        m_target_gain = -m_target_gain;
-        m_ramp_samples_left = FMOD_GAIN_RAMPCOUNT;
+        m_gain.setTarget(-m_gain.target());
     }
     m_invert = invert;
 }
 
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspcreate(FMOD_DSP_STATE *dsp_state)
+void FMODGainState::perform(unsigned int length, const FMOD_DSP_BUFFER_ARRAY *inbufferarray, FMOD_DSP_BUFFER_ARRAY *outbufferarray)
 {
-    dsp_state->plugindata = (FMODGainState *)FMOD_DSP_ALLOC(dsp_state, sizeof(FMODGainState));
-    if (!dsp_state->plugindata)
-    {
-        return FMOD_ERR_MEMORY;
-    }
-    return FMOD_OK;
+    read(inbufferarray[0].buffers[0], outbufferarray[0].buffers[0], length, inbufferarray[0].buffernumchannels[0]); // input and output channels count match for this effect
 }
 
-FMOD_RESULT F_CALLBACK FMOD_Gain_dsprelease(FMOD_DSP_STATE *dsp_state)
+void FMODGainState::describe(FMOD_DSP_DESCRIPTION *desc)
 {
-    FMODGainState *state = (FMODGainState *)dsp_state->plugindata;
-    FMOD_DSP_FREE(dsp_state, state);
-    return FMOD_OK;
+    desc->sys_register   = FMOD_Gain_sys_register;
+    desc->sys_deregister = FMOD_Gain_sys_deregister;
+    desc->sys_mix        = FMOD_Gain_sys_mix;
 }
 
-#ifdef FMOD_GAIN_USEPROCESSCALLBACK
-
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspprocess(FMOD_DSP_STATE *dsp_state, unsigned int length, const FMOD_DSP_BUFFER_ARRAY *inbufferarray, FMOD_DSP_BUFFER_ARRAY *outbufferarray, FMOD_BOOL inputsidle, FMOD_DSP_PROCESS_OPERATION op)
-{
-    FMODGainState *state = (FMODGainState *)dsp_state->plugindata;
-
-    if (op == FMOD_DSP_PROCESS_QUERY)
-    {
-        if (outbufferarray && inbufferarray)
-        {
-            outbufferarray[0].buffernumchannels[0] = inbufferarray[0].buffernumchannels[0];
-            outbufferarray[0].speakermode       = inbufferarray[0].speakermode;
-        }
-
-        if (inputsidle)
-        {
-            return FMOD_ERR_DSP_DONTPROCESS;
-        }
-    }
-    else
-    {
-        state->read(inbufferarray[0].buffers[0], outbufferarray[0].buffers[0], length, inbufferarray[0].buffernumchannels[0]); // input and output channels count match for this effect
-    }
-
-    return FMOD_OK;
-}
-
-#else
-
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspread(FMOD_DSP_STATE *dsp_state, float *inbuffer, float *outbuffer, unsigned int length, int inchannels, int * /*outchannels*/)
-{
-    FMODGainState *state = (FMODGainState *)dsp_state->plugindata;
-    state->read(inbuffer, outbuffer, length, inchannels); // input and output channels count match for this effect
-    return FMOD_OK;
-}
-
-#endif
-
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspreset(FMOD_DSP_STATE *dsp_state)
-{
-    FMODGainState *state = (FMODGainState *)dsp_state->plugindata;
-    state->reset();
-    return FMOD_OK;
-}
-
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspsetparamfloat(FMOD_DSP_STATE *dsp_state, int index, float value)
-{
-    FMODGainState *state = (FMODGainState *)dsp_state->plugindata;
-
-    switch (index)
-    {
-    case FMOD_GAIN_PARAM_GAIN:
-        state->setGain(value);
-        return FMOD_OK;
-    }
-
-    return FMOD_ERR_INVALID_PARAM;
-}
-
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspgetparamfloat(FMOD_DSP_STATE *dsp_state, int index, float *value, char *valuestr)
-{
-    FMODGainState *state = (FMODGainState *)dsp_state->plugindata;
-
-    switch (index)
-    {
-    case FMOD_GAIN_PARAM_GAIN:
-        *value = state->gain();
-        if (valuestr) sprintf(valuestr, "%.1f dB", state->gain());
-        return FMOD_OK;
-    }
-
-    return FMOD_ERR_INVALID_PARAM;
-}
-
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspsetparambool(FMOD_DSP_STATE *dsp_state, int index, FMOD_BOOL value)
-{
-    FMODGainState *state = (FMODGainState *)dsp_state->plugindata;
-
-    switch (index)
-    {
-      case FMOD_GAIN_PARAM_INVERT:
-        state->setInvert(value ? true : false);
-        return FMOD_OK;
-    }
-
-    return FMOD_ERR_INVALID_PARAM;
-}
-
-FMOD_RESULT F_CALLBACK FMOD_Gain_dspgetparambool(FMOD_DSP_STATE *dsp_state, int index, FMOD_BOOL *value, char *valuestr)
-{
-    FMODGainState *state = (FMODGainState *)dsp_state->plugindata;
-
-    switch (index)
-    {
-    case FMOD_GAIN_PARAM_INVERT:
-        *value = state->invert();
-        if (valuestr) sprintf(valuestr, state->invert() ? "Inverted" : "Off" );
-        return FMOD_OK;
-    }
-
-    return FMOD_ERR_INVALID_PARAM;
-}
-
-FMOD_RESULT F_CALLBACK FMOD_Gain_shouldiprocess(FMOD_DSP_STATE * /*dsp_state*/, FMOD_BOOL inputsidle, unsigned int /*length*/, FMOD_CHANNELMASK /*inmask*/, int /*inchannels*/, FMOD_SPEAKERMODE /*speakermode*/)
-{
-    if (inputsidle)
-    {
-        return FMOD_ERR_DSP_DONTPROCESS;
-    }
-
-    return FMOD_OK;
-}
-
-
 FMOD_RESULT F_CALLBACK FMOD_Gain_sys_register(FMOD_DSP_STATE * /*dsp_state*/)
 {
     FMOD_Gain_Running = true;
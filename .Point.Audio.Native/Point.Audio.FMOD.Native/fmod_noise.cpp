@@ -11,15 +11,12 @@ This example shows how to created a plugin effect.
 #include <string.h>
 
 #include "pch.h"
+#include "random.h"
+#include "dsp_plugin.h"
+#include "smoother.h"
+#include "dsp_dispatch.h"
 #include "fmod.hpp"
 
-enum
-{
-    FMOD_NOISE_PARAM_LEVEL = 0,
-    FMOD_NOISE_PARAM_FORMAT,
-    FMOD_NOISE_NUM_PARAMETERS
-};
-
 enum FMOD_NOISE_FORMAT
 {
     FMOD_NOISE_FORMAT_MONO = 0,
@@ -27,264 +24,136 @@ enum FMOD_NOISE_FORMAT
     FMOD_NOISE_FORMAT_5POINT1
 };
 
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspcreate       (FMOD_DSP_STATE *dsp);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dsprelease      (FMOD_DSP_STATE *dsp);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspreset        (FMOD_DSP_STATE *dsp);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspprocess      (FMOD_DSP_STATE *dsp, unsigned int length, const FMOD_DSP_BUFFER_ARRAY *inbufferarray, FMOD_DSP_BUFFER_ARRAY *outbufferarray, FMOD_BOOL inputsidle, FMOD_DSP_PROCESS_OPERATION op);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspsetparamfloat(FMOD_DSP_STATE *dsp, int index, float value);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspsetparamint  (FMOD_DSP_STATE *dsp, int index, int value);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspsetparambool (FMOD_DSP_STATE *dsp, int index, bool value);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspsetparamdata (FMOD_DSP_STATE *dsp, int index, void *data, unsigned int length);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspgetparamfloat(FMOD_DSP_STATE *dsp, int index, float *value, char *valuestr);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspgetparamint  (FMOD_DSP_STATE *dsp, int index, int *value, char *valuestr);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspgetparambool (FMOD_DSP_STATE *dsp, int index, bool *value, char *valuestr);
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspgetparamdata (FMOD_DSP_STATE *dsp, int index, void **value, unsigned int *length, char *valuestr);
-
-static FMOD_DSP_PARAMETER_DESC p_level;
-static FMOD_DSP_PARAMETER_DESC p_format;
-
-FMOD_DSP_PARAMETER_DESC *FMOD_Noise_dspparam[FMOD_NOISE_NUM_PARAMETERS] =
-{
-    &p_level,
-    &p_format
-};
-
 const char* FMOD_Noise_Format_Names[3] = {"Mono", "Stereo", "5.1"};
 
-FMOD_DSP_DESCRIPTION FMOD_Noise_Desc =
+class FMODNoiseState : public DSPPlugin<FMODNoiseState>
 {
-    FMOD_PLUGIN_SDK_VERSION,
-    "FMOD Noise",   // name
-    0x00010000,     // plug-in version
-    0,              // number of input buffers to process
-    1,              // number of output buffers to process
-    FMOD_Noise_dspcreate,
-    FMOD_Noise_dsprelease,
-    FMOD_Noise_dspreset,
-    0,
-    FMOD_Noise_dspprocess,
-    0,
-    FMOD_NOISE_NUM_PARAMETERS,
-    FMOD_Noise_dspparam,
-    FMOD_Noise_dspsetparamfloat,
-    FMOD_Noise_dspsetparamint,
-    0,
-    0,
-    FMOD_Noise_dspgetparamfloat,
-    FMOD_Noise_dspgetparamint,
-    0,
-    0,
-    0,
-    0,                                      // userdata
-    0,                                      // Register
-    0,                                      // Deregister
-    0                                       // Mix
+public:
+    static constexpr DSPPluginInfo Info = { "FMOD Noise", 0x00010000, 0, 1, 0 };
+
+    void init(FMOD_DSP_STATE *dsp);
+
+    void generate(float *outbuffer, unsigned int length, int channels);
+    void reset();
+    void setSeed(unsigned long long seed);
+    void setLevel(float);
+    void setFormat(int format) { m_format = (FMOD_NOISE_FORMAT)format; }
+    float level() const { return LINEAR_TO_DECIBELS(m_level.target()); }
+    FMOD_NOISE_FORMAT format() const { return m_format; }
+
+    // no input; the output layout follows the Format parameter, and the output
+    // is silent once the level has settled at -80 dB
+    FMOD_RESULT query(const FMOD_DSP_BUFFER_ARRAY *inbufferarray, FMOD_DSP_BUFFER_ARRAY *outbufferarray, FMOD_BOOL inputsidle);
+    void perform(unsigned int length, const FMOD_DSP_BUFFER_ARRAY *inbufferarray, FMOD_DSP_BUFFER_ARRAY *outbufferarray);
+
+    static constexpr DSPParameter<FMODNoiseState> Parameters[] =
+    {
+        DSPParameter_Float<FMODNoiseState>("Level", "dB", "Gain in dB. -80 to 10. Default = 0", GAIN_MIN, GAIN_MAX, 0, &FMODNoiseState::setLevel),
+        DSPParameter_Int<FMODNoiseState>("Format", "", "Mono, stereo or 5.1. Default = 0 (mono)", FMOD_NOISE_FORMAT_MONO, FMOD_NOISE_FORMAT_5POINT1, FMOD_NOISE_FORMAT_MONO, FMOD_Noise_Format_Names, &FMODNoiseState::setFormat),
+    };
+
+private:
+    Smoother<SmoothExponential> m_level;
+    FMOD_NOISE_FORMAT m_format;
+
+    unsigned long long m_seed;
+    Random m_random;
 };
 
+constexpr DSPPluginInfo FMODNoiseState::Info;
+constexpr DSPParameter<FMODNoiseState> FMODNoiseState::Parameters[];
+
 extern "C"
 {
 
 F_EXPORT FMOD_DSP_DESCRIPTION* F_CALL FMOD_Point_Noise_GetDSPDescription()
 {
-    FMOD_DSP_INIT_PARAMDESC_FLOAT(p_level, "Level", "dB", "Gain in dB. -80 to 10. Default = 0", GAIN_MIN, GAIN_MAX, 0);
-    FMOD_DSP_INIT_PARAMDESC_INT(p_format, "Format", "", "Mono, stereo or 5.1. Default = 0 (mono)", FMOD_NOISE_FORMAT_MONO, FMOD_NOISE_FORMAT_5POINT1, FMOD_NOISE_FORMAT_MONO, false, FMOD_Noise_Format_Names);
-    return &FMOD_Noise_Desc;
+    return FMODNoiseState::description();
 }
 
 }
 
-class FMODNoiseState
+void FMODNoiseState::init(FMOD_DSP_STATE *dsp)
 {
-public:
-    FMODNoiseState();
-
-    void generate(float *outbuffer, unsigned int length, int channels);
-    void reset();
-    void setLevel(float);
-    void setFormat(FMOD_NOISE_FORMAT format) { m_format = format; }
-    float level() const { return LINEAR_TO_DECIBELS(m_target_level); }
-    FMOD_NOISE_FORMAT format() const { return m_format; }
+    int samplerate;
+    FMOD_DSP_GETSAMPLERATE(dsp, &samplerate);
 
-private:
-    float m_target_level;
-    float m_current_level;
-    int m_ramp_samples_left;
-    FMOD_NOISE_FORMAT m_format;
-};
-
-FMODNoiseState::FMODNoiseState()
-{
-    m_target_level = DECIBELS_TO_LINEAR(0);
+    m_level.init(DECIBELS_TO_LINEAR(0), POINT_GAIN_RAMP_MS, samplerate);
     m_format = FMOD_NOISE_FORMAT_MONO;
+    setSeed(Random::nextSeed());
     reset();
 }
 
 void FMODNoiseState::generate(float *outbuffer, unsigned int length, int channels)
 {
     // Note: buffers are interleaved
-    float gain = m_current_level;
-
-    if (m_ramp_samples_left)
-    {
-        float target = m_target_level;
-        float delta = (target - gain) / m_ramp_samples_left;
-        while (length)
-        {
-            if (--m_ramp_samples_left)
-            {
-                gain += delta;
-                for (int i = 0; i < channels; ++i)
-                {
-                    *outbuffer++ = (((float)(rand()%32768) / 16384.0f) - 1.0f) * gain;
-                }
-            }
-            else
-            {
-                gain = target;
-                break;
-            }
-            --length;
-        }
-    }
+    m_random.fill(outbuffer, length * channels);
 
-    unsigned int samples = length * channels;
-    while (samples--)
+    unsigned int ramp = m_level.pending(length);
+    if (ramp)
     {
-        *outbuffer++ = (((float)(rand()%32768) / 16384.0f) - 1.0f) * gain;
+        float curve[SMOOTHER_MAX_RAMP];
+        m_level.fill(curve, ramp);
+        DSPKernels().gainCurve(outbuffer, outbuffer, ramp, channels, curve);
     }
 
-    m_current_level = gain;
+    DSPKernels().gain(outbuffer + ramp * channels, outbuffer + ramp * channels, (length - ramp) * channels, m_level.value());
 }
 
 void FMODNoiseState::reset()
 {
-    m_current_level = m_target_level;
-    m_ramp_samples_left = 0;
+    m_level.snap();
+    m_random.seed(m_seed);
 }
 
-void FMODNoiseState::setLevel(float level)
+void FMODNoiseState::setSeed(unsigned long long seed)
 {
-    m_target_level = DECIBELS_TO_LINEAR(level);
-    m_ramp_samples_left = FMOD_NOISE_RAMPCOUNT;
-}
-
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspcreate(FMOD_DSP_STATE *dsp)
-{
-    dsp->plugindata = (FMODNoiseState *)FMOD_DSP_ALLOC(dsp, sizeof(FMODNoiseState));
-    if (!dsp->plugindata)
-    {
-        return FMOD_ERR_MEMORY;
-    }
-    return FMOD_OK;
-}
-
-FMOD_RESULT F_CALLBACK FMOD_Noise_dsprelease(FMOD_DSP_STATE *dsp)
-{
-    FMODNoiseState *state = (FMODNoiseState *)dsp->plugindata;
-    FMOD_DSP_FREE(dsp, state);
-    return FMOD_OK;
-}
-
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspprocess(FMOD_DSP_STATE *dsp, unsigned int length, const FMOD_DSP_BUFFER_ARRAY * /*inbufferarray*/, FMOD_DSP_BUFFER_ARRAY *outbufferarray, FMOD_BOOL /*inputsidle*/, FMOD_DSP_PROCESS_OPERATION op)
-{
-    FMODNoiseState *state = (FMODNoiseState *)dsp->plugindata;
-
-    if (op == FMOD_DSP_PROCESS_QUERY)
-    {
-        FMOD_SPEAKERMODE outmode = FMOD_SPEAKERMODE_DEFAULT;
-        int outchannels = 0;
-
-        switch(state->format())
-        {
-        case FMOD_NOISE_FORMAT_MONO:
-            outmode = FMOD_SPEAKERMODE_MONO;
-            outchannels = 1;
-            break;
-
-        case FMOD_NOISE_FORMAT_STEREO:
-            outmode = FMOD_SPEAKERMODE_STEREO;
-            outchannels = 2;
-            break;
-
-        case FMOD_NOISE_FORMAT_5POINT1:
-            outmode = FMOD_SPEAKERMODE_5POINT1;
-            outchannels = 6;
-        }
-
-        if (outbufferarray)
-        {
-            outbufferarray->speakermode = outmode;
-            outbufferarray->buffernumchannels[0] = outchannels;
-        }
-        
-        return FMOD_OK;
-    }
-
-    state->generate(outbufferarray->buffers[0], length, outbufferarray->buffernumchannels[0]);
-    return FMOD_OK;
+    m_seed = seed;
+    m_random.seed(seed);
 }
 
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspreset(FMOD_DSP_STATE *dsp)
+void FMODNoiseState::setLevel(float level)
 {
-    FMODNoiseState *state = (FMODNoiseState *)dsp->plugindata;
-    state->reset();
-    return FMOD_OK;
+    m_level.setTarget(DECIBELS_TO_LINEAR(level));
 }
 
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspsetparamfloat(FMOD_DSP_STATE *dsp, int index, float value)
+FMOD_RESULT FMODNoiseState::query(const FMOD_DSP_BUFFER_ARRAY * /*inbufferarray*/, FMOD_DSP_BUFFER_ARRAY *outbufferarray, FMOD_BOOL /*inputsidle*/)
 {
-    FMODNoiseState *state = (FMODNoiseState *)dsp->plugindata;
+    FMOD_SPEAKERMODE outmode = FMOD_SPEAKERMODE_DEFAULT;
+    int outchannels = 0;
 
-    switch (index)
+    switch(m_format)
     {
-    case FMOD_NOISE_PARAM_LEVEL:
-        state->setLevel(value);
-        return FMOD_OK;
+    case FMOD_NOISE_FORMAT_MONO:
+        outmode = FMOD_SPEAKERMODE_MONO;
+        outchannels = 1;
+        break;
+
+    case FMOD_NOISE_FORMAT_STEREO:
+        outmode = FMOD_SPEAKERMODE_STEREO;
+        outchannels = 2;
+        break;
+
+    case FMOD_NOISE_FORMAT_5POINT1:
+        outmode = FMOD_SPEAKERMODE_5POINT1;
+        outchannels = 6;
     }
 
-    return FMOD_ERR_INVALID_PARAM;
-}
-
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspgetparamfloat(FMOD_DSP_STATE *dsp, int index, float *value, char *valuestr)
-{
-    FMODNoiseState *state = (FMODNoiseState *)dsp->plugindata;
-
-    switch (index)
+    if (outbufferarray)
     {
-    case FMOD_NOISE_PARAM_LEVEL:
-        *value = state->level();
-        if (valuestr) sprintf(valuestr, "%.1f dB", state->level());
-        return FMOD_OK;
+        outbufferarray->speakermode = outmode;
+        outbufferarray->buffernumchannels[0] = outchannels;
     }
 
-    return FMOD_ERR_INVALID_PARAM;
-}
-
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspsetparamint(FMOD_DSP_STATE *dsp, int index, int value)
-{
-    FMODNoiseState *state = (FMODNoiseState *)dsp->plugindata;
-
-    switch (index)
+    if (m_level.target() == 0 && m_level.value() == 0)
     {
-    case FMOD_NOISE_PARAM_FORMAT:
-        state->setFormat((FMOD_NOISE_FORMAT)value);
-        return FMOD_OK;
+        return FMOD_ERR_DSP_SILENCE;
     }
 
-    return FMOD_ERR_INVALID_PARAM;
+    return FMOD_OK;
 }
 
-FMOD_RESULT F_CALLBACK FMOD_Noise_dspgetparamint(FMOD_DSP_STATE *dsp, int index, int *value, char *valuestr)
+void FMODNoiseState::perform(unsigned int length, const FMOD_DSP_BUFFER_ARRAY * /*inbufferarray*/, FMOD_DSP_BUFFER_ARRAY *outbufferarray)
 {
-    FMODNoiseState *state = (FMODNoiseState *)dsp->plugindata;
-
-    switch (index)
-    {
-    case FMOD_NOISE_PARAM_FORMAT:
-        *value = state->format();
-        if (valuestr) sprintf(valuestr, "%s", FMOD_Noise_Format_Names[state->format()]);
-        return FMOD_OK;
-    }
-
-    return FMOD_ERR_INVALID_PARAM;
+    generate(outbufferarray->buffers[0], length, outbufferarray->buffernumchannels[0]);
 }
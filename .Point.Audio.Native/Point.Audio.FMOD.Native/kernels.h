@@ -0,0 +1,369 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// kernels.h: block kernels shared by the Point plugins.
+// They work on contiguous float arrays; Kernel_Deinterleave and
+// Kernel_Interleave move FMOD's interleaved buffers in and out of those.
+//
+// The plugins do not include this header; they call the kernels through
+// DSPKernels() (dsp_dispatch.h), which points at a copy of them built for the
+// host CPU. It therefore depends on nothing but simd.h and the C library.
+
+#pragma once
+
+#ifndef __KERNELS_H__
+#define __KERNELS_H__
+
+#include <string.h>
+
+#include "simd.h"
+
+// out[k] = (wet[k] * mix + dry[k] * (1 - mix)) * gain, MIX() of pch.h
+static inline void Kernel_MixSteady(const float* wet, const float* dry, float* out, unsigned int count, float mix, float gain)
+{
+	vfloat vwet = simd_set1(mix * gain);
+	vfloat vdry = simd_set1((1 - mix) * gain);
+
+	unsigned int i = 0;
+	for (; i + POINT_SIMD_WIDTH <= count; i += POINT_SIMD_WIDTH)
+	{
+		simd_store(out + i, simd_madd(simd_load(wet + i), vwet, simd_mul(simd_load(dry + i), vdry)));
+	}
+	for (; i < count; i++)
+	{
+		out[i] = (wet[i] * mix + dry[i] * (1 - mix)) * gain;
+	}
+}
+// out[k] = (wet[k] * mix[k] + dry[k] * (1 - mix[k])) * gain[k]
+static inline void Kernel_MixCurve(const float* wet, const float* dry, float* out, unsigned int count, const float* mix, const float* gain)
+{
+	unsigned int i = 0;
+	for (; i + POINT_SIMD_WIDTH <= count; i += POINT_SIMD_WIDTH)
+	{
+		vfloat vdry = simd_load(dry + i);
+		vfloat vmix = simd_load(mix + i);
+		vfloat mixed = simd_madd(simd_sub(simd_load(wet + i), vdry), vmix, vdry);
+		simd_store(out + i, simd_mul(mixed, simd_load(gain + i)));
+	}
+	for (; i < count; i++)
+	{
+		out[i] = (wet[i] * mix[i] + dry[i] * (1 - mix[i])) * gain[i];
+	}
+}
+
+// out[k] = in[k] * gain
+static inline void Kernel_Gain(const float* in, float* out, unsigned int count, float gain)
+{
+	vfloat vgain = simd_set1(gain);
+
+	unsigned int i = 0;
+	for (; i + POINT_SIMD_WIDTH <= count; i += POINT_SIMD_WIDTH)
+	{
+		simd_store(out + i, simd_mul(simd_load(in + i), vgain));
+	}
+	for (; i < count; i++)
+	{
+		out[i] = in[i] * gain;
+	}
+}
+// out[f * channels + c] = in[f * channels + c] * gain[f], interleaved
+static inline void Kernel_GainCurve(const float* in, float* out, unsigned int frames, int channels, const float* gain)
+{
+	for (unsigned int f = 0; f < frames; f++)
+	{
+		float g = gain[f];
+		for (int c = 0; c < channels; c++)
+		{
+			out[f * channels + c] = in[f * channels + c] * g;
+		}
+	}
+}
+
+// sum of a[k] * b[k]; two accumulators so consecutive products do not wait on each other
+static inline float Kernel_Dot(const float* a, const float* b, unsigned int count)
+{
+	vfloat acc0 = simd_set1(0);
+	vfloat acc1 = simd_set1(0);
+
+	unsigned int i = 0;
+	for (; i + 2 * POINT_SIMD_WIDTH <= count; i += 2 * POINT_SIMD_WIDTH)
+	{
+		acc0 = simd_madd(simd_load(a + i), simd_load(b + i), acc0);
+		acc1 = simd_madd(simd_load(a + i + POINT_SIMD_WIDTH), simd_load(b + i + POINT_SIMD_WIDTH), acc1);
+	}
+	for (; i + POINT_SIMD_WIDTH <= count; i += POINT_SIMD_WIDTH)
+	{
+		acc0 = simd_madd(simd_load(a + i), simd_load(b + i), acc0);
+	}
+	float sum = simd_hsum(simd_add(acc0, acc1));
+	for (; i < count; i++)
+	{
+		sum += a[i] * b[i];
+	}
+	return sum;
+}
+
+// Polyphase FIR over history: each output is the dot product of the `taps`
+// samples from *index with row *phase of rows, after which *index moves on by
+// step and *phase by rest, carrying into *index at den. Stops after `count`
+// outputs or when the next window would reach past fill; returns the outputs.
+static inline unsigned int Kernel_Polyphase(const float* history, unsigned int fill, const float* rows, unsigned int taps,
+	unsigned int step, unsigned int rest, unsigned int den, unsigned int* index, unsigned int* phase, float* output, unsigned int count)
+{
+	unsigned int i = *index;
+	unsigned int p = *phase;
+	unsigned int n = 0;
+	while (n < count && i + taps <= fill)
+	{
+		output[n++] = Kernel_Dot(history + i, rows + p * taps, taps);
+		i += step;
+		p += rest;
+		if (p >= den) {
+			p -= den;
+			i++;
+		}
+	}
+	*index = i;
+	*phase = p;
+	return n;
+}
+
+// True when no |in[k]| exceeds threshold. Returns at the first louder group
+// of vectors, so a signal that is not silent costs a few loads.
+static inline bool Kernel_IsSilent(const float* in, unsigned int count, float threshold)
+{
+	vfloat vthreshold = simd_set1(threshold);
+
+	unsigned int i = 0;
+	for (; i + 4 * POINT_SIMD_WIDTH <= count; i += 4 * POINT_SIMD_WIDTH)
+	{
+		vfloat a = simd_max(simd_abs(simd_load(in + i)), simd_abs(simd_load(in + i + POINT_SIMD_WIDTH)));
+		vfloat b = simd_max(simd_abs(simd_load(in + i + 2 * POINT_SIMD_WIDTH)), simd_abs(simd_load(in + i + 3 * POINT_SIMD_WIDTH)));
+		if (simd_anygt(simd_max(a, b), vthreshold)) {
+			return false;
+		}
+	}
+	for (; i < count; i++)
+	{
+		if (threshold < in[i] || in[i] < -threshold) {
+			return false;
+		}
+	}
+	return true;
+}
+
+#pragma region Lanes
+
+// Kernels over the lane-major tiles of a batch pass (dsp_batch.h): sample f of
+// lane l at [f * stride + l], a lane being one channel of one instance. `lanes`
+// is a multiple of POINT_SIMD_WIDTH; the per-lane arrays hold `lanes` values.
+
+// out = wet * wetGain + dry * dryGain per lane, the sum Kernel_MixSteady forms
+// with wetGain = mix * gain and dryGain = (1 - mix) * gain
+static inline void Kernel_MixLanes(const float* wet, const float* dry, float* out, unsigned int frames,
+	unsigned int lanes, unsigned int stride, const float* wetGain, const float* dryGain)
+{
+	for (unsigned int l = 0; l < lanes; l += POINT_SIMD_WIDTH)
+	{
+		vfloat vwet = simd_load(wetGain + l);
+		vfloat vdry = simd_load(dryGain + l);
+		for (unsigned int f = 0, i = l; f < frames; f++, i += stride)
+		{
+			simd_store(out + i, simd_madd(simd_load(wet + i), vwet, simd_mul(simd_load(dry + i), vdry)));
+		}
+	}
+}
+// Sample-and-hold with noise, then Kernel_MixLanes against the input. A lane
+// whose gate is set at a frame takes clamp(in + in * noise * amplitude, -1, 1)
+// there, as the Downsampler's held values do, and keeps it while the gate is
+// clear; held[] carries the value in and out of the tile.
+static inline void Kernel_HoldLanes(const float* in, const float* noise, const unsigned int* gate, float* out, unsigned int frames,
+	unsigned int lanes, unsigned int stride, float* held, const float* amplitude, const float* wetGain, const float* dryGain)
+{
+	vfloat lo = simd_set1(-1.0f);
+	vfloat hi = simd_set1(1.0f);
+
+	for (unsigned int l = 0; l < lanes; l += POINT_SIMD_WIDTH)
+	{
+		vfloat value = simd_load(held + l);
+		vfloat vamplitude = simd_load(amplitude + l);
+		vfloat vwet = simd_load(wetGain + l);
+		vfloat vdry = simd_load(dryGain + l);
+		for (unsigned int f = 0, i = l; f < frames; f++, i += stride)
+		{
+			vfloat element = simd_load(in + i);
+			vfloat processed = simd_madd(simd_mul(element, simd_load(noise + i)), vamplitude, element);
+			value = simd_select(simd_loadu32(gate + i), simd_max(lo, simd_min(hi, processed)), value);
+			simd_store(out + i, simd_madd(value, vwet, simd_mul(element, vdry)));
+		}
+		simd_store(held + l, value);
+	}
+}
+
+#pragma endregion
+
+#pragma region Interleave
+
+// planes[c][f .. f + 3] = in[(f .. f + 3) * stride + c] for c < 4; `in` points at frame f
+static inline void Kernel_Deinterleave4x4(const float* in, int stride, float* const* planes, unsigned int f)
+{
+	vfloat4 r0 = simd4_load(in);
+	vfloat4 r1 = simd4_load(in + stride);
+	vfloat4 r2 = simd4_load(in + 2 * stride);
+	vfloat4 r3 = simd4_load(in + 3 * stride);
+	simd4_transpose(r0, r1, r2, r3);
+	simd4_store(planes[0] + f, r0);
+	simd4_store(planes[1] + f, r1);
+	simd4_store(planes[2] + f, r2);
+	simd4_store(planes[3] + f, r3);
+}
+// out[(f .. f + 3) * stride + c] = planes[c][f .. f + 3] for c < 4; `out` points at frame f
+static inline void Kernel_Interleave4x4(const float* const* planes, unsigned int f, float* out, int stride)
+{
+	vfloat4 r0 = simd4_load(planes[0] + f);
+	vfloat4 r1 = simd4_load(planes[1] + f);
+	vfloat4 r2 = simd4_load(planes[2] + f);
+	vfloat4 r3 = simd4_load(planes[3] + f);
+	simd4_transpose(r0, r1, r2, r3);
+	simd4_store(out, r0);
+	simd4_store(out + stride, r1);
+	simd4_store(out + 2 * stride, r2);
+	simd4_store(out + 3 * stride, r3);
+}
+
+// planes[c][k] = in[k * channels + c] for frames from..frames-1
+static inline void Kernel_DeinterleaveScalar(const float* in, float* const* planes, unsigned int from, unsigned int frames, int channels)
+{
+	for (unsigned int f = from; f < frames; f++)
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			planes[c][f] = in[f * channels + c];
+		}
+	}
+}
+// out[k * channels + c] = planes[c][k] for frames from..frames-1
+static inline void Kernel_InterleaveScalar(const float* const* planes, float* out, unsigned int from, unsigned int frames, int channels)
+{
+	for (unsigned int f = from; f < frames; f++)
+	{
+		for (int c = 0; c < channels; c++)
+		{
+			out[f * channels + c] = planes[c][f];
+		}
+	}
+}
+
+// planes[c][k] = in[k * channels + c]. Mono, stereo, quad, 5.1 and 7.1 move
+// four frames per step through register shuffles; other layouts go one by one.
+static inline void Kernel_Deinterleave(const float* in, float* const* planes, unsigned int frames, int channels)
+{
+	unsigned int f = 0;
+	switch (channels)
+	{
+	case 1:
+		memcpy(planes[0], in, sizeof(float) * frames);
+		return;
+	case 2:
+		for (; f + 4 <= frames; f += 4)
+		{
+			vfloat4 a = simd4_load(in + f * 2);
+			vfloat4 b = simd4_load(in + f * 2 + 4);
+			simd4_store(planes[0] + f, simd4_even(a, b));
+			simd4_store(planes[1] + f, simd4_odd(a, b));
+		}
+		break;
+	case 4:
+		for (; f + 4 <= frames; f += 4)
+		{
+			Kernel_Deinterleave4x4(in + f * 4, 4, planes, f);
+		}
+		break;
+	case 6:
+		for (; f + 4 <= frames; f += 4)
+		{
+			const float* frame = in + f * 6;
+			Kernel_Deinterleave4x4(frame, 6, planes, f);
+			// channels 4 and 5 sit in pairs at the end of each frame
+			vfloat4 a = simd4_loadpairs(frame + 4, frame + 10);
+			vfloat4 b = simd4_loadpairs(frame + 16, frame + 22);
+			simd4_store(planes[4] + f, simd4_even(a, b));
+			simd4_store(planes[5] + f, simd4_odd(a, b));
+		}
+		break;
+	case 8:
+		for (; f + 4 <= frames; f += 4)
+		{
+			Kernel_Deinterleave4x4(in + f * 8, 8, planes, f);
+			Kernel_Deinterleave4x4(in + f * 8 + 4, 8, planes + 4, f);
+		}
+		break;
+	default:
+		break;
+	}
+	Kernel_DeinterleaveScalar(in, planes, f, frames, channels);
+}
+// out[k * channels + c] = planes[c][k], the inverse of Kernel_Deinterleave.
+static inline void Kernel_Interleave(const float* const* planes, float* out, unsigned int frames, int channels)
+{
+	unsigned int f = 0;
+	switch (channels)
+	{
+	case 1:
+		memcpy(out, planes[0], sizeof(float) * frames);
+		return;
+	case 2:
+		for (; f + 4 <= frames; f += 4)
+		{
+			vfloat4 l = simd4_load(planes[0] + f);
+			vfloat4 r = simd4_load(planes[1] + f);
+			simd4_store(out + f * 2, simd4_ziplo(l, r));
+			simd4_store(out + f * 2 + 4, simd4_ziphi(l, r));
+		}
+		break;
+	case 4:
+		for (; f + 4 <= frames; f += 4)
+		{
+			Kernel_Interleave4x4(planes, f, out + f * 4, 4);
+		}
+		break;
+	case 6:
+		for (; f + 4 <= frames; f += 4)
+		{
+			float* frame = out + f * 6;
+			Kernel_Interleave4x4(planes, f, frame, 6);
+			vfloat4 c4 = simd4_load(planes[4] + f);
+			vfloat4 c5 = simd4_load(planes[5] + f);
+			simd4_storepairs(frame + 4, frame + 10, simd4_ziplo(c4, c5));
+			simd4_storepairs(frame + 16, frame + 22, simd4_ziphi(c4, c5));
+		}
+		break;
+	case 8:
+		for (; f + 4 <= frames; f += 4)
+		{
+			Kernel_Interleave4x4(planes, f, out + f * 8, 8);
+			Kernel_Interleave4x4(planes + 4, f, out + f * 8 + 4, 8);
+		}
+		break;
+	default:
+		break;
+	}
+	Kernel_InterleaveScalar(planes, out, f, frames, channels);
+}
+
+#pragma endregion
+
+#endif // !__KERNELS_H__
@@ -0,0 +1,30 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// kernels_avx512.cpp: kernels.h for AVX-512F, see dsp_dispatch.h.
+// Built without the precompiled header and, where the compiler needs it, with
+// its own target flags; keep it free of anything but kernels.h.
+
+#include "dsp_dispatch.h"
+
+#if defined(DSP_DISPATCH_X86)
+
+#define POINT_SIMD_AVX512
+#include "kernels.h"
+
+DSP_KERNEL_TABLE(DSPKernels_AVX512, DSP_ISA_AVX512, "avx512");
+
+#endif // DSP_DISPATCH_X86
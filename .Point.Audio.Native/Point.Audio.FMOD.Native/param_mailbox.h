@@ -0,0 +1,108 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// param_mailbox.h: hands parameter changes from the setparam callbacks to the
+// mixer thread without locks.
+// Every parameter owns one slot holding its latest value and one bit in a dirty
+// mask. Posting stores the value and sets the bit; the process callback drains
+// the mask once at block start and applies each changed parameter, so updates
+// land on block boundaries and repeated posts within a block collapse into one.
+// Posting never blocks and never fails. It assumes one posting thread, which is
+// how FMOD calls setparam, but several would only race on which value wins.
+
+#pragma once
+
+#ifndef __PARAM_MAILBOX_H__
+#define __PARAM_MAILBOX_H__
+
+#include <string.h>
+#include <atomic>
+
+// parameters per plugin, one bit of the dirty mask each
+#define PARAM_MAILBOX_CAPACITY 32
+
+class ParamMailbox
+{
+public:
+	// Forgets every value and pending change. Call before first use; there is
+	// no constructor, and a recycled plugin state still holds the values of the
+	// instance released before it (see DSPWarmPool).
+	void clear()
+	{
+		for (int i = 0; i < PARAM_MAILBOX_CAPACITY; i++)
+		{
+			m_values[i].store(0, std::memory_order_relaxed);
+		}
+		m_dirty.store(0, std::memory_order_release);
+	}
+
+	void postFloat(int index, float value)
+	{
+		unsigned int bits;
+		memcpy(&bits, &value, sizeof(bits));
+		post(index, bits);
+	}
+	void postInt(int index, int value)
+	{
+		post(index, (unsigned int)value);
+	}
+
+	// latest posted value, whether or not it was applied yet
+	float getFloat(int index) const
+	{
+		unsigned int bits = m_values[index].load(std::memory_order_relaxed);
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+	int getInt(int index) const
+	{
+		return (int)m_values[index].load(std::memory_order_relaxed);
+	}
+
+	// Calls apply(index) for every parameter posted since the last drain, in
+	// index order. Mixer thread only.
+	template<typename Apply>
+	void drain(Apply apply)
+	{
+		if (!m_dirty.load(std::memory_order_relaxed)) {
+			return;
+		}
+
+		unsigned int dirty = m_dirty.exchange(0, std::memory_order_acquire);
+		for (int index = 0; dirty; index++, dirty >>= 1)
+		{
+			if (dirty & 1) {
+				apply(index);
+			}
+		}
+	}
+
+private:
+	std::atomic<unsigned int> m_values[PARAM_MAILBOX_CAPACITY];
+	std::atomic<unsigned int> m_dirty;
+
+	void post(int index, unsigned int bits)
+	{
+		if ((unsigned int)index >= PARAM_MAILBOX_CAPACITY) {
+			return;
+		}
+		m_values[index].store(bits, std::memory_order_relaxed);
+		m_dirty.fetch_or(1u << index, std::memory_order_release);
+	}
+};
+
+#endif // !__PARAM_MAILBOX_H__
@@ -24,6 +24,7 @@
 
 #include "downsampler.h"
 #include "fmod_gain.h"
+#include "dsp_dispatch.h"
 
 // http://ffmpeg.org/
 // https://www.openal.org/
@@ -34,9 +35,19 @@ static FMOD_PLUGINLIST Plugin_List[] = {
 	{ FMOD_PLUGINTYPE_DSP, get_downsampler() },
 	{ FMOD_PLUGINTYPE_DSP, get_doubler() },
 	//{ FMOD_PLUGINTYPE_DSP, },
+
+	// FMOD reads the list until it meets this terminator.
+	{ FMOD_PLUGINTYPE_MAX, 0 }
 };
 
+// Plugin_List without picking the kernels, for lookups inside the library.
+FMOD_PLUGINLIST* Plugin_GetList() {
+	return Plugin_List;
+}
+
 DLLEXPORT FMOD_PLUGINLIST* F_CALL FMODGetPluginDescriptionList() {
+	// FMOD loads the list before it creates any instance
+	DSPKernels_Select();
 	return Plugin_List;
 }
 
@@ -42,18 +42,25 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 
+#if defined(_WIN32)
 #define DLLEXPORT extern "C" _declspec(dllexport)
+#else
+#define DLLEXPORT extern "C" __attribute__((visibility("default")))
+#endif
 #define TYPECAST(type, value) reinterpret_cast<type>(value)
 
-#define FMOD_NOISE_RAMPCOUNT 256
+// gain and level changes ramp over this long (256 samples at 48 kHz)
+#define POINT_GAIN_RAMP_MS 5.333f
+// mix changes settle over this long
+#define POINT_MIX_RAMP_MS 20
 #define GAIN_MIN -80.0f
 #define GAIN_MAX 10.0f
+// a block whose peak stays at or below this (-120 dB) counts as silence
+#define POINT_SILENCE_THRESHOLD 1e-6f
 
 #define DECIBELS_TO_LINEAR(__dbval__)  ((__dbval__ <= -80.0f) ? 0.0f : powf(10.0f, __dbval__ / 20.0f))
 #define LINEAR_TO_DECIBELS(__linval__) ((__linval__ <= 0.0f) ? -80.0f : 20.0f * log10f((float)__linval__))
 
 // Math
-//#define MINUSONE_TO_ONE ((float)rand() / (RAND_MAX))
-#define MINUSONE_TO_ONE (((float)(rand()%32768) / 16384.0f) - 1.0f)
 // _amount = 0 ~ 1
 #define MIX(_a, _original, _amount) (((_a) * _amount) + ((_original) * (1 - _amount)))
\ No newline at end of file
@@ -0,0 +1,192 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// random.h: per-instance noise source for the DSP plugins.
+// xoshiro128+ run as RANDOM_LANES independent streams so whole blocks are
+// generated with SIMD. The lane count is fixed, not tied to the vector width,
+// so the same seed yields the same noise on every instruction set.
+
+#pragma once
+
+#ifndef __RANDOM_H__
+#define __RANDOM_H__
+
+#include <string.h>
+#include <atomic>
+
+#include "simd.h"
+
+#define RANDOM_LANES 8
+
+class Random
+{
+public:
+	void seed(unsigned long long value);
+
+	// Fills count uniform floats in [-1, 1).
+	void fill(float* outbuffer, unsigned int count);
+	// Single value in [-1, 1), drawn from the same stream as fill.
+	float next();
+
+	// Distinct, deterministic seed per created instance.
+	static unsigned long long nextSeed();
+
+private:
+	unsigned int m_state[4][RANDOM_LANES];
+
+	float m_cache[RANDOM_LANES];
+	unsigned int m_cache_pos;
+
+	void generate(float* outbuffer);
+
+	friend class RandomSeedScope;
+	// the seeds a RandomSeedScope hands out on this thread, while one is open
+	struct SeedSource
+	{
+		bool open;
+		unsigned long long state;
+	};
+	static SeedSource& seedSource();
+};
+
+inline unsigned long long Random_SplitMix64(unsigned long long* x)
+{
+	unsigned long long z = (*x += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+// While alive, nextSeed on the constructing thread draws from `seed` instead
+// of the process-wide counter, so that instances created in the scope (e.g. by
+// a bake, dsp_bake.h) get the same noise whatever was created before them.
+class RandomSeedScope
+{
+public:
+	explicit RandomSeedScope(unsigned long long seed)
+	{
+		Random::SeedSource& source = Random::seedSource();
+		m_previous = source;
+		source.open = true;
+		source.state = seed;
+	}
+	~RandomSeedScope()
+	{
+		Random::seedSource() = m_previous;
+	}
+
+private:
+	Random::SeedSource m_previous;
+};
+
+inline Random::SeedSource& Random::seedSource()
+{
+	static thread_local SeedSource source = { false, 0 };
+	return source;
+}
+
+inline unsigned long long Random::nextSeed()
+{
+	SeedSource& source = seedSource();
+	if (source.open) {
+		return Random_SplitMix64(&source.state);
+	}
+	static std::atomic<unsigned long long> counter(0);
+	return counter++;
+}
+
+inline void Random::seed(unsigned long long value)
+{
+	for (int lane = 0; lane < RANDOM_LANES; lane++)
+	{
+		unsigned long long a = Random_SplitMix64(&value);
+		unsigned long long b = Random_SplitMix64(&value);
+
+		m_state[0][lane] = (unsigned int)a;
+		m_state[1][lane] = (unsigned int)(a >> 32);
+		m_state[2][lane] = (unsigned int)b;
+		m_state[3][lane] = (unsigned int)(b >> 32) | 1;
+	}
+
+	m_cache_pos = RANDOM_LANES;
+}
+
+// One xoshiro128+ step on every lane, mapped to [-1, 1) through the exponent
+// trick: top 23 bits as mantissa of a float in [2, 4), minus 3.
+inline void Random::generate(float* outbuffer)
+{
+	const vuint exponent = simd_set1u32(0x40000000u);
+	const vfloat three = simd_set1(3.0f);
+
+	for (int lane = 0; lane < RANDOM_LANES; lane += POINT_SIMD_WIDTH)
+	{
+		vuint s0 = simd_loadu32(&m_state[0][lane]);
+		vuint s1 = simd_loadu32(&m_state[1][lane]);
+		vuint s2 = simd_loadu32(&m_state[2][lane]);
+		vuint s3 = simd_loadu32(&m_state[3][lane]);
+
+		vuint result = simd_addu32(s0, s3);
+		vuint t = simd_shlu32<9>(s1);
+
+		s2 = simd_xoru32(s2, s0);
+		s3 = simd_xoru32(s3, s1);
+		s1 = simd_xoru32(s1, s2);
+		s0 = simd_xoru32(s0, s3);
+		s2 = simd_xoru32(s2, t);
+		s3 = simd_rotlu32<11>(s3);
+
+		simd_storeu32(&m_state[0][lane], s0);
+		simd_storeu32(&m_state[1][lane], s1);
+		simd_storeu32(&m_state[2][lane], s2);
+		simd_storeu32(&m_state[3][lane], s3);
+
+		vfloat value = simd_castu32(simd_oru32(simd_shru32<9>(result), exponent));
+		simd_store(outbuffer + lane, simd_sub(value, three));
+	}
+}
+
+inline void Random::fill(float* outbuffer, unsigned int count)
+{
+	while (count && m_cache_pos < RANDOM_LANES)
+	{
+		*outbuffer++ = m_cache[m_cache_pos++];
+		count--;
+	}
+
+	while (RANDOM_LANES <= count)
+	{
+		generate(outbuffer);
+		outbuffer += RANDOM_LANES;
+		count -= RANDOM_LANES;
+	}
+
+	if (count) {
+		generate(m_cache);
+		memcpy(outbuffer, m_cache, sizeof(float) * count);
+		m_cache_pos = count;
+	}
+}
+
+inline float Random::next()
+{
+	if (RANDOM_LANES <= m_cache_pos) {
+		generate(m_cache);
+		m_cache_pos = 0;
+	}
+	return m_cache[m_cache_pos++];
+}
+
+#endif // !__RANDOM_H__
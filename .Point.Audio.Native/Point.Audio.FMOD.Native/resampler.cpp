@@ -0,0 +1,280 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include <math.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+#include "pch.h"
+#include "resampler.h"
+#include "dsp_dispatch.h"
+#include "dsp_memory.h"
+
+#define RESAMPLER_PI 3.14159265358979323846
+
+#pragma region ResamplerTable
+
+namespace
+{
+	struct ResamplerCache
+	{
+		std::mutex lock;
+		// entries below count are complete and never change
+		std::atomic<int> count{ 0 };
+		ResamplerTable tables[RESAMPLER_CACHE_SIZE];
+		// every table's rows, as the cache sees them
+		DSPMemory memory;
+
+		~ResamplerCache()
+		{
+			int built = count.load(std::memory_order_acquire);
+			for (int i = 0; i < built; i++)
+			{
+				delete[] tables[i].rows;
+			}
+		}
+	};
+
+	ResamplerCache s_cache;
+
+	inline double Resampler_Sinc(double x)
+	{
+		return x == 0 ? 1 : sin(RESAMPLER_PI * x) / (RESAMPLER_PI * x);
+	}
+	// Blackman window over [-1, 1]
+	inline double Resampler_Window(double x)
+	{
+		return .42 + .5 * cos(RESAMPLER_PI * x) + .08 * cos(2 * RESAMPLER_PI * x);
+	}
+
+	bool ResamplerTable_InRange(unsigned int num, unsigned int den)
+	{
+		const unsigned int limit = RESAMPLER_MAX_RATIO * RESAMPLER_MAX_DENOMINATOR;
+		return 0 < num && 0 < den && num <= limit && den <= limit
+			&& num <= RESAMPLER_MAX_RATIO * den && den <= RESAMPLER_MAX_RATIO * num;
+	}
+
+	// Fills `table` for num / den; false when out of memory.
+	bool ResamplerTable_Build(ResamplerTable* table, unsigned int num, unsigned int den)
+	{
+		// cutoff in cycles per input frame times two, and the kernel's half length in input frames
+		double cutoff = RESAMPLER_CUTOFF * (num < den ? 1.0 : (double)den / num);
+		double half = RESAMPLER_ZERO_CROSSINGS / cutoff;
+		unsigned int center = (unsigned int)ceil(half);
+		unsigned int taps = (2 * center + 1 + RESAMPLER_TAP_ALIGN - 1) & ~(unsigned int)(RESAMPLER_TAP_ALIGN - 1);
+
+		float* rows = new (std::nothrow) float[(size_t)den * taps];
+		if (!rows) {
+			return false;
+		}
+
+		for (unsigned int p = 0; p < den; p++)
+		{
+			float* row = rows + (size_t)p * taps;
+			double offset = center + (double)p / den;
+			double sum = 0;
+			for (unsigned int k = 0; k < taps; k++)
+			{
+				double t = k - offset;
+				double c = fabs(t) < half ? cutoff * Resampler_Sinc(cutoff * t) * Resampler_Window(t / half) : 0;
+				row[k] = (float)c;
+				sum += c;
+			}
+			// unity gain at DC for every phase, so the phase pattern leaves no tone behind
+			for (unsigned int k = 0; k < taps; k++)
+			{
+				row[k] = (float)(row[k] / sum);
+			}
+		}
+
+		table->num = num;
+		table->den = den;
+		table->taps = taps;
+		table->center = center;
+		table->rows = rows;
+		return true;
+	}
+}
+
+void Resampler_Approximate(double ratio, unsigned int* num, unsigned int* den)
+{
+	if (!(ratio >= 1.0 / RESAMPLER_MAX_RATIO)) ratio = 1.0 / RESAMPLER_MAX_RATIO;
+	if (ratio > RESAMPLER_MAX_RATIO) ratio = RESAMPLER_MAX_RATIO;
+
+	unsigned int best_num = 1, best_den = 1;
+	double best_error = fabs(ratio - 1);
+	for (unsigned int q = 1; q <= RESAMPLER_MAX_DENOMINATOR; q++)
+	{
+		unsigned int p = (unsigned int)floor(ratio * q + .5);
+		if (!ResamplerTable_InRange(p, q)) {
+			continue;
+		}
+		// strictly better only, so a reducible p / q loses to its reduced form
+		double error = fabs(ratio - (double)p / q);
+		if (error < best_error) {
+			best_error = error;
+			best_num = p;
+			best_den = q;
+		}
+	}
+	*num = best_num;
+	*den = best_den;
+}
+
+const ResamplerTable* ResamplerTable_Find(unsigned int num, unsigned int den)
+{
+	int count = s_cache.count.load(std::memory_order_acquire);
+	for (int i = 0; i < count; i++)
+	{
+		const ResamplerTable& table = s_cache.tables[i];
+		if (table.num == num && table.den == den) {
+			return &table;
+		}
+	}
+	return 0;
+}
+
+const ResamplerTable* ResamplerTable_Prepare(unsigned int num, unsigned int den)
+{
+	if (!ResamplerTable_InRange(num, den)) {
+		return 0;
+	}
+	const ResamplerTable* found = ResamplerTable_Find(num, den);
+	if (found) {
+		return found;
+	}
+
+	std::lock_guard<std::mutex> lock(s_cache.lock);
+	// another thread may have built it while this one waited
+	found = ResamplerTable_Find(num, den);
+	if (found) {
+		return found;
+	}
+	int count = s_cache.count.load(std::memory_order_relaxed);
+	if (RESAMPLER_CACHE_SIZE <= count) {
+		return 0;
+	}
+
+	ResamplerTable* table = &s_cache.tables[count];
+	if (!ResamplerTable_Build(table, num, den)) {
+		return 0;
+	}
+	s_cache.memory.attach("Point resampler tables", 0);
+	s_cache.memory.charge(sizeof(float) * den * table->taps);
+	s_cache.count.store(count + 1, std::memory_order_release);
+	return table;
+}
+
+#pragma endregion
+
+#pragma region Resampler
+
+void Resampler::init(float* history, unsigned int capacity)
+{
+	m_table = 0;
+	m_history = history;
+	m_capacity = capacity;
+	m_fill = 0;
+	m_index = 0;
+	m_phase = 0;
+}
+
+void Resampler::reset(const ResamplerTable* table, unsigned int slack)
+{
+	m_table = table;
+	m_fill = table ? table->taps - 1 + slack : 0;
+	if (m_fill > m_capacity) m_fill = m_capacity;
+	memset(m_history, 0, sizeof(float) * m_fill);
+	m_index = 0;
+	m_phase = 0;
+}
+
+void Resampler::compact()
+{
+	if (m_index) {
+		memmove(m_history, m_history + m_index, sizeof(float) * (m_fill - m_index));
+		m_fill -= m_index;
+		m_index = 0;
+	}
+}
+
+void Resampler::setTable(const ResamplerTable* table)
+{
+	if (table == m_table) {
+		return;
+	}
+	if (!m_table || !table) {
+		reset(table, 0);
+		return;
+	}
+
+	compact();
+	double start = m_table->center + (double)m_phase / m_table->den - table->center;
+	if (start < 0) {
+		// the longer window reaches back past the history kept
+		unsigned int missing = (unsigned int)ceil(-start);
+		if (missing > m_capacity - m_fill) missing = m_capacity - m_fill;
+		memmove(m_history + missing, m_history, sizeof(float) * m_fill);
+		memset(m_history, 0, sizeof(float) * missing);
+		m_fill += missing;
+		start += missing;
+		if (start < 0) start = 0;
+	}
+
+	m_table = table;
+	m_index = (unsigned int)start;
+	m_phase = (unsigned int)((start - m_index) * table->den + .5);
+	if (m_phase >= table->den) {
+		m_phase -= table->den;
+		m_index++;
+	}
+	if (m_index > m_fill) {
+		m_index = m_fill;
+		m_phase = 0;
+	}
+}
+
+void Resampler::write(const float* input, unsigned int count)
+{
+	if (m_fill + count > m_capacity) {
+		compact();
+		if (m_fill + count > m_capacity) {
+			count = m_capacity - m_fill;
+		}
+	}
+	memcpy(m_history + m_fill, input, sizeof(float) * count);
+	m_fill += count;
+}
+
+unsigned int Resampler::read(float* output, unsigned int count)
+{
+	if (!m_table) {
+		return 0;
+	}
+	const unsigned int den = m_table->den;
+	return DSPKernels().polyphase(m_history, m_fill, m_table->rows, m_table->taps,
+		m_table->num / den, m_table->num % den, den, &m_index, &m_phase, output, count);
+}
+
+void Resampler::drop(unsigned int count)
+{
+	unsigned int available = m_fill - m_index;
+	m_index += count < available ? count : available;
+}
+
+#pragma endregion
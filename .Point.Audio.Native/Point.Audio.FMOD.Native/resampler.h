@@ -0,0 +1,123 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// resampler.h: polyphase FIR sample rate conversion by a rational ratio.
+// A ResamplerTable holds a windowed-sinc lowpass sampled at `den` phases, one
+// row per phase, for converting `num` input frames into `den` output frames;
+// its cutoff sits just below the Nyquist frequency of the lower of the two
+// rates, so the same kind of table decimates and interpolates. Every output
+// frame is one SIMD dot product of a row with the input window (Kernel_Polyphase).
+//
+// Tables are built once per ratio and shared by every instance for the life
+// of the library. Building one takes a lock and allocates, so it happens off
+// the mixer thread (ResamplerTable_Prepare, e.g. from a plugin's prepare()
+// hook); the mixer thread only looks prepared tables up, without a lock.
+//
+// A Resampler is one channel's stream through a table: frames are written,
+// as many outputs as the written frames cover are read, and the history the
+// next windows still need is kept in a caller-provided buffer.
+
+#pragma once
+
+#ifndef __RESAMPLER_H__
+#define __RESAMPLER_H__
+
+#include "pch.h"
+
+// zero crossings of the windowed sinc on either side, counted at the lower rate
+#define RESAMPLER_ZERO_CROSSINGS 8
+// passband edge as a fraction of the lower rate's Nyquist frequency
+#define RESAMPLER_CUTOFF 0.9
+// largest ratio either way
+#define RESAMPLER_MAX_RATIO 32
+// largest denominator Resampler_Approximate picks
+#define RESAMPLER_MAX_DENOMINATOR 16
+// rows are padded to a multiple of this, the widest vector there is
+#define RESAMPLER_TAP_ALIGN 8
+// longest row: a decimation by RESAMPLER_MAX_RATIO
+#define RESAMPLER_MAX_TAPS 576
+// longest row of a table with num <= den, which interpolates
+#define RESAMPLER_INTERPOLATE_TAPS 24
+// most frames one write or read moves
+#define RESAMPLER_RUN_LENGTH 64
+// floats of history a Resampler has to be given for tables up to `taps` long
+#define RESAMPLER_HISTORY(taps) (2 * (taps) + 2 * RESAMPLER_RUN_LENGTH)
+// tables kept; once full, ResamplerTable_Prepare builds no more
+#define RESAMPLER_CACHE_SIZE 128
+
+struct ResamplerTable
+{
+	// `num` input frames make `den` output frames
+	unsigned int num;
+	unsigned int den;
+	// coefficients per row, a multiple of RESAMPLER_TAP_ALIGN
+	unsigned int taps;
+	// frames from the start of a window to the input frame phase 0 lines up with
+	unsigned int center;
+	// den rows of taps; row p is for an output p / den frames past the center
+	const float* rows;
+};
+
+// The num / den closest to `ratio` input frames per output frame with a
+// denominator of at most RESAMPLER_MAX_DENOMINATOR, within RESAMPLER_MAX_RATIO
+// either way.
+void Resampler_Approximate(double ratio, unsigned int* num, unsigned int* den);
+
+// The table for num / den, built on first use; null when the ratio is out of
+// range, memory runs out or the cache is full. Locks and allocates, so not on
+// the mixer thread.
+const ResamplerTable* ResamplerTable_Prepare(unsigned int num, unsigned int den);
+// The table for num / den if it was prepared, else null. Never blocks.
+const ResamplerTable* ResamplerTable_Find(unsigned int num, unsigned int den);
+
+class Resampler
+{
+public:
+	// `history` holds `capacity` floats, RESAMPLER_HISTORY of the longest table used.
+	void init(float* history, unsigned int capacity);
+	// Starts over on silence, primed with `slack` frames more than the table
+	// needs for its first output.
+	void reset(const ResamplerTable* table, unsigned int slack);
+	// Changes tables, keeping the time of the next output; history the new
+	// table reaches back into and that is gone reads as silence.
+	void setTable(const ResamplerTable* table);
+	const ResamplerTable* table() const { return m_table; }
+
+	// Appends `count` input frames, at most RESAMPLER_RUN_LENGTH.
+	void write(const float* input, unsigned int count);
+	// Computes up to `count` output frames from what was written and returns how many.
+	unsigned int read(float* output, unsigned int count);
+
+	// Frames written that the next window starts at or after.
+	unsigned int available() const { return m_fill - m_index; }
+	// Moves the next window `count` frames later, at most up to the last frame written.
+	void drop(unsigned int count);
+
+private:
+	const ResamplerTable* m_table;
+	float* m_history;
+	unsigned int m_capacity;
+	// frames held
+	unsigned int m_fill;
+	// first frame of the next window and that output's phase, in 1 / den
+	unsigned int m_index;
+	unsigned int m_phase;
+
+	// moves the next window to the start of the history
+	void compact();
+};
+
+#endif // !__RESAMPLER_H__
@@ -0,0 +1,77 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// ring_buffer.h: power-of-two delay line helpers.
+// Positions are free-running counters wrapped with a mask, so a block read or
+// write splits into at most two contiguous copies and needs no per-sample checks.
+
+#pragma once
+
+#ifndef __RING_BUFFER_H__
+#define __RING_BUFFER_H__
+
+#include <string.h>
+
+// Smallest power of two that holds `count` samples.
+static inline unsigned int Ring_Size(unsigned int count)
+{
+	unsigned int size = 1;
+	while (size < count)
+	{
+		size <<= 1;
+	}
+	return size;
+}
+
+// dst[k] = buffer[(pos + k) & mask]
+static inline void Ring_Read(const float* buffer, unsigned int mask, unsigned int pos, float* dst, unsigned int count)
+{
+	unsigned int start = pos & mask;
+	unsigned int first = mask + 1 - start;
+	if (first > count) first = count;
+
+	memcpy(dst, buffer + start, sizeof(float) * first);
+	if (first < count) {
+		memcpy(dst + first, buffer, sizeof(float) * (count - first));
+	}
+}
+// buffer[(pos + k) & mask] = src[k]
+static inline void Ring_Write(float* buffer, unsigned int mask, unsigned int pos, const float* src, unsigned int count)
+{
+	unsigned int start = pos & mask;
+	unsigned int first = mask + 1 - start;
+	if (first > count) first = count;
+
+	memcpy(buffer + start, src, sizeof(float) * first);
+	if (first < count) {
+		memcpy(buffer, src + first, sizeof(float) * (count - first));
+	}
+}
+
+// buffer[(pos + k) & mask] = 0
+static inline void Ring_Zero(float* buffer, unsigned int mask, unsigned int pos, unsigned int count)
+{
+	unsigned int start = pos & mask;
+	unsigned int first = mask + 1 - start;
+	if (first > count) first = count;
+
+	memset(buffer + start, 0, sizeof(float) * first);
+	if (first < count) {
+		memset(buffer, 0, sizeof(float) * (count - first));
+	}
+}
+
+#endif // !__RING_BUFFER_H__
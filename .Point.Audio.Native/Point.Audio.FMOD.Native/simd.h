@@ -0,0 +1,384 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// simd.h: thin wrapper over the vector instruction set the plugin is built for.
+// Kernels are written once against vfloat and compile to AVX-512, AVX2, SSE2,
+// NEON or plain scalar code. POINT_SIMD_WIDTH is the number of floats per vfloat.
+// simd_select(mask, a, b) takes a from the lanes of mask that are all ones and
+// b from those that are zero; other mask values are not defined on every target.
+//
+// The compiler's target picks the instruction set unless the including file
+// defines one of POINT_SIMD_AVX512, POINT_SIMD_AVX2, POINT_SIMD_SSE2,
+// POINT_SIMD_NEON or POINT_SIMD_SCALAR first, as the kernel variants behind
+// dsp_dispatch.h do. AVX-512 is only used when asked for that way.
+
+#pragma once
+
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#if defined(POINT_SIMD_AVX512) || defined(POINT_SIMD_AVX2) || defined(POINT_SIMD_SSE2) \
+	|| defined(POINT_SIMD_NEON) || defined(POINT_SIMD_SCALAR)
+// chosen by the including file
+#elif defined(__AVX2__)
+#define POINT_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define POINT_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define POINT_SIMD_NEON
+#else
+#define POINT_SIMD_SCALAR
+#endif
+
+#if defined(POINT_SIMD_AVX512) || defined(POINT_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(POINT_SIMD_SSE2)
+#include <emmintrin.h>
+#elif defined(POINT_SIMD_NEON)
+#include <arm_neon.h>
+#if defined(_M_ARM64)
+#include <intrin.h>
+#endif
+#else
+#include <string.h>
+#endif
+
+#if defined(POINT_SIMD_AVX512)
+
+#define POINT_SIMD_WIDTH 16
+typedef __m512 vfloat;
+typedef __m512i vuint;
+
+static inline vfloat simd_load(const float* p) { return _mm512_loadu_ps(p); }
+static inline void simd_store(float* p, vfloat v) { _mm512_storeu_ps(p, v); }
+static inline vfloat simd_set1(float v) { return _mm512_set1_ps(v); }
+static inline vfloat simd_add(vfloat a, vfloat b) { return _mm512_add_ps(a, b); }
+static inline vfloat simd_sub(vfloat a, vfloat b) { return _mm512_sub_ps(a, b); }
+static inline vfloat simd_mul(vfloat a, vfloat b) { return _mm512_mul_ps(a, b); }
+static inline vfloat simd_min(vfloat a, vfloat b) { return _mm512_min_ps(a, b); }
+static inline vfloat simd_max(vfloat a, vfloat b) { return _mm512_max_ps(a, b); }
+static inline vfloat simd_abs(vfloat a) { return _mm512_abs_ps(a); }
+static inline bool simd_anygt(vfloat a, vfloat b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ) != 0; }
+static inline vfloat simd_ramp(float start, float step) {
+	return _mm512_add_ps(_mm512_set1_ps(start), _mm512_mul_ps(_mm512_set1_ps(step),
+		_mm512_set_ps(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)));
+}
+// halves through the double view, which AVX-512F has without DQ
+static inline float simd_hsum(vfloat a) {
+	__m256 h = _mm256_add_ps(_mm512_castps512_ps256(a), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a), 1)));
+	__m128 v = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1)));
+}
+
+static inline vuint simd_loadu32(const unsigned int* p) { return _mm512_loadu_si512((const void*)p); }
+static inline void simd_storeu32(unsigned int* p, vuint v) { _mm512_storeu_si512((void*)p, v); }
+static inline vuint simd_set1u32(unsigned int v) { return _mm512_set1_epi32((int)v); }
+static inline vuint simd_addu32(vuint a, vuint b) { return _mm512_add_epi32(a, b); }
+static inline vuint simd_xoru32(vuint a, vuint b) { return _mm512_xor_si512(a, b); }
+static inline vuint simd_oru32(vuint a, vuint b) { return _mm512_or_si512(a, b); }
+template <int N> static inline vuint simd_shlu32(vuint a) { return _mm512_slli_epi32(a, N); }
+template <int N> static inline vuint simd_shru32(vuint a) { return _mm512_srli_epi32(a, N); }
+static inline vfloat simd_castu32(vuint a) { return _mm512_castsi512_ps(a); }
+static inline vfloat simd_select(vuint mask, vfloat a, vfloat b) { return _mm512_mask_blend_ps(_mm512_test_epi32_mask(mask, mask), b, a); }
+
+#elif defined(POINT_SIMD_AVX2)
+
+#define POINT_SIMD_WIDTH 8
+typedef __m256 vfloat;
+typedef __m256i vuint;
+
+static inline vfloat simd_load(const float* p) { return _mm256_loadu_ps(p); }
+static inline void simd_store(float* p, vfloat v) { _mm256_storeu_ps(p, v); }
+static inline vfloat simd_set1(float v) { return _mm256_set1_ps(v); }
+static inline vfloat simd_add(vfloat a, vfloat b) { return _mm256_add_ps(a, b); }
+static inline vfloat simd_sub(vfloat a, vfloat b) { return _mm256_sub_ps(a, b); }
+static inline vfloat simd_mul(vfloat a, vfloat b) { return _mm256_mul_ps(a, b); }
+static inline vfloat simd_min(vfloat a, vfloat b) { return _mm256_min_ps(a, b); }
+static inline vfloat simd_max(vfloat a, vfloat b) { return _mm256_max_ps(a, b); }
+static inline vfloat simd_abs(vfloat a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+// true when any lane of a is greater than the same lane of b
+static inline bool simd_anygt(vfloat a, vfloat b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)) != 0; }
+// { 0, 1, 2, ... } * step + start
+static inline vfloat simd_ramp(float start, float step) {
+	return _mm256_add_ps(_mm256_set1_ps(start), _mm256_mul_ps(_mm256_set1_ps(step), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)));
+}
+// sum of the lanes
+static inline float simd_hsum(vfloat a) {
+	__m128 v = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+	v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+	return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1)));
+}
+
+static inline vuint simd_loadu32(const unsigned int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+static inline void simd_storeu32(unsigned int* p, vuint v) { _mm256_storeu_si256((__m256i*)p, v); }
+static inline vuint simd_set1u32(unsigned int v) { return _mm256_set1_epi32((int)v); }
+static inline vuint simd_addu32(vuint a, vuint b) { return _mm256_add_epi32(a, b); }
+static inline vuint simd_xoru32(vuint a, vuint b) { return _mm256_xor_si256(a, b); }
+static inline vuint simd_oru32(vuint a, vuint b) { return _mm256_or_si256(a, b); }
+template <int N> static inline vuint simd_shlu32(vuint a) { return _mm256_slli_epi32(a, N); }
+template <int N> static inline vuint simd_shru32(vuint a) { return _mm256_srli_epi32(a, N); }
+static inline vfloat simd_castu32(vuint a) { return _mm256_castsi256_ps(a); }
+static inline vfloat simd_select(vuint mask, vfloat a, vfloat b) { return _mm256_blendv_ps(b, a, _mm256_castsi256_ps(mask)); }
+
+#elif defined(POINT_SIMD_SSE2)
+
+#define POINT_SIMD_WIDTH 4
+typedef __m128 vfloat;
+typedef __m128i vuint;
+
+static inline vfloat simd_load(const float* p) { return _mm_loadu_ps(p); }
+static inline void simd_store(float* p, vfloat v) { _mm_storeu_ps(p, v); }
+static inline vfloat simd_set1(float v) { return _mm_set1_ps(v); }
+static inline vfloat simd_add(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+static inline vfloat simd_sub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+static inline vfloat simd_mul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+static inline vfloat simd_min(vfloat a, vfloat b) { return _mm_min_ps(a, b); }
+static inline vfloat simd_max(vfloat a, vfloat b) { return _mm_max_ps(a, b); }
+static inline vfloat simd_abs(vfloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline bool simd_anygt(vfloat a, vfloat b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)) != 0; }
+static inline vfloat simd_ramp(float start, float step) {
+	return _mm_add_ps(_mm_set1_ps(start), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(0, 1, 2, 3)));
+}
+static inline float simd_hsum(vfloat a) {
+	vfloat v = _mm_add_ps(a, _mm_movehl_ps(a, a));
+	return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1)));
+}
+
+static inline vuint simd_loadu32(const unsigned int* p) { return _mm_loadu_si128((const __m128i*)p); }
+static inline void simd_storeu32(unsigned int* p, vuint v) { _mm_storeu_si128((__m128i*)p, v); }
+static inline vuint simd_set1u32(unsigned int v) { return _mm_set1_epi32((int)v); }
+static inline vuint simd_addu32(vuint a, vuint b) { return _mm_add_epi32(a, b); }
+static inline vuint simd_xoru32(vuint a, vuint b) { return _mm_xor_si128(a, b); }
+static inline vuint simd_oru32(vuint a, vuint b) { return _mm_or_si128(a, b); }
+template <int N> static inline vuint simd_shlu32(vuint a) { return _mm_slli_epi32(a, N); }
+template <int N> static inline vuint simd_shru32(vuint a) { return _mm_srli_epi32(a, N); }
+static inline vfloat simd_castu32(vuint a) { return _mm_castsi128_ps(a); }
+static inline vfloat simd_select(vuint mask, vfloat a, vfloat b) {
+	__m128 m = _mm_castsi128_ps(mask);
+	return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+#elif defined(POINT_SIMD_NEON)
+
+#define POINT_SIMD_WIDTH 4
+typedef float32x4_t vfloat;
+typedef uint32x4_t vuint;
+
+static inline vfloat simd_load(const float* p) { return vld1q_f32(p); }
+static inline void simd_store(float* p, vfloat v) { vst1q_f32(p, v); }
+static inline vfloat simd_set1(float v) { return vdupq_n_f32(v); }
+static inline vfloat simd_add(vfloat a, vfloat b) { return vaddq_f32(a, b); }
+static inline vfloat simd_sub(vfloat a, vfloat b) { return vsubq_f32(a, b); }
+static inline vfloat simd_mul(vfloat a, vfloat b) { return vmulq_f32(a, b); }
+static inline vfloat simd_min(vfloat a, vfloat b) { return vminq_f32(a, b); }
+static inline vfloat simd_max(vfloat a, vfloat b) { return vmaxq_f32(a, b); }
+static inline vfloat simd_abs(vfloat a) { return vabsq_f32(a); }
+static inline bool simd_anygt(vfloat a, vfloat b) {
+	uint32x4_t mask = vcgtq_f32(a, b);
+	uint32x2_t half = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+	return (vget_lane_u32(half, 0) | vget_lane_u32(half, 1)) != 0;
+}
+static inline vfloat simd_ramp(float start, float step) {
+	static const float index[4] = { 0, 1, 2, 3 };
+	return vmlaq_f32(vdupq_n_f32(start), vld1q_f32(index), vdupq_n_f32(step));
+}
+static inline float simd_hsum(vfloat a) {
+	float32x2_t half = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+	return vget_lane_f32(vpadd_f32(half, half), 0);
+}
+
+static inline vuint simd_loadu32(const unsigned int* p) { return vld1q_u32(p); }
+static inline void simd_storeu32(unsigned int* p, vuint v) { vst1q_u32(p, v); }
+static inline vuint simd_set1u32(unsigned int v) { return vdupq_n_u32(v); }
+static inline vuint simd_addu32(vuint a, vuint b) { return vaddq_u32(a, b); }
+static inline vuint simd_xoru32(vuint a, vuint b) { return veorq_u32(a, b); }
+static inline vuint simd_oru32(vuint a, vuint b) { return vorrq_u32(a, b); }
+template <int N> static inline vuint simd_shlu32(vuint a) { return vshlq_n_u32(a, N); }
+template <int N> static inline vuint simd_shru32(vuint a) { return vshrq_n_u32(a, N); }
+static inline vfloat simd_castu32(vuint a) { return vreinterpretq_f32_u32(a); }
+static inline vfloat simd_select(vuint mask, vfloat a, vfloat b) { return vbslq_f32(mask, a, b); }
+
+#else
+
+#define POINT_SIMD_WIDTH 4
+struct vfloat { float v[4]; };
+struct vuint { unsigned int v[4]; };
+
+static inline vfloat simd_load(const float* p) { vfloat r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+static inline void simd_store(float* p, vfloat a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline vfloat simd_set1(float a) { vfloat r; for (int i = 0; i < 4; i++) r.v[i] = a; return r; }
+static inline vfloat simd_add(vfloat a, vfloat b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline vfloat simd_sub(vfloat a, vfloat b) { for (int i = 0; i < 4; i++) a.v[i] -= b.v[i]; return a; }
+static inline vfloat simd_mul(vfloat a, vfloat b) { for (int i = 0; i < 4; i++) a.v[i] *= b.v[i]; return a; }
+static inline vfloat simd_min(vfloat a, vfloat b) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return a; }
+static inline vfloat simd_max(vfloat a, vfloat b) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return a; }
+static inline vfloat simd_abs(vfloat a) { for (int i = 0; i < 4; i++) a.v[i] = a.v[i] < 0 ? -a.v[i] : a.v[i]; return a; }
+static inline bool simd_anygt(vfloat a, vfloat b) { for (int i = 0; i < 4; i++) if (a.v[i] > b.v[i]) return true; return false; }
+static inline vfloat simd_ramp(float start, float step) { vfloat r; for (int i = 0; i < 4; i++) r.v[i] = start + step * i; return r; }
+static inline float simd_hsum(vfloat a) { return (a.v[0] + a.v[1]) + (a.v[2] + a.v[3]); }
+
+static inline vuint simd_loadu32(const unsigned int* p) { vuint r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+static inline void simd_storeu32(unsigned int* p, vuint a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline vuint simd_set1u32(unsigned int a) { vuint r; for (int i = 0; i < 4; i++) r.v[i] = a; return r; }
+static inline vuint simd_addu32(vuint a, vuint b) { for (int i = 0; i < 4; i++) a.v[i] += b.v[i]; return a; }
+static inline vuint simd_xoru32(vuint a, vuint b) { for (int i = 0; i < 4; i++) a.v[i] ^= b.v[i]; return a; }
+static inline vuint simd_oru32(vuint a, vuint b) { for (int i = 0; i < 4; i++) a.v[i] |= b.v[i]; return a; }
+template <int N> static inline vuint simd_shlu32(vuint a) { for (int i = 0; i < 4; i++) a.v[i] <<= N; return a; }
+template <int N> static inline vuint simd_shru32(vuint a) { for (int i = 0; i < 4; i++) a.v[i] >>= N; return a; }
+static inline vfloat simd_castu32(vuint a) { vfloat r; memcpy(&r, &a, sizeof(r)); return r; }
+static inline vfloat simd_select(vuint mask, vfloat a, vfloat b) { for (int i = 0; i < 4; i++) if (!mask.v[i]) a.v[i] = b.v[i]; return a; }
+
+#endif
+
+// a * b + c
+static inline vfloat simd_madd(vfloat a, vfloat b, vfloat c) { return simd_add(simd_mul(a, b), c); }
+
+// Four-lane shuffles for the interleave kernels, whatever POINT_SIMD_WIDTH is:
+// FMOD frames are 1 to 8 floats wide, so they are regrouped 4 x 4 at a time.
+#if defined(POINT_SIMD_AVX512) || defined(POINT_SIMD_AVX2) || defined(POINT_SIMD_SSE2)
+
+typedef __m128 vfloat4;
+
+static inline vfloat4 simd4_load(const float* p) { return _mm_loadu_ps(p); }
+static inline void simd4_store(float* p, vfloat4 v) { _mm_storeu_ps(p, v); }
+// { a[0], a[1], b[0], b[1] }
+static inline vfloat4 simd4_loadpairs(const float* a, const float* b) {
+	return _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), (const __m64*)a), (const __m64*)b);
+}
+// a[0..1] = v[0..1], b[0..1] = v[2..3]
+static inline void simd4_storepairs(float* a, float* b, vfloat4 v) { _mm_storel_pi((__m64*)a, v); _mm_storeh_pi((__m64*)b, v); }
+// { a[0], a[2], b[0], b[2] } and { a[1], a[3], b[1], b[3] }
+static inline vfloat4 simd4_even(vfloat4 a, vfloat4 b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)); }
+static inline vfloat4 simd4_odd(vfloat4 a, vfloat4 b) { return _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)); }
+// { a[0], b[0], a[1], b[1] } and { a[2], b[2], a[3], b[3] }
+static inline vfloat4 simd4_ziplo(vfloat4 a, vfloat4 b) { return _mm_unpacklo_ps(a, b); }
+static inline vfloat4 simd4_ziphi(vfloat4 a, vfloat4 b) { return _mm_unpackhi_ps(a, b); }
+static inline void simd4_transpose(vfloat4& r0, vfloat4& r1, vfloat4& r2, vfloat4& r3) { _MM_TRANSPOSE4_PS(r0, r1, r2, r3); }
+
+#elif defined(POINT_SIMD_NEON)
+
+typedef float32x4_t vfloat4;
+
+static inline vfloat4 simd4_load(const float* p) { return vld1q_f32(p); }
+static inline void simd4_store(float* p, vfloat4 v) { vst1q_f32(p, v); }
+static inline vfloat4 simd4_loadpairs(const float* a, const float* b) { return vcombine_f32(vld1_f32(a), vld1_f32(b)); }
+static inline void simd4_storepairs(float* a, float* b, vfloat4 v) { vst1_f32(a, vget_low_f32(v)); vst1_f32(b, vget_high_f32(v)); }
+static inline vfloat4 simd4_even(vfloat4 a, vfloat4 b) { return vuzpq_f32(a, b).val[0]; }
+static inline vfloat4 simd4_odd(vfloat4 a, vfloat4 b) { return vuzpq_f32(a, b).val[1]; }
+static inline vfloat4 simd4_ziplo(vfloat4 a, vfloat4 b) { return vzipq_f32(a, b).val[0]; }
+static inline vfloat4 simd4_ziphi(vfloat4 a, vfloat4 b) { return vzipq_f32(a, b).val[1]; }
+static inline void simd4_transpose(vfloat4& r0, vfloat4& r1, vfloat4& r2, vfloat4& r3) {
+	float32x4x2_t t01 = vtrnq_f32(r0, r1);
+	float32x4x2_t t23 = vtrnq_f32(r2, r3);
+	r0 = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+	r1 = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+	r2 = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+	r3 = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+#else
+
+struct vfloat4 { float v[4]; };
+
+static inline vfloat4 simd4_load(const float* p) { vfloat4 r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+static inline void simd4_store(float* p, vfloat4 a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+static inline vfloat4 simd4_loadpairs(const float* a, const float* b) { vfloat4 r = { { a[0], a[1], b[0], b[1] } }; return r; }
+static inline void simd4_storepairs(float* a, float* b, vfloat4 v) { a[0] = v.v[0]; a[1] = v.v[1]; b[0] = v.v[2]; b[1] = v.v[3]; }
+static inline vfloat4 simd4_even(vfloat4 a, vfloat4 b) { vfloat4 r = { { a.v[0], a.v[2], b.v[0], b.v[2] } }; return r; }
+static inline vfloat4 simd4_odd(vfloat4 a, vfloat4 b) { vfloat4 r = { { a.v[1], a.v[3], b.v[1], b.v[3] } }; return r; }
+static inline vfloat4 simd4_ziplo(vfloat4 a, vfloat4 b) { vfloat4 r = { { a.v[0], b.v[0], a.v[1], b.v[1] } }; return r; }
+static inline vfloat4 simd4_ziphi(vfloat4 a, vfloat4 b) { vfloat4 r = { { a.v[2], b.v[2], a.v[3], b.v[3] } }; return r; }
+static inline void simd4_transpose(vfloat4& r0, vfloat4& r1, vfloat4& r2, vfloat4& r3) {
+	vfloat4 c0 = { { r0.v[0], r1.v[0], r2.v[0], r3.v[0] } };
+	vfloat4 c1 = { { r0.v[1], r1.v[1], r2.v[1], r3.v[1] } };
+	vfloat4 c2 = { { r0.v[2], r1.v[2], r2.v[2], r3.v[2] } };
+	vfloat4 c3 = { { r0.v[3], r1.v[3], r2.v[3], r3.v[3] } };
+	r0 = c0; r1 = c1; r2 = c2; r3 = c3;
+}
+
+#endif
+
+template <int N> static inline vuint simd_rotlu32(vuint a) { return simd_oru32(simd_shlu32<N>(a), simd_shru32<32 - N>(a)); }
+
+#pragma region Denormals
+
+// Floating point control word of the calling thread: MXCSR on x86, FPCR or
+// FPSCR on ARM. SIMD_FPMODE_FLUSH are the bits that flush subnormals to zero,
+// FTZ | DAZ on x86 and FZ on ARM, which covers inputs and results alike.
+#if defined(POINT_SIMD_AVX512) || defined(POINT_SIMD_AVX2) || defined(POINT_SIMD_SSE2)
+
+#define SIMD_FPMODE_FLUSH 0x8040ull
+static inline unsigned long long simd_getfpmode() { return _mm_getcsr(); }
+static inline void simd_setfpmode(unsigned long long mode) { _mm_setcsr((unsigned int)mode); }
+
+#elif defined(POINT_SIMD_NEON) && defined(_M_ARM64)
+
+#define SIMD_FPMODE_FLUSH (1ull << 24)
+static inline unsigned long long simd_getfpmode() { return (unsigned long long)_ReadStatusReg(ARM64_FPCR); }
+static inline void simd_setfpmode(unsigned long long mode) { _WriteStatusReg(ARM64_FPCR, (__int64)mode); }
+
+#elif defined(POINT_SIMD_NEON) && defined(__aarch64__)
+
+#define SIMD_FPMODE_FLUSH (1ull << 24)
+static inline unsigned long long simd_getfpmode() { unsigned long long mode; __asm__ __volatile__("mrs %0, fpcr" : "=r"(mode)); return mode; }
+static inline void simd_setfpmode(unsigned long long mode) { __asm__ __volatile__("msr fpcr, %0" : : "r"(mode)); }
+
+#elif defined(POINT_SIMD_NEON)
+
+// NEON itself always flushes; this covers the VFP instructions next to it
+#define SIMD_FPMODE_FLUSH (1ull << 24)
+static inline unsigned long long simd_getfpmode() { unsigned int mode; __asm__ __volatile__("vmrs %0, fpscr" : "=r"(mode)); return mode; }
+static inline void simd_setfpmode(unsigned long long mode) { __asm__ __volatile__("vmsr fpscr, %0" : : "r"((unsigned int)mode)); }
+
+#else
+
+#define SIMD_FPMODE_FLUSH 0ull
+static inline unsigned long long simd_getfpmode() { return 0; }
+static inline void simd_setfpmode(unsigned long long /*mode*/) {}
+
+#endif
+
+// Flushes subnormals to zero on the calling thread for the lifetime of the
+// scope, so a decaying signal cannot drop into the slow subnormal path, and
+// gives the caller its own mode back on exit. A thread that already flushes
+// is left untouched, which keeps nested scopes down to one register read.
+class SimdDenormalScope
+{
+public:
+	SimdDenormalScope() : m_saved(simd_getfpmode())
+	{
+		if ((m_saved & SIMD_FPMODE_FLUSH) != SIMD_FPMODE_FLUSH) {
+			simd_setfpmode(m_saved | SIMD_FPMODE_FLUSH);
+		}
+	}
+	~SimdDenormalScope()
+	{
+		if ((m_saved & SIMD_FPMODE_FLUSH) != SIMD_FPMODE_FLUSH) {
+			simd_setfpmode(m_saved);
+		}
+	}
+
+private:
+	SimdDenormalScope(const SimdDenormalScope&);
+	SimdDenormalScope& operator=(const SimdDenormalScope&);
+
+	unsigned long long m_saved;
+};
+
+#pragma endregion
+
+#endif // !__SIMD_H__
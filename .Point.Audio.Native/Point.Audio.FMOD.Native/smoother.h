@@ -0,0 +1,233 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// smoother.h: parameter smoothing shared by the Point plugins.
+// A Smoother moves from its current value to a new target over a ramp given in
+// milliseconds. The curve is a compile-time policy:
+//
+//   SmoothLinear       constant step, exact at the end of the ramp
+//   SmoothOnePole      one-pole lowpass, -60 dB from the target by the end
+//   SmoothExponential  constant ratio, for strictly positive values such as levels
+//
+// Per block a plugin asks how many frames still ramp, has the ramp written as a
+// curve once (SIMD), and runs the rest of the block at the settled value, so a
+// steady block never touches the curve at all.
+
+#pragma once
+
+#ifndef __SMOOTHER_H__
+#define __SMOOTHER_H__
+
+#include <math.h>
+
+#include "simd.h"
+
+// longest ramp in samples; sizes the curve arrays the plugins keep on the stack
+#define SMOOTHER_MAX_RAMP 1024
+// SmoothOnePole decays by this many time constants over a ramp (~ -60 dB)
+#define SMOOTHER_ONEPOLE_TIME_CONSTANTS 6.9f
+// SmoothExponential treats values below this (-80 dB) as this
+#define SMOOTHER_EXPONENTIAL_FLOOR 1e-4f
+
+struct SmoothLinear
+{
+	static float coefficient(float from, float to, unsigned int length)
+	{
+		return (to - from) / length;
+	}
+	// curve[k] = value + coeff * (k + 1)
+	static void fill(float* curve, unsigned int count, float value, float /*target*/, float coeff)
+	{
+		vfloat v = simd_ramp(value + coeff, coeff);
+		vfloat step = simd_set1(coeff * POINT_SIMD_WIDTH);
+
+		unsigned int i = 0;
+		for (; i + POINT_SIMD_WIDTH <= count; i += POINT_SIMD_WIDTH)
+		{
+			simd_store(curve + i, v);
+			v = simd_add(v, step);
+		}
+		for (; i < count; i++)
+		{
+			curve[i] = value + coeff * (i + 1);
+		}
+	}
+	static float advance(float value, float /*target*/, float coeff, unsigned int count)
+	{
+		return value + coeff * count;
+	}
+};
+
+struct SmoothOnePole
+{
+	static float coefficient(float /*from*/, float /*to*/, unsigned int length)
+	{
+		return expf(-SMOOTHER_ONEPOLE_TIME_CONSTANTS / length);
+	}
+	// curve[k] = target + (value - target) * coeff^(k + 1)
+	static void fill(float* curve, unsigned int count, float value, float target, float coeff)
+	{
+		float powers[POINT_SIMD_WIDTH];
+		float power = coeff;
+		for (int lane = 0; lane < POINT_SIMD_WIDTH; lane++)
+		{
+			powers[lane] = power;
+			power *= coeff;
+		}
+
+		float offset = value - target;
+		vfloat vtarget = simd_set1(target);
+		vfloat v = simd_mul(simd_load(powers), simd_set1(offset));
+		vfloat step = simd_set1(powers[POINT_SIMD_WIDTH - 1]);
+
+		unsigned int i = 0;
+		for (; i + POINT_SIMD_WIDTH <= count; i += POINT_SIMD_WIDTH)
+		{
+			simd_store(curve + i, simd_add(v, vtarget));
+			v = simd_mul(v, step);
+		}
+		offset *= powf(coeff, (float)i);
+		for (; i < count; i++)
+		{
+			offset *= coeff;
+			curve[i] = target + offset;
+		}
+	}
+	static float advance(float value, float target, float coeff, unsigned int count)
+	{
+		return target + (value - target) * powf(coeff, (float)count);
+	}
+};
+
+struct SmoothExponential
+{
+	static float coefficient(float from, float to, unsigned int length)
+	{
+		from = from < SMOOTHER_EXPONENTIAL_FLOOR ? SMOOTHER_EXPONENTIAL_FLOOR : from;
+		to = to < SMOOTHER_EXPONENTIAL_FLOOR ? SMOOTHER_EXPONENTIAL_FLOOR : to;
+		return powf(to / from, 1.0f / length);
+	}
+	// curve[k] = value * coeff^(k + 1)
+	static void fill(float* curve, unsigned int count, float value, float /*target*/, float coeff)
+	{
+		value = value < SMOOTHER_EXPONENTIAL_FLOOR ? SMOOTHER_EXPONENTIAL_FLOOR : value;
+
+		float powers[POINT_SIMD_WIDTH];
+		float power = coeff;
+		for (int lane = 0; lane < POINT_SIMD_WIDTH; lane++)
+		{
+			powers[lane] = power;
+			power *= coeff;
+		}
+
+		vfloat v = simd_mul(simd_load(powers), simd_set1(value));
+		vfloat step = simd_set1(powers[POINT_SIMD_WIDTH - 1]);
+
+		unsigned int i = 0;
+		for (; i + POINT_SIMD_WIDTH <= count; i += POINT_SIMD_WIDTH)
+		{
+			simd_store(curve + i, v);
+			v = simd_mul(v, step);
+		}
+		value *= powf(coeff, (float)i);
+		for (; i < count; i++)
+		{
+			value *= coeff;
+			curve[i] = value;
+		}
+	}
+	static float advance(float value, float /*target*/, float coeff, unsigned int count)
+	{
+		value = value < SMOOTHER_EXPONENTIAL_FLOOR ? SMOOTHER_EXPONENTIAL_FLOOR : value;
+		return value * powf(coeff, (float)count);
+	}
+};
+
+template<typename Policy>
+class Smoother
+{
+public:
+	// Settles at `value` with ramps of `ms` milliseconds.
+	void init(float value, float ms, int samplerate)
+	{
+		m_value = value;
+		m_target = value;
+		m_coeff = 0;
+		m_left = 0;
+		setLength(ms, samplerate);
+	}
+	void setLength(float ms, int samplerate)
+	{
+		unsigned int length = (unsigned int)(ms * .001f * samplerate + .5f);
+		m_length = length < 1 ? 1 : (SMOOTHER_MAX_RAMP < length ? SMOOTHER_MAX_RAMP : length);
+	}
+
+	// Ramps from the current value to `target`.
+	void setTarget(float target)
+	{
+		m_target = target;
+		m_left = m_value == target ? 0 : m_length;
+		if (m_left) {
+			m_coeff = Policy::coefficient(m_value, target, m_length);
+		}
+	}
+	// Jumps to the target, ending any ramp.
+	void snap()
+	{
+		m_value = m_target;
+		m_left = 0;
+	}
+
+	float value() const { return m_value; }
+	float target() const { return m_target; }
+
+	// Frames of the next `length` that still ramp; never more than SMOOTHER_MAX_RAMP.
+	unsigned int pending(unsigned int length) const
+	{
+		return m_left < length ? m_left : length;
+	}
+
+	// Writes the next `count` values to curve and consumes them. Frames past the
+	// end of the ramp read the target.
+	void fill(float* curve, unsigned int count)
+	{
+		unsigned int ramp = pending(count);
+		if (ramp) {
+			Policy::fill(curve, ramp, m_value, m_target, m_coeff);
+		}
+		for (unsigned int i = ramp; i < count; i++)
+		{
+			curve[i] = m_target;
+		}
+		skip(count);
+	}
+	// Consumes `count` frames.
+	void skip(unsigned int count)
+	{
+		unsigned int ramp = pending(count);
+		m_left -= ramp;
+		m_value = m_left ? Policy::advance(m_value, m_target, m_coeff, ramp) : m_target;
+	}
+
+private:
+	float m_value;
+	float m_target;
+	float m_coeff;
+	unsigned int m_left;
+	unsigned int m_length;
+};
+
+#endif // !__SMOOTHER_H__
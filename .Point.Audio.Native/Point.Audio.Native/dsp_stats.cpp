@@ -0,0 +1,91 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// dsp_stats.cpp: the Point DSP statistics and memory tables, re-exported from
+// here so that the Unity side polls them through this library. The instances
+// and their counters live in Point.Audio.FMOD.Native, which FMOD loads as a
+// plugin; the calls below find it among the loaded modules every time, so they
+// simply report no instances while it is not loaded, and never hold on to a
+// library FMOD may unload. See Point.Audio.FMOD.Native/dsp_stats.h and
+// dsp_memory.h for the row layouts.
+
+#include "pch.h"
+#include "../Point.Audio.FMOD.Native/dsp_stats.h"
+#include "../Point.Audio.FMOD.Native/dsp_memory.h"
+
+#define POINT_FMOD_PLUGIN_MODULE L"Point.Audio.FMOD.Native.dll"
+
+typedef int (*PointDSP_GetStats_Func)(DSPStatsSnapshot* table, int capacity);
+typedef void (*PointDSP_ResetStats_Func)();
+typedef void (*PointDSP_SetStatsBudget_Func)(float share);
+typedef int (*PointDSP_GetMemory_Func)(DSPMemorySnapshot* table, int capacity);
+typedef void (*PointDSP_ResetMemoryPeaks_Func)();
+
+static FARPROC Point_FindPluginExport(const char* name)
+{
+	HMODULE module = GetModuleHandleW(POINT_FMOD_PLUGIN_MODULE);
+	if (!module) {
+		return 0;
+	}
+	return GetProcAddress(module, name);
+}
+
+// Fills `table` with up to `capacity` rows, one per live Point DSP instance, and
+// returns the number of live instances; a null table only counts them.
+DLLEXPORT int Point_GetDSPStats(DSPStatsSnapshot* table, int capacity)
+{
+	PointDSP_GetStats_Func func = TYPECAST(PointDSP_GetStats_Func, Point_FindPluginExport("PointDSP_GetStats"));
+	if (!func) {
+		return 0;
+	}
+	return func(table, capacity);
+}
+// Clears every instance's counters with its next block.
+DLLEXPORT void Point_ResetDSPStats()
+{
+	PointDSP_ResetStats_Func func = TYPECAST(PointDSP_ResetStats_Func, Point_FindPluginExport("PointDSP_ResetStats"));
+	if (func) {
+		func();
+	}
+}
+// Share of a block's duration one instance may take before it counts as over budget.
+DLLEXPORT void Point_SetDSPStatsBudget(float share)
+{
+	PointDSP_SetStatsBudget_Func func = TYPECAST(PointDSP_SetStatsBudget_Func, Point_FindPluginExport("PointDSP_SetStatsBudget"));
+	if (func) {
+		func(share);
+	}
+}
+
+// Fills `table` with up to `capacity` rows, one per Point DSP type, one for the
+// pool's arenas and one per live instance, and returns the number of rows; a
+// null table only counts them.
+DLLEXPORT int Point_GetDSPMemory(DSPMemorySnapshot* table, int capacity)
+{
+	PointDSP_GetMemory_Func func = TYPECAST(PointDSP_GetMemory_Func, Point_FindPluginExport("PointDSP_GetMemory"));
+	if (!func) {
+		return 0;
+	}
+	return func(table, capacity);
+}
+// Moves every high-water mark down to the bytes live now.
+DLLEXPORT void Point_ResetDSPMemoryPeaks()
+{
+	PointDSP_ResetMemoryPeaks_Func func = TYPECAST(PointDSP_ResetMemoryPeaks_Func, Point_FindPluginExport("PointDSP_ResetMemoryPeaks"));
+	if (func) {
+		func();
+	}
+}
@@ -0,0 +1,312 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "pch.h"
+#include "effect_chain.h"
+#include "../Point.Audio.FMOD.Native/simd.h"
+
+// set in EffectChain::m_middle next to the slot index
+#define EFFECT_CHAIN_FRESH 4u
+#define EFFECT_CHAIN_SLOT 3u
+
+#pragma region Helpers
+
+// data[k] *= gain
+static void EffectChain_Scale(float* data, unsigned int count, float gain)
+{
+	vfloat g = simd_set1(gain);
+	unsigned int k = 0;
+	for (; k + POINT_SIMD_WIDTH <= count; k += POINT_SIMD_WIDTH)
+	{
+		simd_store(data + k, simd_mul(simd_load(data + k), g));
+	}
+	for (; k < count; k++)
+	{
+		data[k] *= gain;
+	}
+}
+
+// data[f * channels + c] *= gains[f]
+static void EffectChain_ScaleFrames(float* data, const float* gains, int frames, int channels)
+{
+	if (channels == 1) {
+		unsigned int k = 0;
+		for (; k + POINT_SIMD_WIDTH <= (unsigned int)frames; k += POINT_SIMD_WIDTH)
+		{
+			simd_store(data + k, simd_mul(simd_load(data + k), simd_load(gains + k)));
+		}
+		for (; k < (unsigned int)frames; k++)
+		{
+			data[k] *= gains[k];
+		}
+		return;
+	}
+	for (int f = 0; f < frames; f++)
+	{
+		float gain = gains[f];
+		for (int c = 0; c < channels; c++)
+		{
+			data[f * channels + c] *= gain;
+		}
+	}
+}
+
+#pragma endregion
+
+#pragma region EffectChain
+
+EffectChain::EffectChain()
+{
+	memset(m_slots, 0, sizeof(m_slots));
+	memset(m_points, 0, sizeof(m_points));
+	memset(m_pointCapacity, 0, sizeof(m_pointCapacity));
+	memset(m_states, 0, sizeof(m_states));
+	m_back = 0;
+	m_middle.store(1, std::memory_order_relaxed);
+	m_front = 2;
+}
+EffectChain::~EffectChain()
+{
+	for (int i = 0; i < 3; i++)
+	{
+		free(m_points[i]);
+	}
+}
+
+int EffectChain::submit(const EffectStage* stages, int count)
+{
+	if (!stages || count < 0) {
+		count = 0;
+	}
+	if (count > EFFECT_CHAIN_MAX_STAGES) {
+		count = EFFECT_CHAIN_MAX_STAGES;
+	}
+
+	// The back slot is not read by the audio thread, so its breakpoints can
+	// be reallocated here.
+	int pointCount = 0;
+	for (int i = 0; i < count; i++)
+	{
+		if (stages[i].type == EFFECT_STAGE_ENVELOPE && 0 < stages[i].pointCount) {
+			pointCount += stages[i].pointCount;
+		}
+	}
+	if (m_pointCapacity[m_back] < pointCount) {
+		EnvelopePoint* points = (EnvelopePoint*)malloc(sizeof(EnvelopePoint) * pointCount);
+		if (points) {
+			free(m_points[m_back]);
+			m_points[m_back] = points;
+			m_pointCapacity[m_back] = pointCount;
+		}
+	}
+
+	EffectChainConfig& config = m_slots[m_back];
+	EnvelopePoint* points = m_points[m_back];
+	int pointsLeft = m_pointCapacity[m_back];
+	int taken = 0;
+	for (; taken < count; taken++)
+	{
+		EffectStage& stage = config.stages[taken];
+		stage = stages[taken];
+		if (stage.type != EFFECT_STAGE_ENVELOPE) {
+			continue;
+		}
+		if (!stage.points || stage.pointCount < 0) {
+			stage.pointCount = 0;
+		}
+		if (pointsLeft < stage.pointCount) {
+			break;
+		}
+		if (stage.pointCount) {
+			memcpy(points, stage.points, sizeof(EnvelopePoint) * stage.pointCount);
+		}
+		stage.points = points;
+		points += stage.pointCount;
+		pointsLeft -= stage.pointCount;
+	}
+	count = taken;
+	config.stageCount = count;
+	// the slot the audio thread has not taken, or has given back, is ours to fill next
+	m_back = m_middle.exchange(m_back | EFFECT_CHAIN_FRESH, std::memory_order_acq_rel) & EFFECT_CHAIN_SLOT;
+	return count;
+}
+
+void EffectChain::update()
+{
+	if (!(m_middle.load(std::memory_order_relaxed) & EFFECT_CHAIN_FRESH)) {
+		return;
+	}
+	m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & EFFECT_CHAIN_SLOT;
+
+	const EffectChainConfig& config = m_slots[m_front];
+	for (int i = 0; i < config.stageCount; i++)
+	{
+		const EffectStage& stage = config.stages[i];
+		State& state = m_states[i];
+		if (state.type != stage.type) {
+			// a new stage starts at its values, with nothing held
+			memset(&state, 0, sizeof(State));
+			state.type = stage.type;
+			state.gain = stage.gain;
+			state.mix = stage.mix;
+			continue;
+		}
+		if (state.gain != stage.gain || state.mix != stage.mix) {
+			state.gainStep = (stage.gain - state.gain) / EFFECT_CHAIN_RAMP_LENGTH;
+			state.mixStep = (stage.mix - state.mix) / EFFECT_CHAIN_RAMP_LENGTH;
+			state.ramp = EFFECT_CHAIN_RAMP_LENGTH;
+		}
+	}
+	for (int i = config.stageCount; i < EFFECT_CHAIN_MAX_STAGES; i++)
+	{
+		m_states[i].type = EFFECT_STAGE_NONE;
+	}
+}
+
+void EffectChain::process(float* data, int frames, int channels, int position)
+{
+	update();
+	if (!data || frames <= 0 || channels <= 0) {
+		return;
+	}
+
+	const EffectChainConfig& config = m_slots[m_front];
+	for (int i = 0; i < config.stageCount; i++)
+	{
+		const EffectStage& stage = config.stages[i];
+		switch (stage.type)
+		{
+		case EFFECT_STAGE_GAIN:
+			processGain(m_states[i], stage, data, frames, channels);
+			break;
+		case EFFECT_STAGE_ENVELOPE:
+			processEnvelope(stage, data, frames, channels, position);
+			break;
+		case EFFECT_STAGE_DOWNSAMPLER:
+			processDownsampler(m_states[i], stage, data, frames, channels);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void EffectChain::processGain(State& state, const EffectStage& stage, float* data, int frames, int channels)
+{
+	int frame = 0;
+	if (state.ramp) {
+		float gains[EFFECT_CHAIN_RAMP_LENGTH];
+		int count = frames < (int)state.ramp ? frames : (int)state.ramp;
+		for (int f = 0; f < count; f++)
+		{
+			state.gain += state.gainStep;
+			gains[f] = state.gain;
+		}
+		state.ramp -= count;
+		if (!state.ramp) {
+			state.gain = stage.gain;
+			state.mix = stage.mix;
+		}
+		EffectChain_ScaleFrames(data, gains, count, channels);
+		frame = count;
+	}
+	if (frame < frames) {
+		EffectChain_Scale(data + frame * channels, (unsigned int)((frames - frame) * channels), state.gain);
+	}
+}
+
+void EffectChain::processEnvelope(const EffectStage& stage, float* data, int frames, int channels, int position)
+{
+	float gains[EFFECT_CHAIN_BLOCK_LENGTH];
+	for (int frame = 0; frame < frames; frame += EFFECT_CHAIN_BLOCK_LENGTH)
+	{
+		int count = frames - frame < EFFECT_CHAIN_BLOCK_LENGTH ? frames - frame : EFFECT_CHAIN_BLOCK_LENGTH;
+		Envelope_Evaluate(stage.points, stage.pointCount, stage.length, position + frame, gains, count);
+		EffectChain_ScaleFrames(data + frame * channels, gains, count, channels);
+	}
+}
+
+void EffectChain::processDownsampler(State& state, const EffectStage& stage, float* data, int frames, int channels)
+{
+	unsigned int sampleCount = 0 < stage.sampleCount ? (unsigned int)stage.sampleCount : 1;
+	int held = channels < EFFECT_CHAIN_MAX_CHANNELS ? channels : EFFECT_CHAIN_MAX_CHANNELS;
+	unsigned int phase = state.phase < sampleCount ? state.phase : 0;
+
+	for (int f = 0; f < frames; f++)
+	{
+		if (state.ramp) {
+			state.gain += state.gainStep;
+			state.mix += state.mixStep;
+			if (!--state.ramp) {
+				state.gain = stage.gain;
+				state.mix = stage.mix;
+			}
+		}
+
+		float* frame = data + f * channels;
+		if (phase == 0) {
+			memcpy(state.held, frame, sizeof(float) * held);
+		}
+		for (int c = 0; c < held; c++)
+		{
+			frame[c] = MIX(state.held[c], frame[c], state.mix) * state.gain;
+		}
+		for (int c = held; c < channels; c++)
+		{
+			frame[c] *= state.gain;
+		}
+
+		if (++phase == sampleCount) {
+			phase = 0;
+		}
+	}
+	state.phase = phase;
+}
+
+#pragma endregion
+
+#pragma region Exports
+
+// A chain with no stages; release it with Point_ReleaseEffectChain once the
+// audio thread no longer processes it.
+DLLEXPORT EffectChain* Point_CreateEffectChain()
+{
+	return new EffectChain();
+}
+DLLEXPORT void Point_ReleaseEffectChain(EffectChain* chain)
+{
+	delete chain;
+}
+// Replaces the chain's stages from its next block on; returns the number of
+// stages taken, at most EFFECT_CHAIN_MAX_STAGES. Never blocks.
+DLLEXPORT int Point_SubmitEffectChain(EffectChain* chain, const EffectStage* stages, int count)
+{
+	if (!chain) {
+		return 0;
+	}
+	return chain->submit(stages, count);
+}
+// Runs the chain in place over frames interleaved frames of data; position is
+// the clip frame of the first, for the envelope stages.
+DLLEXPORT void Point_ProcessEffectChain(EffectChain* chain, float* data, int frames, int channels, int position)
+{
+	if (chain) {
+		chain->process(data, frames, channels, position);
+	}
+}
+
+#pragma endregion
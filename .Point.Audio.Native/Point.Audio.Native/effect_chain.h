@@ -0,0 +1,129 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// effect_chain.h: a chain of effects run in place on the buffer of Unity's
+// OnAudioFilterRead, so that the Unity backend's per-sample work happens here
+// instead of in managed code. Managed code owns the configuration: it writes a
+// whole chain with Point_SubmitEffectChain, which never blocks, and the audio
+// thread picks the latest one up at the start of its next block. Between the
+// two sits a triple buffer, so neither side waits on or allocates for the other.
+// Submitting is meant for one thread at a time, processing for another.
+
+#pragma once
+
+#ifndef __EFFECT_CHAIN_H__
+#define __EFFECT_CHAIN_H__
+
+#include <atomic>
+
+#include "envelope.h"
+
+#define EFFECT_CHAIN_MAX_STAGES 8
+// channels the downsampler holds values for, 7.1; any above are only scaled by gain
+#define EFFECT_CHAIN_MAX_CHANNELS 8
+// frames a gain or mix change is ramped over, as in the managed DownSampler
+#define EFFECT_CHAIN_RAMP_LENGTH 256
+// frames of gains evaluated into the stack per step
+#define EFFECT_CHAIN_BLOCK_LENGTH 256
+
+enum EffectStageType
+{
+	EFFECT_STAGE_NONE = 0,
+	// data *= gain
+	EFFECT_STAGE_GAIN,
+	// data *= the envelope at the clip position, see envelope.h
+	EFFECT_STAGE_ENVELOPE,
+	// Point.Audio.LowLevel.DownSampler: every channel holds its value at the
+	// start of each window of sampleCount frames, mixed with the input by mix,
+	// then scaled by gain; windows carry over from block to block
+	EFFECT_STAGE_DOWNSAMPLER,
+};
+
+// One stage as managed code submits it; plain C layout, mirrored by
+// Point.Audio.LowLevel.NativeEffectChain.Stage. Fields a type does not use are ignored.
+struct EffectStage
+{
+	int type;
+	// GAIN, DOWNSAMPLER: linear output gain
+	float gain;
+	// DOWNSAMPLER: 0 = input only, 1 = held values only
+	float mix;
+	// DOWNSAMPLER: frames each held value lasts
+	int sampleCount;
+	// ENVELOPE: breakpoints, copied by submit; the caller's array may change
+	// or go once submit returns
+	const EnvelopePoint* points;
+	int pointCount;
+	// ENVELOPE: clip length in frames
+	int length;
+};
+
+struct EffectChainConfig
+{
+	int stageCount;
+	EffectStage stages[EFFECT_CHAIN_MAX_STAGES];
+};
+
+class EffectChain
+{
+public:
+	EffectChain();
+	~EffectChain();
+
+	// Copies up to EFFECT_CHAIN_MAX_STAGES stages and their breakpoints and
+	// publishes them; returns the number taken, fewer when the breakpoints do
+	// not fit in memory. A chain submitted before the audio thread took the
+	// previous one replaces it.
+	int submit(const EffectStage* stages, int count);
+	// data holds frames interleaved frames; position is the clip frame of the first
+	void process(float* data, int frames, int channels, int position);
+
+private:
+	// Audio thread state of one stage, kept while the stage keeps its type.
+	struct State
+	{
+		int type;
+		float gain;
+		float mix;
+		float gainStep;
+		float mixStep;
+		unsigned int ramp;
+		unsigned int phase;
+		float held[EFFECT_CHAIN_MAX_CHANNELS];
+	};
+
+	// takes the latest submitted chain and ramps every stage to its values
+	void update();
+
+	void processGain(State& state, const EffectStage& stage, float* data, int frames, int channels);
+	void processEnvelope(const EffectStage& stage, float* data, int frames, int channels, int position);
+	void processDownsampler(State& state, const EffectStage& stage, float* data, int frames, int channels);
+
+	EffectChainConfig m_slots[3];
+	// breakpoints of each slot's envelope stages, owned by whichever side owns the slot
+	EnvelopePoint* m_points[3];
+	int m_pointCapacity[3];
+	// slot between the two sides, and EFFECT_CHAIN_FRESH while it holds a
+	// chain the audio thread has not taken yet
+	std::atomic<unsigned int> m_middle;
+	// submit side
+	unsigned int m_back;
+	// audio thread side
+	unsigned int m_front;
+	State m_states[EFFECT_CHAIN_MAX_STAGES];
+};
+
+#endif
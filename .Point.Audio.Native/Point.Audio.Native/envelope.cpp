@@ -0,0 +1,152 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "pch.h"
+#include "envelope.h"
+#include "../Point.Audio.FMOD.Native/simd.h"
+
+#pragma region Envelope
+
+// Node 0 is (0, 0), nodes 1 .. pointCount are the breakpoints and node
+// pointCount + 1 is (length, 0).
+static inline int Envelope_Position(const EnvelopePoint* points, int pointCount, int length, int node)
+{
+	if (node == 0) {
+		return 0;
+	}
+	return node <= pointCount ? points[node - 1].position : length;
+}
+static inline float Envelope_Value(const EnvelopePoint* points, int pointCount, int node)
+{
+	return 0 < node && node <= pointCount ? points[node - 1].value : 0;
+}
+
+// number of breakpoints at or before frame, which is the node the segment
+// holding frame starts at
+static int Envelope_Find(const EnvelopePoint* points, int pointCount, int frame)
+{
+	int low = 0, high = pointCount;
+	while (low < high)
+	{
+		int middle = (low + high) / 2;
+		if (points[middle].position <= frame) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+// gains[k] = start + step * k for k < count; every vector starts again from
+// start, so long segments do not accumulate rounding
+static void Envelope_Ramp(float* gains, unsigned int count, float start, float step)
+{
+	unsigned int k = 0;
+	for (; k + POINT_SIMD_WIDTH <= count; k += POINT_SIMD_WIDTH)
+	{
+		simd_store(gains + k, simd_ramp(start + step * k, step));
+	}
+	for (; k < count; k++)
+	{
+		gains[k] = start + step * k;
+	}
+}
+
+void Envelope_Evaluate(const EnvelopePoint* points, int pointCount, int length, int start, float* gains, int count)
+{
+	if (!gains || count <= 0) {
+		return;
+	}
+	if (!points || pointCount < 0) {
+		pointCount = 0;
+	}
+
+	int frame = start;
+	int end = start + count;
+	// before the clip
+	if (frame < 0) {
+		int stop = end < 0 ? end : 0;
+		memset(gains, 0, sizeof(float) * (stop - frame));
+		frame = stop;
+	}
+
+	int node = frame < end ? Envelope_Find(points, pointCount, frame) : 0;
+	while (frame < end)
+	{
+		if (length <= frame) {
+			// past the clip
+			memset(gains + (frame - start), 0, sizeof(float) * (end - frame));
+			break;
+		}
+
+		int to = Envelope_Position(points, pointCount, length, node + 1);
+		if (to <= frame) {
+			// a step, or a breakpoint past the end of the clip
+			node++;
+			continue;
+		}
+		int from = Envelope_Position(points, pointCount, length, node);
+		int stop = to < end ? to : end;
+		if (length < stop) {
+			stop = length;
+		}
+
+		float value = Envelope_Value(points, pointCount, node);
+		float step = (Envelope_Value(points, pointCount, node + 1) - value) / (float)(to - from);
+		Envelope_Ramp(gains + (frame - start), (unsigned int)(stop - frame), value + step * (float)(frame - from), step);
+		frame = stop;
+	}
+}
+
+#pragma endregion
+
+#pragma region Exports
+
+// gains[k] = the envelope at frame start + k for k < count; see envelope.h.
+DLLEXPORT void Point_EvaluateEnvelope(const EnvelopePoint* points, int pointCount, int length, int start, float* gains, int count)
+{
+	Envelope_Evaluate(points, pointCount, length, start, gains, count);
+}
+// data[f * channels + c] *= the envelope at frame start + f for f < frames, in
+// place and a block at a time, so that the caller needs no buffer of gains.
+DLLEXPORT void Point_ApplyEnvelope(const EnvelopePoint* points, int pointCount, int length, int start, float* data, int frames, int channels)
+{
+	if (!data || channels <= 0) {
+		return;
+	}
+
+	float gains[ENVELOPE_BLOCK_LENGTH];
+	for (int frame = 0; frame < frames; frame += ENVELOPE_BLOCK_LENGTH)
+	{
+		int count = frames - frame < ENVELOPE_BLOCK_LENGTH ? frames - frame : ENVELOPE_BLOCK_LENGTH;
+		Envelope_Evaluate(points, pointCount, length, start + frame, gains, count);
+
+		float* block = data + (size_t)frame * channels;
+		for (int f = 0; f < count; f++)
+		{
+			float gain = gains[f];
+			for (int c = 0; c < channels; c++)
+			{
+				block[f * channels + c] *= gain;
+			}
+		}
+	}
+}
+
+#pragma endregion
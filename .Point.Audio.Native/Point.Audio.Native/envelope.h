@@ -0,0 +1,45 @@
+// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+// envelope.h: streaming evaluation of the breakpoint envelopes Point.Audio
+// stores per clip (AudioSample[] in Unity). An envelope is the polyline through
+// (0, 0), the breakpoints in order of position and (length, 0), where length is
+// the clip length in frames; frames at or past length are silent. Only the
+// block asked for is evaluated, so the cost is O(breakpoints) in memory and
+// O(log breakpoints + block) in time whatever the clip length.
+
+#pragma once
+
+#ifndef __ENVELOPE_H__
+#define __ENVELOPE_H__
+
+// frames one Point_ApplyEnvelope step evaluates into the stack
+#define ENVELOPE_BLOCK_LENGTH 256
+
+// One breakpoint; the layout of Point.Audio.AudioSample, so that an
+// AudioSample[] is passed as is.
+struct EnvelopePoint
+{
+	// frame of the clip
+	int position;
+	float value;
+};
+
+// gains[k] = the envelope at frame start + k, for k < count.
+// Breakpoints must be sorted by position; two at the same position make a step.
+void Envelope_Evaluate(const EnvelopePoint* points, int pointCount, int length, int start, float* gains, int count);
+
+#endif
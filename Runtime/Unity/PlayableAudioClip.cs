@@ -35,9 +35,10 @@ namespace Point.Audio
 
         [SerializeField] private int m_TargetChannels;
         [SerializeField] private AudioSample[] m_Volumes = Array.Empty<AudioSample>();
+        // run in order after the volume envelope
+        [SerializeReference] private SignalProcessor[] m_Processors = Array.Empty<SignalProcessor>();
 
         private Promise<AudioClip> m_AudioClip;
-        private Promise<AudioSample[]> m_EvaluatedVolumes;
 
         public AudioKey Key => m_Clip;
         public int TargetChannels => m_TargetChannels;
@@ -50,19 +51,30 @@ namespace Point.Audio
             }
             return m_AudioClip;
         }
-        internal Promise<AudioSample[]> GetVolumes()
+        /// <summary>
+        /// Replaces the stages of <paramref name="chain"/> with this clip's effects, which then
+        /// stand in for <see cref="ISignalProcessor.Process"/>. Returns false if there is no clip to play yet,
+        /// or if a processor has no native stage or does not fit; the managed processors run then.
+        /// </summary>
+        internal bool BuildEffectChain(NativeEffectChain chain)
         {
-            if (m_EvaluatedVolumes == null)
+            if (m_AudioClip == null || !m_AudioClip.HasValue) return false;
+
+            chain.Clear();
+            chain.AddEnvelope(m_Volumes, m_AudioClip.Value.samples);
+            for (int i = 0; i < m_Processors.Length; i++)
             {
-                Promise<AudioClip> clip = GetAudioClip();
-                m_EvaluatedVolumes = new Promise<AudioSample[]>();
-                clip.OnCompleted += delegate (AudioClip clip)
+                if (m_Processors[i] == null) continue;
+                if (chain.StageCount >= NativeEffectChain.MaxStages) return false;
+
+                if (m_Processors[i] is DownSampler downSampler)
                 {
-                    AudioSample[] volumes = DSP.Evaluate(clip, m_Volumes);
-                    m_EvaluatedVolumes.SetValue(volumes);
-                };
+                    chain.Add(downSampler);
+                }
+                else return false;
             }
-            return m_EvaluatedVolumes;
+            chain.Submit();
+            return true;
         }
 
         public bool IsValid() => !m_Clip.IsEmpty();
@@ -70,20 +82,36 @@ namespace Point.Audio
         void ISignalProcessor.OnInitialize(SignalProcessData data)
         {
             GetAudioClip();
-            GetVolumes();
+            for (int i = 0; i < m_Processors.Length; i++)
+            {
+                ((ISignalProcessor)m_Processors[i])?.OnInitialize(data);
+            }
         }
-        bool ISignalProcessor.CanProcess() => m_AudioClip.HasValue && m_EvaluatedVolumes.HasValue;
+        bool ISignalProcessor.CanProcess() => m_AudioClip.HasValue;
         AudioClip IRootSignalProcessor.GetRootClip() => m_AudioClip.Value;
         int IRootSignalProcessor.GetTargetSamples() => m_AudioClip.Value.samples;
         void ISignalProcessor.BeforeProcess(RuntimeSignalProcessData processData)
         {
+            for (int i = 0; i < m_Processors.Length; i++)
+            {
+                ((ISignalProcessor)m_Processors[i])?.BeforeProcess(processData);
+            }
         }
         void ISignalProcessor.Process(RuntimeSignalProcessData processData, float[] data, int channels)
         {
             // Processors
             {
-                // Process Volume
-                DSP.Volume(data, channels, m_EvaluatedVolumes.Value, TargetChannels, processData.currentSamplePosition, processData.nextSamplePositionOffset);
+                // Process Volume, evaluated for this block only
+                DSP.ApplyEnvelope(data, channels, m_Volumes, m_AudioClip.Value.samples,
+                    processData.currentSamplePosition, processData.nextSamplePositionOffset);
+
+                for (int i = 0; i < m_Processors.Length; i++)
+                {
+                    ISignalProcessor processor = m_Processors[i];
+                    if (processor == null || !processor.CanProcess()) continue;
+
+                    processor.Process(processData, data, channels);
+                }
             }
         }
     }
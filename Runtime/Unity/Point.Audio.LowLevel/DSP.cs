@@ -20,6 +20,7 @@
 using Point.Collections;
 using System;
 using System.Collections.Generic;
+using System.Runtime.InteropServices;
 using Unity.Burst;
 using Unity.Mathematics;
 using UnityEngine;
@@ -32,6 +33,21 @@ namespace Point.Audio.LowLevel
     {
         public delegate float AudioSampleProcessDelegate(float value, AudioSample sample);
 
+        // frames of envelope evaluated at a time, as ENVELOPE_BLOCK_LENGTH in envelope.h
+        private const int c_EnvelopeBlockLength = 256;
+
+#if UNITY_STANDALONE_WIN || UNITY_EDITOR_WIN
+        private const string c_NativeLibrary = "Point.Audio.Native";
+
+        // See .Point.Audio.Native/Point.Audio.Native/envelope.h
+        [DllImport(c_NativeLibrary)]
+        private static extern unsafe void Point_EvaluateEnvelope(
+            AudioSample* points, int pointCount, int length, int start, float* gains, int count);
+        [DllImport(c_NativeLibrary)]
+        private static extern unsafe void Point_ApplyEnvelope(
+            AudioSample* points, int pointCount, int length, int start, float* data, int frames, int channels);
+#endif
+
         [BurstCompile(CompileSynchronously = true)]
         public static class Function
         {
@@ -89,8 +105,91 @@ namespace Point.Audio.LowLevel
             }
 
             public static float Multiply(float value, AudioSample sample) => value * sample.value;
+
+            // Managed twin of Envelope_Evaluate in Point.Audio.Native, for the
+            // platforms the library is not built for.
+            internal static unsafe void impl_evaluateEnvelope(
+                AudioSample* points, int pointCount, int length, int start, float* gains, int count)
+            {
+                for (int k = 0, node = 0; k < count; k++)
+                {
+                    int frame = start + k;
+                    if (frame < 0 || length <= frame)
+                    {
+                        gains[k] = 0;
+                        continue;
+                    }
+
+                    // the segment holding frame runs from node to node + 1
+                    while (node < pointCount && points[node].position <= frame) node++;
+
+                    int from = node == 0 ? 0 : points[node - 1].position,
+                        to = node < pointCount ? points[node].position : length;
+                    float
+                        fromValue = node == 0 ? 0 : points[node - 1].value,
+                        toValue = node < pointCount ? points[node].value : 0;
+
+                    gains[k] = lerp(fromValue, toValue, (frame - from) / (float)(to - from));
+                }
+            }
+        }
+
+        /// <summary>
+        /// Fills <paramref name="gains"/>[0 .. count) with the envelope through (0, 0),
+        /// <paramref name="points"/> and (<paramref name="length"/>, 0) at frames
+        /// <paramref name="start"/> .. start + count, without evaluating the rest of the clip.
+        /// </summary>
+        public static unsafe void EvaluateEnvelope(AudioSample[] points, int length, int start, float[] gains, int count)
+        {
+#if DEBUG_MODE
+            Assert.IsTrue(count <= gains.Length);
+#endif
+            fixed (AudioSample* pointsPtr = points)
+            fixed (float* gainsPtr = gains)
+            {
+#if UNITY_STANDALONE_WIN || UNITY_EDITOR_WIN
+                Point_EvaluateEnvelope(pointsPtr, points.Length, length, start, gainsPtr, count);
+#else
+                Function.impl_evaluateEnvelope(pointsPtr, points.Length, length, start, gainsPtr, count);
+#endif
+            }
+        }
+        /// <summary>
+        /// Multiplies the interleaved <paramref name="data"/> in place by the envelope
+        /// at frames <paramref name="start"/> .. start + frames. See <see cref="EvaluateEnvelope"/>.
+        /// </summary>
+        public static unsafe void ApplyEnvelope(float[] data, int channels, AudioSample[] points, int length, int start, int frames)
+        {
+#if DEBUG_MODE
+            Assert.IsTrue(frames * channels <= data.Length);
+#endif
+            fixed (AudioSample* pointsPtr = points)
+            fixed (float* dataPtr = data)
+            {
+#if UNITY_STANDALONE_WIN || UNITY_EDITOR_WIN
+                Point_ApplyEnvelope(pointsPtr, points.Length, length, start, dataPtr, frames, channels);
+#else
+                float* gains = stackalloc float[c_EnvelopeBlockLength];
+                for (int block = 0; block < frames; block += c_EnvelopeBlockLength)
+                {
+                    int count = min(c_EnvelopeBlockLength, frames - block);
+                    Function.impl_evaluateEnvelope(pointsPtr, points.Length, length, start + block, gains, count);
+
+                    float* blockPtr = dataPtr + block * channels;
+                    for (int f = 0; f < count; f++)
+                    {
+                        for (int c = 0; c < channels; c++)
+                        {
+                            blockPtr[f * channels + c] *= gains[f];
+                        }
+                    }
+                }
+#endif
+            }
         }
 
+        [Obsolete("Allocates the envelope of the whole clip. Use ApplyEnvelope or EvaluateEnvelope, " +
+            "which evaluate only the block being processed.")]
         public static unsafe AudioSample[] Evaluate(AudioClip clip, AudioSample[] samples)
         {
             int
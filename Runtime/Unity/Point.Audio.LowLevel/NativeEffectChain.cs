@@ -0,0 +1,224 @@
+﻿// Copyright 2022 Ikina Games
+// Author : Seung Ha Kim (Syadeu)
+// 
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+// 
+//     http://www.apache.org/licenses/LICENSE-2.0
+// 
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if (UNITY_EDITOR || DEVELOPMENT_BUILD) && !POINT_DISABLE_CHECKS
+#define DEBUG_MODE
+#endif
+
+using System;
+using System.Runtime.InteropServices;
+using UnityEngine.Assertions;
+
+namespace Point.Audio.LowLevel
+{
+    /// <summary>
+    /// A chain of effects that Point.Audio.Native runs in place on the buffer of
+    /// OnAudioFilterRead. Stages are added on the managed side and published with
+    /// <see cref="Submit"/>, which never blocks the audio thread; processing allocates nothing.
+    /// </summary>
+    /// <remarks>
+    /// See .Point.Audio.Native/Point.Audio.Native/effect_chain.h
+    /// </remarks>
+    public sealed unsafe class NativeEffectChain : IDisposable
+    {
+        // EFFECT_CHAIN_MAX_STAGES
+        public const int MaxStages = 8;
+
+        private enum StageType
+        {
+            None = 0,
+            Gain,
+            Envelope,
+            DownSampler,
+        }
+        // EffectStage
+        [StructLayout(LayoutKind.Sequential)]
+        private struct Stage
+        {
+            public int type;
+            public float gain;
+            public float mix;
+            public int sampleCount;
+            public AudioSample* points;
+            public int pointCount;
+            public int length;
+        }
+
+#if UNITY_STANDALONE_WIN || UNITY_EDITOR_WIN
+        private const string c_NativeLibrary = "Point.Audio.Native";
+
+        [DllImport(c_NativeLibrary)]
+        private static extern IntPtr Point_CreateEffectChain();
+        [DllImport(c_NativeLibrary)]
+        private static extern void Point_ReleaseEffectChain(IntPtr chain);
+        [DllImport(c_NativeLibrary)]
+        private static extern int Point_SubmitEffectChain(IntPtr chain, Stage* stages, int count);
+        [DllImport(c_NativeLibrary)]
+        private static extern void Point_ProcessEffectChain(IntPtr chain, float* data, int frames, int channels, int position);
+
+        public static bool IsSupported => true;
+#else
+        public static bool IsSupported => false;
+#endif
+
+        private IntPtr m_Chain;
+        private readonly Stage[] m_Stages = new Stage[MaxStages];
+        private int m_StageCount;
+        // Breakpoints of the envelope stages by stage index; Submit pins them only
+        // while the native side copies them.
+        private readonly AudioSample[][] m_Envelopes = new AudioSample[MaxStages][];
+        private readonly GCHandle[] m_Pinned = new GCHandle[MaxStages];
+
+        public int StageCount => m_StageCount;
+
+        public NativeEffectChain()
+        {
+#if UNITY_STANDALONE_WIN || UNITY_EDITOR_WIN
+            m_Chain = Point_CreateEffectChain();
+#else
+            throw new PlatformNotSupportedException("Point.Audio.Native is not built for this platform.");
+#endif
+        }
+
+        /// <summary>
+        /// Removes every stage added since the last <see cref="Submit"/>;
+        /// the audio thread keeps the submitted chain.
+        /// </summary>
+        public void Clear()
+        {
+            Array.Clear(m_Envelopes, 0, m_StageCount);
+            m_StageCount = 0;
+        }
+        public void AddGain(float gain)
+        {
+            Add(new Stage
+            {
+                type = (int)StageType.Gain,
+                gain = gain
+            });
+        }
+        /// <summary>
+        /// Multiplies by the envelope through (0, 0), <paramref name="points"/> and
+        /// (<paramref name="length"/>, 0) at the clip position given to <see cref="Process"/>.
+        /// See <see cref="DSP.EvaluateEnvelope"/>.
+        /// </summary>
+        public void AddEnvelope(AudioSample[] points, int length)
+        {
+            int index = m_StageCount;
+            Add(new Stage
+            {
+                type = (int)StageType.Envelope,
+                pointCount = points.Length,
+                length = length
+            });
+            if (index < m_StageCount) m_Envelopes[index] = points;
+        }
+        public void AddDownSampler(int sampleCount, float mix, float gain)
+        {
+            Add(new Stage
+            {
+                type = (int)StageType.DownSampler,
+                gain = gain,
+                mix = mix,
+                sampleCount = sampleCount
+            });
+        }
+        /// <summary>
+        /// The native port of <paramref name="downSampler"/> with its current properties.
+        /// </summary>
+        public void Add(DownSampler downSampler)
+        {
+            AddDownSampler(downSampler.SampleCount, downSampler.Mix, downSampler.Gain);
+        }
+
+        /// <summary>
+        /// Publishes the stages added since <see cref="Clear"/>; the audio thread
+        /// switches to them with its next block, ramping gain and mix of the stages
+        /// that keep their type. Envelope breakpoints are copied, so their arrays
+        /// can change afterwards without affecting the submitted chain.
+        /// </summary>
+        public void Submit()
+        {
+#if UNITY_STANDALONE_WIN || UNITY_EDITOR_WIN
+            for (int i = 0; i < m_StageCount; i++)
+            {
+                if (m_Envelopes[i] == null) continue;
+
+                m_Pinned[i] = GCHandle.Alloc(m_Envelopes[i], GCHandleType.Pinned);
+                m_Stages[i].points = (AudioSample*)m_Pinned[i].AddrOfPinnedObject();
+            }
+            try
+            {
+                fixed (Stage* stages = m_Stages)
+                {
+                    Point_SubmitEffectChain(m_Chain, stages, m_StageCount);
+                }
+            }
+            finally
+            {
+                for (int i = 0; i < m_StageCount; i++)
+                {
+                    if (!m_Pinned[i].IsAllocated) continue;
+
+                    m_Pinned[i].Free();
+                    m_Stages[i].points = null;
+                }
+            }
+#endif
+        }
+        /// <summary>
+        /// Runs the submitted chain in place over the first <paramref name="frames"/>
+        /// interleaved frames of <paramref name="data"/>, the first of which is clip
+        /// frame <paramref name="position"/>.
+        /// </summary>
+        public void Process(float[] data, int channels, int position, int frames)
+        {
+#if DEBUG_MODE
+            Assert.IsTrue(frames * channels <= data.Length);
+#endif
+#if UNITY_STANDALONE_WIN || UNITY_EDITOR_WIN
+            fixed (float* dataPtr = data)
+            {
+                Point_ProcessEffectChain(m_Chain, dataPtr, frames, channels, position);
+            }
+#endif
+        }
+
+        /// <summary>
+        /// Releases the native chain; call it once the audio thread no longer processes it.
+        /// </summary>
+        public void Dispose()
+        {
+#if UNITY_STANDALONE_WIN || UNITY_EDITOR_WIN
+            if (m_Chain != IntPtr.Zero)
+            {
+                Point_ReleaseEffectChain(m_Chain);
+                m_Chain = IntPtr.Zero;
+            }
+#endif
+        }
+
+        private void Add(Stage stage)
+        {
+#if DEBUG_MODE
+            Assert.IsTrue(m_StageCount < MaxStages, $"{nameof(NativeEffectChain)} holds at most {MaxStages} stages.");
+#endif
+            if (m_StageCount >= MaxStages) return;
+
+            m_Envelopes[m_StageCount] = null;
+            m_Stages[m_StageCount++] = stage;
+        }
+    }
+}
\ No newline at end of file
@@ -17,6 +17,9 @@
 #define DEBUG_MODE
 #endif
 
+using System;
+using UnityEngine;
+
 namespace Point.Audio.LowLevel
 {
     public abstract class SignalProcessor : ISignalProcessor
@@ -50,34 +53,94 @@ namespace Point.Audio.LowLevel
         { }
     }
 
+    /// <summary>
+    /// Every channel holds its value at the start of each window of <see cref="SampleCount"/>
+    /// frames, mixed with the input by <see cref="Mix"/>, then scaled by <see cref="Gain"/>.
+    /// Windows carry over from block to block. NativeEffectChain runs the same stage natively.
+    /// </summary>
+    [Serializable]
     public class DownSampler : SignalProcessor
     {
+        // EFFECT_CHAIN_RAMP_LENGTH, frames a Gain or Mix change is ramped over
         private const int c_RampCount = 256;
+        // EFFECT_CHAIN_MAX_CHANNELS, channels held; any above are only scaled by Gain
+        private const int c_MaxChannels = 8;
+
+        [SerializeField] private float m_Gain = 1;
+        [SerializeField] private int m_SampleCount = 4;
+        [SerializeField] private float m_Mix = 1;
 
-        public float Gain { get; set; }
-        public int SampleCount { get; set; }
-        public float Mix { get; set; }
+        /// <summary>
+        /// Linear output gain.
+        /// </summary>
+        public float Gain { get => m_Gain; set => m_Gain = value; }
+        /// <summary>
+        /// Frames each held value lasts; below 1 counts as 1.
+        /// </summary>
+        public int SampleCount { get => m_SampleCount; set => m_SampleCount = value; }
+        /// <summary>
+        /// 0 = input only, 1 = held values only.
+        /// </summary>
+        public float Mix { get => m_Mix; set => m_Mix = value; }
 
-        private float m_CurrentGain;
+        private float m_CurrentGain, m_CurrentMix;
+        private float m_TargetGain, m_TargetMix;
+        private float m_GainStep, m_MixStep;
         private int m_CurrentRampCount;
+        // frames of the current window already written
+        private int m_Phase;
+        private readonly float[] m_Held = new float[c_MaxChannels];
 
         protected override void BeforeProcess(in RuntimeSignalProcessData processData)
         {
-            m_CurrentGain = Gain;
-            m_CurrentRampCount = c_RampCount;
+            // a new stage starts at its values, with nothing held
+            m_CurrentGain = m_TargetGain = m_Gain;
+            m_CurrentMix = m_TargetMix = m_Mix;
+            m_CurrentRampCount = 0;
+            m_Phase = 0;
+            Array.Clear(m_Held, 0, c_MaxChannels);
         }
         protected override void Process(in RuntimeSignalProcessData processData, ref float[] data, in int channels)
         {
-            int normalizedCount = SampleCount * channels;
-            for (int i = 0; i < data.Length; i += normalizedCount)
+            if (m_Gain != m_TargetGain || m_Mix != m_TargetMix)
             {
-                float targetValue = data[i];
+                m_TargetGain = m_Gain;
+                m_TargetMix = m_Mix;
+                m_GainStep = (m_TargetGain - m_CurrentGain) / c_RampCount;
+                m_MixStep = (m_TargetMix - m_CurrentMix) / c_RampCount;
+                m_CurrentRampCount = c_RampCount;
+            }
 
-                for (int c = channels; c < normalizedCount; c++)
+            int sampleCount = 0 < m_SampleCount ? m_SampleCount : 1;
+            int held = channels < c_MaxChannels ? channels : c_MaxChannels;
+            int phase = m_Phase < sampleCount ? m_Phase : 0;
+
+            for (int i = 0; i + channels <= data.Length; i += channels)
+            {
+                if (m_CurrentRampCount > 0)
                 {
-                    data[i + c] = targetValue;
+                    m_CurrentGain += m_GainStep;
+                    m_CurrentMix += m_MixStep;
+                    if (--m_CurrentRampCount == 0)
+                    {
+                        m_CurrentGain = m_TargetGain;
+                        m_CurrentMix = m_TargetMix;
+                    }
                 }
+
+                if (phase == 0) Array.Copy(data, i, m_Held, 0, held);
+                for (int c = 0; c < held; c++)
+                {
+                    data[i + c] = (m_Held[c] * m_CurrentMix + data[i + c] * (1 - m_CurrentMix)) * m_CurrentGain;
+                }
+                for (int c = held; c < channels; c++)
+                {
+                    data[i + c] *= m_CurrentGain;
+                }
+
+                if (++phase == sampleCount) phase = 0;
             }
+            m_Phase = phase;
         }
     }
 }
\ No newline at end of file
@@ -24,6 +24,7 @@ using System.Buffers;
 using Point.Collections;
 using System;
 using System.Collections;
+using System.Threading;
 using Unity.Mathematics;
 using UnityEngine;
 using UnityEngine.Assertions;
@@ -39,6 +40,14 @@ namespace Point.Audio.LowLevel
         private RuntimeSignalProcessData m_RuntimeSignalProcessData;
         private IRootSignalProcessor m_PlayableAudioClip = new DefaultRootSignalProcessor(0);
 
+        // Runs the clip's effects in Point.Audio.Native where it is built; the
+        // managed processors otherwise.
+        private NativeEffectChain m_EffectChain;
+        private bool m_NativeProcess;
+        // 1 while OnAudioFilterRead may be running m_EffectChain; OnDestroy waits
+        // for it to drop before it releases the chain.
+        private int m_ProcessingChain;
+
         // https://forum.unity.com/threads/dsp-buffer-size-differences-why-isnt-it-a-setting-per-platform.447925/
         public void Play(PlayableAudioClip clip)
         {
@@ -71,21 +80,58 @@ namespace Point.Audio.LowLevel
                 root.BeforeProcess(m_RuntimeSignalProcessData);
             }
 
+            bool nativeProcess = false;
+            if (NativeEffectChain.IsSupported)
+            {
+                if (m_EffectChain == null) m_EffectChain = new NativeEffectChain();
+
+                nativeProcess = clip.BuildEffectChain(m_EffectChain);
+            }
+
             audioSource.Play();
             m_PlayableAudioClip = root;
+            m_NativeProcess = nativeProcess;
         }
 
         private void OnAudioFilterRead(float[] data, int channels)
         {
-            m_PlayableAudioClip.Process(m_RuntimeSignalProcessData, data, channels);
-
             ref RuntimeSignalProcessData ptr = ref m_RuntimeSignalProcessData;
+            if (m_NativeProcess)
+            {
+                // Announce the chain before reading it, so that OnDestroy either
+                // sees this block or this block sees the chain gone.
+                Interlocked.Exchange(ref m_ProcessingChain, 1);
+                NativeEffectChain chain = Volatile.Read(ref m_EffectChain);
+                chain?.Process(data, channels, ptr.currentSamplePosition, ptr.nextSamplePositionOffset);
+                Volatile.Write(ref m_ProcessingChain, 0);
+            }
+            else
+            {
+                m_PlayableAudioClip.Process(m_RuntimeSignalProcessData, data, channels);
+            }
+
             ptr.currentSamplePosition = ptr.nextSamplePosition;
 
             if (ptr.currentSamplePosition >= ptr.targetSamples)
             {
+                m_NativeProcess = false;
                 m_PlayableAudioClip = new DefaultRootSignalProcessor(0);
             }
         }
+        private void OnDestroy()
+        {
+            m_NativeProcess = false;
+
+            NativeEffectChain chain = Interlocked.Exchange(ref m_EffectChain, null);
+            if (chain == null) return;
+
+            // A block that read the chain before the exchange is at most one
+            // Process away from done.
+            while (Volatile.Read(ref m_ProcessingChain) != 0)
+            {
+                Thread.Yield();
+            }
+            chain.Dispose();
+        }
     }
 }
\ No newline at end of file